@@ -6,6 +6,24 @@ cbuffer MatrixBuffer : register(b0)
 	matrix ProjectionMatrix;
 };
 
+#ifdef PACKED_VERTICES
+// packed_vertex_t (vertexpack.h), decoded below
+struct VSIn
+{
+	float3 Pos : POSITION;		// quantized positions are mapped to model space by ModelToWorldMatrix
+	float2 Normal : NORMAL;		// octahedral
+	float4 Tangent : TANGENT;	// octahedral xy, handedness z
+	float2 TexCoord : TEX;
+};
+
+float3 oct_decode(float2 e)
+{
+	float3 n = float3(e.x, e.y, 1 - abs(e.x) - abs(e.y));
+	float t = saturate(-n.z);
+	n.xy += n.xy >= 0 ? -t : t;
+	return normalize(n);
+}
+#else
 struct VSIn
 {
 	float3 Pos : POSITION;
@@ -14,6 +32,7 @@ struct VSIn
 	float3 Binormal : BINORMAL;
 	float2 TexCoord : TEX;
 };
+#endif
 
 struct PSIn
 {
@@ -37,10 +56,20 @@ PSIn VS_main(VSIn input)
 	// model-to-projection
 	matrix MVP = mul(ProjectionMatrix, MV);
 	
+#ifdef PACKED_VERTICES
+	float3 Normal = oct_decode(input.Normal);
+	float3 Tangent = oct_decode(input.Tangent.xy);
+	float3 Binormal = cross(Normal, Tangent) * input.Tangent.z;
+#else
+	float3 Normal = input.Normal;
+	float3 Tangent = input.Tangent;
+	float3 Binormal = input.Binormal;
+#endif
+
 	output.Pos = mul(MVP, float4(input.Pos, 1));
-	output.Normal = mul(ModelToWorldMatrix, input.Normal);
-	output.Tangent = mul(ModelToWorldMatrix, input.Tangent);
-	output.Binormal = mul(ModelToWorldMatrix, input.Binormal);
+	output.Normal = mul(ModelToWorldMatrix, Normal);
+	output.Tangent = mul(ModelToWorldMatrix, Tangent);
+	output.Binormal = mul(ModelToWorldMatrix, Binormal);
 	output.TexCoord = float2(input.TexCoord.x, 1-input.TexCoord.y);
 	output.WorldPos = mul(ModelToWorldMatrix, float4(input.Pos, 1));
 
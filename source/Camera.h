@@ -10,6 +10,7 @@
 
 #include "vec\vec.h"
 #include "vec\mat.h"
+#include "vec\quat.h"
 
 using namespace linalg;
 
@@ -18,7 +19,7 @@ class camera_t
 	float vfov, aspect;	// aperture attributes
 	float zNear, zFar;	// clip planes
 	vec3f position;
-	float angle = 0;			// rad
+	quatf orientation;			// view to world rotation
 	float angle_vel = fPI / 4;	// rad/s
 
 public:
@@ -86,16 +87,17 @@ public:
 
 	}
 
+	// rotate v rad around the world y axis, renormalized so rounding does not accumulate
 	void rotate(const float v)
 	{
-		angle += v;
+		orientation = normalize(quatf::rotation(v, 0.0f, 1.0f, 0.0f) * orientation);
 	}
 
 
 	mat4f get_ViewToWorldMatrix() const
 	{
 		mat4f R, T, S, C, M, F;
-		R = mat4f::rotation(angle, 0.0f, 1.0f, 0.0f);
+		R = orientation.to_mat4();
 		T = mat4f::translation(position);
 		M = T * R;
 		return M;
@@ -104,7 +106,7 @@ public:
 	mat4f get_WorldToViewMatrix() const
 	{
 		mat4f T, R, S, M;
-		R = mat4f::rotation(-angle, 0.0f, 1.0f, 0.0f);
+		R = orientation.conjugate().to_mat4();
 		T = mat4f::translation(-position);
 		M = R * T;
 		return M;
@@ -29,6 +29,172 @@ void Geometry_t::CreateSampler(ID3D11Device* device)
 	ASSERT(hr = device->CreateSamplerState(&sd, &SamplerState));
 }
 
+
+HRESULT Geometry_t::create_vertex_buffer(ID3D11Device* device, const vertex_t* vertices, size_t nbr_vertices)
+{
+	// vertex array descriptor
+	D3D11_BUFFER_DESC vbufferDesc = { 0.0f };
+	vbufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vbufferDesc.CPUAccessFlags = 0;
+	vbufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	vbufferDesc.MiscFlags = 0;
+	// data resource
+	D3D11_SUBRESOURCE_DATA vdata;
+
+#ifdef VERTEX_PACKED
+	// pack to the compact format, positions are dequantized by the model matrix
+	std::vector<packed_vertex_t> packed;
+	vertex_quantization_t quantization;
+	pack_vertices(vertices, nbr_vertices, packed, quantization);
+	vertex_dequantize = quantization.dequantize_matrix();
+	vertex_stride = sizeof(packed_vertex_t);
+	vdata.pSysMem = packed.data();
+#else
+	vertex_dequantize = mat4f_identity;
+	vertex_stride = sizeof(vertex_t);
+	vdata.pSysMem = vertices;
+#endif
+	vbufferDesc.ByteWidth = (UINT)(nbr_vertices * vertex_stride);
+
+	// create vertex buffer on device using descriptor & data
+	return device->CreateBuffer(&vbufferDesc, &vdata, &vertex_buffer);
+}
+
+
+HRESULT Geometry_t::create_index_buffer(ID3D11Device* device, const void* indices, size_t nbr_indices, DXGI_FORMAT format)
+{
+	index_format = format;
+
+	// index array descriptor
+	D3D11_BUFFER_DESC ibufferDesc = { 0.0f };
+	ibufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	ibufferDesc.CPUAccessFlags = 0;
+	ibufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	ibufferDesc.MiscFlags = 0;
+	ibufferDesc.ByteWidth = (UINT)(nbr_indices * (format == DXGI_FORMAT_R16_UINT ? sizeof(uint16_t) : sizeof(unsigned)));
+	// data resource
+	D3D11_SUBRESOURCE_DATA idata;
+	idata.pSysMem = indices;
+	// create index buffer on device using descriptor & data
+	return device->CreateBuffer(&ibufferDesc, &idata, &index_buffer);
+}
+
+HRESULT Geometry_t::create_index_buffer(ID3D11Device* device, const unsigned* indices, size_t nbr_indices)
+{
+	if (nbr_indices && *std::max_element(indices, indices + nbr_indices) <= 0xffff)
+	{
+		std::vector<uint16_t> indices16(indices, indices + nbr_indices);
+		return create_index_buffer(device, indices16.data(), nbr_indices, DXGI_FORMAT_R16_UINT);
+	}
+	return create_index_buffer(device, indices, nbr_indices, DXGI_FORMAT_R32_UINT);
+}
+
+static IWICImagingFactory* wic_factory = nullptr;
+
+//
+// decode an image with WIC to RGBA8, for the formats imagedecode.h does not handle (jpg, ...)
+//
+static bool wic_decode(const void* data, size_t size, texture_image_t& image)
+{
+	if (!wic_factory)
+		return false;
+
+	// textures are decoded on worker threads as well
+	HRESULT co = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+	IWICStream* stream = nullptr;
+	IWICBitmapDecoder* decoder = nullptr;
+	IWICBitmapFrameDecode* frame = nullptr;
+	IWICFormatConverter* converter = nullptr;
+	UINT width = 0, height = 0;
+
+	bool ok = SUCCEEDED(wic_factory->CreateStream(&stream)) &&
+		SUCCEEDED(stream->InitializeFromMemory((BYTE*)data, (DWORD)size)) &&
+		SUCCEEDED(wic_factory->CreateDecoderFromStream(stream, nullptr, WICDecodeMetadataCacheOnDemand, &decoder)) &&
+		SUCCEEDED(decoder->GetFrame(0, &frame)) &&
+		SUCCEEDED(frame->GetSize(&width, &height)) && width && height &&
+		SUCCEEDED(wic_factory->CreateFormatConverter(&converter)) &&
+		SUCCEEDED(converter->Initialize(frame, GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom));
+
+	if (ok)
+	{
+		image.width = width;
+		image.height = height;
+		image.pixels.resize((size_t)width * height * 4);
+		ok = SUCCEEDED(converter->CopyPixels(nullptr, width * 4, (UINT)image.pixels.size(), image.pixels.data()));
+	}
+
+	SAFE_RELEASE(converter);
+	SAFE_RELEASE(frame);
+	SAFE_RELEASE(decoder);
+	SAFE_RELEASE(stream);
+	if (SUCCEEDED(co))
+		CoUninitialize();
+	return ok;
+}
+
+// row pitch of an image: a row of pixels, or of 4x4 blocks
+static UINT texture_pitch(const texture_image_t& image)
+{
+	if (image.format == TEXTURE_RGBA8)
+		return image.width * 4;
+	return (UINT)(std::max(1u, (image.width + 3) / 4) * texture_block_bytes(image.format));
+}
+
+//
+// create a decoded texture on the device as an RGBA8 texture, or a block-compressed one if it
+// was cooked, with the mips built on the CPU
+//
+static HRESULT upload_texture(ID3D11Device* device, const texture_t& texture, ID3D11ShaderResourceView** srv)
+{
+	static const DXGI_FORMAT formats[] = { DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC3_UNORM, DXGI_FORMAT_BC5_UNORM };
+
+	D3D11_TEXTURE2D_DESC desc = { 0 };
+	desc.Width = texture.image.width;
+	desc.Height = texture.image.height;
+	desc.MipLevels = (UINT)(1 + texture.mips.size());
+	desc.ArraySize = 1;
+	desc.Format = formats[texture.image.format];
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	std::vector<D3D11_SUBRESOURCE_DATA> levels;
+	levels.push_back({ texture.image.pixels.data(), texture_pitch(texture.image), 0 });
+	for (auto& level : texture.mips)
+		levels.push_back({ level.pixels.data(), texture_pitch(level), 0 });
+
+	ID3D11Texture2D* tex = nullptr;
+	HRESULT hr = device->CreateTexture2D(&desc, levels.data(), &tex);
+	if (SUCCEEDED(hr))
+		hr = device->CreateShaderResourceView(tex, nullptr, srv);
+
+	// the view keeps the texture alive
+	SAFE_RELEASE(tex);
+	return hr;
+}
+
+texture_cache_t& device_textures()
+{
+	// never destroyed, so nothing is released after the device at exit; trim() frees the textures
+	static texture_cache_t* cache = nullptr;
+	if (!cache)
+	{
+		CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, __uuidof(IWICImagingFactory), (void**)&wic_factory);
+
+		cache = new texture_cache_t([](const void* data, size_t size, texture_image_t& image)
+		{
+			return decode_image(data, size, image) || wic_decode(data, size, image);
+		});
+		cache->on_evict = [](texture_t& texture)
+		{
+			ID3D11ShaderResourceView* srv = (ID3D11ShaderResourceView*)texture.device_data;
+			SAFE_RELEASE(srv);
+		};
+	}
+	return *cache;
+}
+
 void Geometry_t::MapMatrixBuffers(
 	ID3D11DeviceContext* device_context,
 	ID3D11Buffer* matrix_buffer,
@@ -40,7 +206,7 @@ void Geometry_t::MapMatrixBuffers(
 	D3D11_MAPPED_SUBRESOURCE resource;
 	device_context->Map(matrix_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
 	MatrixBuffer_t* matrix_buffer_ = (MatrixBuffer_t*)resource.pData;
-	matrix_buffer_->ModelToWorldMatrix = ModelToWorldMatrix;//linalg::transpose(ModelToWorldMatrix);
+	matrix_buffer_->ModelToWorldMatrix = ModelToWorldMatrix * vertex_dequantize;//linalg::transpose(ModelToWorldMatrix);
 	matrix_buffer_->WorldToViewMatrix = WorldToViewMatrix;//linalg::transpose(WorldToViewMatrix);
 	matrix_buffer_->ProjectionMatrix = ProjectionMatrix;//linalg::transpose(ProjectionMatrix);
 	device_context->Unmap(matrix_buffer, 0);
@@ -96,31 +262,11 @@ Quad_t::Quad_t(ID3D11Device* device) : Geometry_t(device)
 
 
 
-	// vertex array descriptor
-	D3D11_BUFFER_DESC vbufferDesc = { 0.0f };
-	vbufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vbufferDesc.CPUAccessFlags = 0;
-	vbufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vbufferDesc.MiscFlags = 0;
-	vbufferDesc.ByteWidth = vertices.size()*sizeof(vertex_t);
-	// data resource
-	D3D11_SUBRESOURCE_DATA vdata;
-	vdata.pSysMem = &vertices[0];
-	// create vertex buffer on device using descriptor & data
-	HRESULT vhr = device->CreateBuffer(&vbufferDesc, &vdata, &vertex_buffer);
+	// create vertex buffer on device
+	HRESULT vhr = create_vertex_buffer(device, vertices.data(), vertices.size());
 
-	//  index array descriptor
-	D3D11_BUFFER_DESC ibufferDesc = { 0.0f };
-	ibufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	ibufferDesc.CPUAccessFlags = 0;
-	ibufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	ibufferDesc.MiscFlags = 0;
-	ibufferDesc.ByteWidth = indices.size()*sizeof(unsigned);
-	// data resource
-	D3D11_SUBRESOURCE_DATA idata;
-	idata.pSysMem = &indices[0];
-	// create index buffer on device using descriptor & data
-	HRESULT ihr = device->CreateBuffer(&ibufferDesc, &idata, &index_buffer);
+	// create index buffer on device, 16-bit since the vertex count allows it
+	HRESULT ihr = create_index_buffer(device, indices.data(), indices.size());
 
 	// local data is now loaded to device so it can be released
 	vertices.clear();
@@ -134,12 +280,12 @@ void Quad_t::render(ID3D11DeviceContext* device_context) const
 	device_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
 	// bind our vertex buffer
-	UINT32 stride = sizeof(vertex_t); //  sizeof(float) * 8;
+	UINT32 stride = vertex_stride;
 	UINT32 offset = 0;
 	device_context->IASetVertexBuffers(0, 1, &vertex_buffer, &stride, &offset);
 
 	// bind our index buffer
-	device_context->IASetIndexBuffer(index_buffer, DXGI_FORMAT_R32_UINT, 0);
+	device_context->IASetIndexBuffer(index_buffer, index_format, 0);
 
 	//bind sampler
 	device_context->PSSetSamplers(0, 1, &SamplerState);
@@ -151,18 +297,17 @@ void Quad_t::render(ID3D11DeviceContext* device_context) const
 
 Cube_t::Cube_t(ID3D11Device* device) : Geometry_t(device)
 {
-	// populate the vertex array with 4 vertices
-	vec3f vPos0, vPos1, vPos2, vPos3, vPos4, vPos5, vPos6, vPos7;
+	// cube corners, built at compile time where the linalg templates are constexpr
+	LINALG_CONSTEXPR const vec3f
+		vPos0(-0.5f, -0.5f, 0.5f),
+		vPos1(0.5f, -0.5f, 0.5f),
+		vPos2(0.5f, 0.5f, 0.5f),
+		vPos3(-0.5f, 0.5f, 0.5f),
 
-	vPos0 = { -0.5, -0.5f, 0.5f };
-	vPos1 = { 0.5, -0.5f, 0.5f };
-	vPos2 = { 0.5, 0.5f, 0.5f };
-	vPos3 = { -0.5, 0.5f, 0.5f };
-
-	vPos4 = { 0.5, -0.5f, -0.5f };
-	vPos5 = { -0.5, -0.5f, -0.5f };
-	vPos6 = { -0.5, 0.5f, -0.5f };
-	vPos7 = { 0.5, 0.5f, -0.5f };
+		vPos4(0.5f, -0.5f, -0.5f),
+		vPos5(-0.5f, -0.5f, -0.5f),
+		vPos6(-0.5f, 0.5f, -0.5f),
+		vPos7(0.5f, 0.5f, -0.5f);
 
 
 	vertex_t v0, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23;
@@ -375,31 +520,11 @@ Cube_t::Cube_t(ID3D11Device* device) : Geometry_t(device)
 
 
 
-	// vertex array descriptor
-	D3D11_BUFFER_DESC vbufferDesc = { 0.0f };
-	vbufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vbufferDesc.CPUAccessFlags = 0;
-	vbufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vbufferDesc.MiscFlags = 0;
-	vbufferDesc.ByteWidth = vertices.size()*sizeof(vertex_t);
-	// data resource
-	D3D11_SUBRESOURCE_DATA vdata;
-	vdata.pSysMem = &vertices[0];
-	// create vertex buffer on device using descriptor & data
-	HRESULT vhr = device->CreateBuffer(&vbufferDesc, &vdata, &vertex_buffer);
+	// create vertex buffer on device
+	HRESULT vhr = create_vertex_buffer(device, vertices.data(), vertices.size());
 
-	//  index array descriptor
-	D3D11_BUFFER_DESC ibufferDesc = { 0.0f };
-	ibufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	ibufferDesc.CPUAccessFlags = 0;
-	ibufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	ibufferDesc.MiscFlags = 0;
-	ibufferDesc.ByteWidth = indices.size()*sizeof(unsigned);
-	// data resource
-	D3D11_SUBRESOURCE_DATA idata;
-	idata.pSysMem = &indices[0];
-	// create index buffer on device using descriptor & data
-	HRESULT ihr = device->CreateBuffer(&ibufferDesc, &idata, &index_buffer);
+	// create index buffer on device, 16-bit since the vertex count allows it
+	HRESULT ihr = create_index_buffer(device, indices.data(), indices.size());
 
 	// local data is now loaded to device so it can be released
 	vertices.clear();
@@ -416,12 +541,12 @@ void Cube_t::render(ID3D11DeviceContext* device_context) const
 	device_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
 	// bind our vertex buffer
-	UINT32 stride = sizeof(vertex_t); //  sizeof(float) * 8;
+	UINT32 stride = vertex_stride;
 	UINT32 offset = 0;
 	device_context->IASetVertexBuffers(0, 1, &vertex_buffer, &stride, &offset);
 
 	// bind our index buffer
-	device_context->IASetIndexBuffer(index_buffer, DXGI_FORMAT_R32_UINT, 0);
+	device_context->IASetIndexBuffer(index_buffer, index_format, 0);
 
 
 	//bind sampler
@@ -436,100 +561,204 @@ OBJModel_t::OBJModel_t(
 	const std::string& objfile,
 	ID3D11Device* device) : Geometry_t(device)
 {
-	//
-	// load the OBJ
-	//
-	mesh_t* mesh = new mesh_t();
-	mesh->load_obj(objfile);
-
+	// use the binary cache next to the OBJ if it is up to date (see the cooker for building it
+	// offline), otherwise load the OBJ, run the import pipeline and write the cache
+	model_data_t data;
+	load_model_data(objfile, data);
+	create(data, device);
+}
 
-	for (auto& dc : mesh->vertices)
-	{
-		int i = 1;
-	}
+OBJModel_t::OBJModel_t(
+	const model_data_t& data,
+	ID3D11Device* device) : Geometry_t(device)
+{
+	create(data, device);
+}
 
+OBJModel_t::~OBJModel_t()
+{
+	for (auto texture : textures)
+		device_textures().release(texture);
+}
 
-	// load and organize indices in ranges per drawcall (material)
-	//
-	std::vector<unsigned> indices;
-	size_t i_ofs = 0;
+ID3D11ShaderResourceView* OBJModel_t::use_texture(ID3D11Device* device, texture_t* texture)
+{
+	if (!texture)
+		return nullptr;
+	textures.push_back(texture);
 
-	for (auto& dc : mesh->drawcalls)
+	// first use of a decoded texture: create it on the device, the pixels are not needed after that
+	if (!texture->device_data)
 	{
-		// append the drawcall indices
-		for (auto& tri : dc.tris) 
-		{
-			compute_tangentspace(mesh->vertices[tri.vi[0]], mesh->vertices[tri.vi[1]], mesh->vertices[tri.vi[2]]);
+		ID3D11ShaderResourceView* srv = nullptr;
+		if (FAILED(upload_texture(device, *texture, &srv)))
+			return nullptr;
+		texture->device_data = srv;
+		texture->image.pixels = std::vector<uint8_t>();
+		texture->mips = std::vector<texture_image_t>();
+	}
+	return (ID3D11ShaderResourceView*)texture->device_data;
+}
 
+void OBJModel_t::create(const model_data_t& data, ID3D11Device* device)
+{
+	const vertex_t* vertex_data = data.vertices;
+	const unsigned* index_data = data.indices;
+	const mesh_cache_range_t* ranges = data.ranges;
+	size_t nbr_vertices = data.nbr_vertices, nbr_indices = data.nbr_indices, nbr_ranges = data.nbr_ranges;
 
-			indices.insert(indices.end(), tri.vi, (tri.vi + 3));
-		}
+	append_materials(*data.materials);
 
-		// create a range
-		size_t i_size = dc.tris.size() * 3;
-		int mtl_index = dc.mtl_index > -1 ? dc.mtl_index : -1;
-		index_ranges.push_back({ i_ofs, i_size, 0, mtl_index });
+	// index ranges per drawcall (material) and LOD
+	for (size_t i = 0; i < nbr_ranges; i++)
+	{
+		const mesh_cache_range_t& range = ranges[i];
+		index_ranges.push_back({ range.start, range.size, 0, range.mtl_index, range.lod });
 
-		i_ofs = indices.size();
+		if (lod_errors.size() <= (size_t)range.lod)
+			lod_errors.resize(range.lod + 1, 0.0f);
+		lod_errors[range.lod] = range.lod_error;
 	}
 
 
-	// vertex array descriptor
-	D3D11_BUFFER_DESC vbufferDesc = { 0.0f };
-	vbufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vbufferDesc.CPUAccessFlags = 0;
-	vbufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vbufferDesc.MiscFlags = 0;
-	vbufferDesc.ByteWidth = mesh->vertices.size()*sizeof(vertex_t);
-	// data resource
-	D3D11_SUBRESOURCE_DATA vdata;
-	vdata.pSysMem = &(mesh->vertices)[0];
-	// create vertex buffer on device using descriptor & data
-	HRESULT vhr = device->CreateBuffer(&vbufferDesc, &vdata, &vertex_buffer);
-
-	// index array descriptor
-	D3D11_BUFFER_DESC ibufferDesc = { 0.0f };
-	ibufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	ibufferDesc.CPUAccessFlags = 0;
-	ibufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	ibufferDesc.MiscFlags = 0;
-	ibufferDesc.ByteWidth = indices.size()*sizeof(unsigned);
-	// data resource
-	D3D11_SUBRESOURCE_DATA idata;
-	idata.pSysMem = &indices[0];
-	// create index buffer on device using descriptor & data
-	HRESULT ihr = device->CreateBuffer(&ibufferDesc, &idata, &index_buffer);
+	// create vertex buffer on device
+	HRESULT vhr = create_vertex_buffer(device, vertex_data, nbr_vertices);
 
-	// copy materials from mesh
-	append_materials(mesh->materials);
+	// create index buffer on device, 16-bit relative to the range base vertices if they all fit
+	std::vector<uint16_t> indices16;
+	HRESULT ihr;
+	if (build_indices16(index_data, nbr_indices, indices16))
+		ihr = create_index_buffer(device, indices16.data(), nbr_indices, DXGI_FORMAT_R16_UINT);
+	else
+		ihr = create_index_buffer(device, index_data, nbr_indices, DXGI_FORMAT_R32_UINT);
+	printf("index buffer: %s, %d ranges, %.1f KB\n",
+		index_format == DXGI_FORMAT_R16_UINT ? "16-bit" : "32-bit", (int)index_ranges.size(),
+		nbr_indices * (index_format == DXGI_FORMAT_R16_UINT ? 2 : 4) / 1024.0);
 
+#ifdef MESH_MESHLET_CULLING
+	// split the final ranges into meshlets for per-frame culling
+	for (auto& irange : index_ranges)
+	{
+		irange.meshlet_start = meshlets.size();
+		build_meshlets(index_data, irange.start, irange.size, vertex_data, meshlets);
+		irange.nbr_meshlets = meshlets.size() - irange.meshlet_start;
+	}
+	print_meshlet_stats(meshlets);
+#endif
 
+#ifdef MESH_LOD_CHAIN
+	// bounding sphere, for the distance to the view in LOD selection
+	if (nbr_vertices)
+	{
+		vec3f lo = vertex_data[0].Pos, hi = lo;
+		for (size_t i = 1; i < nbr_vertices; i++)
+		{
+			const vec3f& p = vertex_data[i].Pos;
+			lo = vec3f(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+			hi = vec3f(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+		}
+		bounds_center = (lo + hi) * 0.5f;
+		for (size_t i = 0; i < nbr_vertices; i++)
+			bounds_radius = std::max(bounds_radius, (vertex_data[i].Pos - bounds_center).norm2());
+	}
+#endif
 
 
-	// load textures associated with materials to device
+	// load textures associated with materials to device, through the texture cache so each
+	// image is decoded and uploaded once however many materials and models use it. The maps
+	// of all materials are decoded (and their mips built) in parallel, then uploaded here. Maps
+	// cooked to .dds by the cooker (texturecompress.h) are read block-compressed instead.
+	std::vector<texture_request_t> requests;
 	for (auto& mtl : materials)
 	{
-		HRESULT hr;
-		std::wstring wstr; // for conversion from string to wstring
+		if (mtl.map_Kd.size())
+			requests.push_back({ mtl.map_Kd, TEXTURE_MIPS | TEXTURE_SRGB | TEXTURE_COOKED, nullptr });
+		if (mtl.map_bump.size())
+			requests.push_back({ mtl.map_bump, TEXTURE_MIPS | TEXTURE_COOKED, nullptr });
+	}
+	device_textures().acquire_all(requests);
 
+	auto request = requests.begin();
+	for (auto& mtl : materials)
+	{
 		// Kd_map
 		if (mtl.map_Kd.size()) {
-			wstr = std::wstring(mtl.map_Kd.begin(), mtl.map_Kd.end());
-			hr = DirectX::CreateWICTextureFromFile(device, wstr.c_str(), &mtl.map_Kd_Tex, &mtl.map_Kd_TexSRV);
-			printf("loading texture %s - %s\n", mtl.map_Kd.c_str(), SUCCEEDED(hr) ? "OK" : "FAILED");
-			hr = DirectX::CreateWICTextureFromFile(device, wstr.c_str(), &mtl.map_bump_Tex, &mtl.map_bump_TexSRV);
+			mtl.map_Kd_TexSRV = use_texture(device, (request++)->texture);
+			printf("loading texture %s - %s\n", mtl.map_Kd.c_str(), mtl.map_Kd_TexSRV ? "OK" : "FAILED");
 		}
 
 		if (mtl.map_bump.size()) {
-			wstr = std::wstring(mtl.map_bump.begin(), mtl.map_bump.end());
-			hr = DirectX::CreateWICTextureFromFile(device, wstr.c_str(), &mtl.map_bump_Tex, &mtl.map_bump_TexSRV);
-			printf("loading texture %s - %s\n", mtl.map_bump.c_str(), SUCCEEDED(hr) ? "OK" : "FAILED");
+			mtl.map_bump_TexSRV = use_texture(device, (request++)->texture);
+			printf("loading texture %s - %s\n", mtl.map_bump.c_str(), mtl.map_bump_TexSRV ? "OK" : "FAILED");
 		}
+		else
+			// the diffuse map stays bound in the normal map slot, as before, but is shared instead of decoded again
+			mtl.map_bump_TexSRV = mtl.map_Kd_TexSRV;
 
 		// other maps here...
 	}
 
-	SAFE_DELETE(mesh);
+	texture_cache_stats_t ts = device_textures().stats();
+	printf("texture cache: %d hits (%d by content), %d misses, %d failed, %.1f MB decoded, %.1f MB resident\n",
+		(int)ts.hits, (int)ts.content_hits, (int)ts.misses, (int)ts.failures,
+		ts.decoded_bytes / (1024.0 * 1024.0), ts.resident_bytes / (1024.0 * 1024.0));
+}
+
+
+bool OBJModel_t::build_indices16(const unsigned* indices, size_t nbr_indices, std::vector<uint16_t>& indices16)
+{
+	// base vertex & span of a triangle sequence
+	struct span_t
+	{
+		unsigned lo = ~0u, hi = 0;
+		void add(const unsigned* tri) { for (int i = 0; i < 3; i++) { lo = std::min(lo, tri[i]); hi = std::max(hi, tri[i]); } }
+		bool fits() const { return hi - lo <= 0xffff; }
+	};
+
+	std::vector<index_range_t> ranges;
+	for (auto& irange : index_ranges)
+	{
+		index_range_t sub = irange;
+		sub.size = 0;
+		span_t span;
+
+		for (size_t i = irange.start; i < irange.start + irange.size; i += 3)
+		{
+			span_t grown = span;
+			grown.add(indices + i);
+
+			if (!grown.fits())
+			{
+#ifdef INDEX_BUFFER_SPLIT_RANGES
+				// close the current sub-range and start a new one with this triangle
+				span_t tri;
+				tri.add(indices + i);
+				if (!sub.size || !tri.fits())
+					return false;
+				sub.ofs = span.lo;
+				ranges.push_back(sub);
+				sub.start = i;
+				sub.size = 0;
+				grown = tri;
+#else
+				return false;
+#endif
+			}
+			span = grown;
+			sub.size += 3;
+		}
+		sub.ofs = sub.size ? span.lo : 0;
+		ranges.push_back(sub);
+	}
+
+	// rebase indices to their range's base vertex
+	indices16.resize(nbr_indices);
+	for (auto& irange : ranges)
+		for (size_t i = irange.start; i < irange.start + irange.size; i++)
+			indices16[i] = (uint16_t)(indices[i] - irange.ofs);
+
+	index_ranges = ranges;
+	return true;
 }
 
 
@@ -539,17 +768,26 @@ void OBJModel_t::render(ID3D11DeviceContext* device_context) const
 	device_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
 	// bind vertex buffer
-	UINT32 stride = sizeof(vertex_t); //  sizeof(float) * 8;
+	UINT32 stride = vertex_stride;
 	UINT32 offset = 0;
 	//ID3D11Buffer* buffersToSet[] = { vertex_buffer };
 	device_context->IASetVertexBuffers(0, 1, &vertex_buffer, &stride, &offset);
 
 	// bind index buffer
-	device_context->IASetIndexBuffer(index_buffer, DXGI_FORMAT_R32_UINT, 0);
+	device_context->IASetIndexBuffer(index_buffer, index_format, 0);
+
+#ifdef MESH_LOD_CHAIN
+	int lod = select_lod(device_context);
+#endif
 
 	// iterate drawcalls
 	for (auto& irange : index_ranges)
 	{
+#ifdef MESH_LOD_CHAIN
+		if (irange.lod != lod)
+			continue;
+#endif
+
 		// fetch material and bind texture
 		const material_t& mtl = materials[irange.mtl_index];
 		device_context->PSSetShaderResources(0, 1, &mtl.map_Kd_TexSRV);
@@ -558,48 +796,74 @@ void OBJModel_t::render(ID3D11DeviceContext* device_context) const
 		//bind sampler
 		device_context->PSSetSamplers(0, 1, &SamplerState);
 
+#ifdef MESH_MESHLET_CULLING
+		// make a drawcall per run of consecutive visible meshlets
+		size_t run_start = irange.start, run_size = 0;
+		for (size_t i = irange.meshlet_start; i < irange.meshlet_start + irange.nbr_meshlets; i++)
+		{
+			const meshlet_t& m = meshlets[i];
+			bool visible = !has_view ||
+				(view_frustum.intersects_sphere(m.center, m.radius) && !meshlet_backfacing(m, view_position));
+
+			if (visible && run_start + run_size == m.start)
+				run_size += m.size;
+			else if (visible)
+			{
+				if (run_size)
+					device_context->DrawIndexed(run_size, run_start, irange.ofs);
+				run_start = m.start;
+				run_size = m.size;
+			}
+		}
+		if (run_size)
+			device_context->DrawIndexed(run_size, run_start, irange.ofs);
+#else
 		// make the drawcall
-		device_context->DrawIndexed(irange.size, irange.start, 0);
+		device_context->DrawIndexed(irange.size, irange.start, irange.ofs);
+#endif
 	}
 }
 
 
+void OBJModel_t::MapMatrixBuffers(
+	ID3D11DeviceContext* device_context,
+	ID3D11Buffer* matrix_buffer,
+	mat4f ModelToWorldMatrix,
+	mat4f WorldToViewMatrix,
+	mat4f ProjectionMatrix)
+{
+	// keep the view in model space for culling in render()
+	mat4f ModelToViewMatrix = WorldToViewMatrix * ModelToWorldMatrix;
+	view_frustum = frustum_t::from_matrix(ProjectionMatrix * ModelToViewMatrix);
+	vec4f eye = ModelToViewMatrix.affine_inverse() * vec4f(0, 0, 0, 1);
+	view_position = vec3f(eye.x, eye.y, eye.z) * (1.0f / eye.w);
+	view_projection_scale = ProjectionMatrix.m22;
+	has_view = true;
+
+	Geometry_t::MapMatrixBuffers(device_context, matrix_buffer, ModelToWorldMatrix, WorldToViewMatrix, ProjectionMatrix);
+}
+
 
-void Geometry_t::compute_tangentspace(vertex_t& v0, vertex_t& v1, vertex_t& v2)
+int OBJModel_t::select_lod(ID3D11DeviceContext* device_context) const
 {
-	vec3f tangent, binormal;
-	vec3f D, E;
-	vec2f F, G;
-
-	//LENGEYLS METHOD
-
-	//calculate distance between all vertex points (x,y,z). Then build traingle DE.
-	D = v1.Pos - v0.Pos;
-	E = v2.Pos - v0.Pos;
-
-	//calulate distance between all texture coordinate points (u,v). Then build triangle FG.
-	F = v1.TexCoord - v0.TexCoord;
-	G = v2.TexCoord - v0.TexCoord;
-
-	//Matris invers - calculation
-	mat2f FG;
-	FG.m11 = F.x;
-	FG.m12 = F.y;
-	FG.m21 = G.x;
-	FG.m22 = G.y;
-	FG.invert();
-
-	tangent.x = FG.m11 * D.x + FG.m12 * E.x;
-	tangent.y = FG.m11 * D.y + FG.m12 * E.y;
-	tangent.z = FG.m11 * D.y + FG.m12 * E.z;
-
-	binormal.x = FG.m21 * D.x + FG.m22 * E.x;
-	binormal.y = FG.m21 * D.y + FG.m22 * E.y;
-	binormal.z = FG.m21 * D.z + FG.m22 * E.z;
-
-	tangent.normalize();
-	binormal.normalize();
-
-	v0.Tangent = v1.Tangent = v2.Tangent = tangent;
-	v0.Binormal = v1.Binormal = v2.Binormal = binormal;
-}
\ No newline at end of file
+	if (!has_view || lod_errors.size() < 2)
+		return 0;
+
+	D3D11_VIEWPORT viewport;
+	UINT nbr_viewports = 1;
+	device_context->RSGetViewports(&nbr_viewports, &viewport);
+	if (!nbr_viewports)
+		return 0;
+
+	// pixels per model unit at the nearest point of the bounding sphere (errors and distances are
+	// both in model space, so uniform model scaling cancels out)
+	float distance = (bounds_center - view_position).norm2() - bounds_radius;
+	if (distance <= 0)
+		return 0;
+	float pixels_per_unit = view_projection_scale * 0.5f * viewport.Height / distance;
+
+	int lod = 0;
+	while (lod + 1 < (int)lod_errors.size() && lod_errors[lod + 1] * pixels_per_unit <= MESH_LOD_PIXEL_ERROR)
+		lod++;
+	return lod;
+}
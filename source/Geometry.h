@@ -14,10 +14,29 @@
 #include "vec\mat.h"
 #include "ShaderBuffers.h"
 #include "drawcall.h"
+#include "assetpack.h"
 #include "mesh.h"
+#include "meshcache.h"
+#include "meshcook.h"
+#include "meshopt.h"
+#include "meshlet.h"
+#include "meshsimplify.h"
+#include "texturecache.h"
+#include "imagedecode.h"
+#include "texturecompress.h"
+#include "vertexpack.h"
+
+#define INDEX_BUFFER_SPLIT_RANGES	// split drawcalls spanning > 65536 vertices so 16-bit indices can be used
+#define MESH_MESHLET_CULLING		// cull OBJ models per meshlet (frustum & normal cone) instead of per drawcall
 
 using namespace linalg;
 
+//
+// Material textures of all models: decoded by imagedecode.h or else WIC, uploaded once and shared
+// through a texture cache. device_data of its textures is an ID3D11ShaderResourceView*.
+//
+texture_cache_t& device_textures();
+
 class Geometry_t
 {
 protected:
@@ -29,6 +48,29 @@ protected:
 	ID3D11Buffer* MaterialBuffer = nullptr;
 	ID3D11SamplerState* SamplerState = nullptr;
 
+	// vertex buffer layout: stride of the uploaded vertices and the matrix
+	// that maps their (possibly quantized) positions to model space
+	UINT32 vertex_stride = sizeof(vertex_t);
+	mat4f vertex_dequantize = mat4f_identity;
+
+	//
+	// Create the vertex buffer, packed to packed_vertex_t if VERTEX_PACKED is defined
+	//
+	HRESULT create_vertex_buffer(ID3D11Device* device, const vertex_t* vertices, size_t nbr_vertices);
+
+	// format of the index buffer, bound by render()
+	DXGI_FORMAT index_format = DXGI_FORMAT_R32_UINT;
+
+	//
+	// Create the index buffer in the given format (R16_UINT or R32_UINT)
+	//
+	HRESULT create_index_buffer(ID3D11Device* device, const void* indices, size_t nbr_indices, DXGI_FORMAT format);
+
+	//
+	// Create the index buffer, 16-bit if the indices allow it
+	//
+	HRESULT create_index_buffer(ID3D11Device* device, const unsigned* indices, size_t nbr_indices);
+
 public:
 
 	Geometry_t(ID3D11Device* device);
@@ -52,9 +94,6 @@ public:
 
 	virtual void render(ID3D11DeviceContext* device_context) const = 0;
 
-
-	void compute_tangentspace(vertex_t& v0, vertex_t& v1, vertex_t& v2);
-
 	virtual ~Geometry_t()
 	{ 
 		// release the Krak-..device buffers
@@ -105,27 +144,75 @@ class OBJModel_t : public Geometry_t
 	{
 		size_t start;
 		size_t size;
-		unsigned ofs;
+		unsigned ofs;		// base vertex, added to the indices of the range
 		int mtl_index;
+		int lod;			// level of detail the range belongs to, 0 = full mesh
+		size_t meshlet_start, nbr_meshlets;		// meshlets covering the range
 	};
 
 	std::vector<index_range_t> index_ranges;
 	std::vector<material_t> materials;
+	std::vector<meshlet_t> meshlets;
+	std::vector<texture_t*> textures;	// references into device_textures()
+
+	// simplification error per LOD (model units), and bounding sphere for LOD selection
+	std::vector<float> lod_errors;
+	vec3f bounds_center;
+	float bounds_radius = 0;
+
+	// view of the last MapMatrixBuffers call, in model space, for culling & LOD selection
+	frustum_t view_frustum;
+	vec3f view_position;
+	float view_projection_scale = 1;	// cot(vfov/2), projected size of a unit at distance 1 in NDC
+	bool has_view = false;
 
 	void append_materials(const std::vector<material_t>& mtl_vec)
 	{
 		materials.insert(materials.end(), mtl_vec.begin(), mtl_vec.end());
 	}
 
+	//
+	// Rebase the indices of every range to 16 bits relative to the range's base vertex. With
+	// INDEX_BUFFER_SPLIT_RANGES, ranges spanning more than 65536 vertices are split into sub-ranges
+	// that fit. Returns false (ranges untouched) if the indices cannot be made to fit.
+	//
+	bool build_indices16(const unsigned* indices, size_t nbr_indices, std::vector<uint16_t>& indices16);
+
+	//
+	// Coarsest LOD whose error projects to at most MESH_LOD_PIXEL_ERROR pixels, at the distance
+	// of the bounding sphere from the last view, in the bound viewport
+	//
+	int select_lod(ID3D11DeviceContext* device_context) const;
+
+	// create the device resources from loaded model data
+	void create(const model_data_t& data, ID3D11Device* device);
+
+	// keep a texture acquired from device_textures() and return its view, uploading it on first use
+	ID3D11ShaderResourceView* use_texture(ID3D11Device* device, texture_t* texture);
+
 public:
 
 	OBJModel_t(
 		const std::string& objfile,
 		ID3D11Device* device);
 
+	//
+	// From model data loaded in the background (see modelloader.h), the data can be released afterwards
+	//
+	OBJModel_t(
+		const model_data_t& data,
+		ID3D11Device* device);
+
+	void MapMatrixBuffers(
+		ID3D11DeviceContext* device_context,
+		ID3D11Buffer* matrix_buffer,
+		mat4f ModelToWorldMatrix,
+		mat4f WorldToViewMatrix,
+		mat4f ProjectionMatrix);
+
 	void render(ID3D11DeviceContext* device_context) const;
 
-	~OBJModel_t() { }
+	~OBJModel_t();
 };
 
 #endif
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include "Camera.h"
 #include "PointLight.h"
 #include "Geometry.h"
+#include "modelloader.h"
 
 //--------------------------------------------------------------------------------------
 // Global Variables
@@ -58,6 +59,9 @@ pointlight_t* pointlight;
 float camera_vel = 1.5f;	// world unit/s
 Cube_t* cube;
 OBJModel_t* obj;
+// models are loaded in the background, the cube is drawn in place of obj until it is ready
+model_loader_t* model_loader;
+model_request_ptr obj_request;
 // model-to-world matrices
 mat4f Mtyre;
 mat4f Mquad;
@@ -83,19 +87,45 @@ void initObjects()
 	pointlight = new pointlight_t();
 	pointlight->moveTo({ 0, 5, 5 });
 
+	// assets are read from the pack of the assets directory if there is one, loose files otherwise
+	vfs_mount("../../assets.pack", "../../assets/");
+
 	// create objects
 	cube = new Cube_t(g_Device);
-	obj = new OBJModel_t("../../assets/WoodenCrate/WoodenCrate.obj", g_Device);
-	//obj = new OBJModel_t("../../assets/city/city.obj", g_Device);
+	obj = nullptr;
+	model_loader = new model_loader_t(1);
+	obj_request = model_loader->load("../../assets/WoodenCrate/WoodenCrate.obj");
+	//obj_request = model_loader->load("../../assets/city/city.obj");
 	//("../../assets/WoodenCrate/WoodenCrate.obj", g_Device);
 	//("../../assets/sphere/sphere.obj", g_Device);
 }
 
+//
+// per-frame, create the device resources of models whose data has been loaded
+//
+void pollModels()
+{
+	if (!obj_request || !obj_request->done())
+		return;
+
+	if (obj_request->ready())
+	{
+		obj = new OBJModel_t(obj_request->data, g_Device);
+		obj_request->data.release();
+		printf("loaded %s\n", obj_request->objfile.c_str());
+	}
+	else
+		printf("failed to load %s: %s\n", obj_request->objfile.c_str(), obj_request->error.c_str());
+	obj_request.reset();
+}
+
 //
 // per-frame, update object
 //
 void updateObjects(float dt)
 {
+	pollModels();
+
 	// basic camera control
 	if (g_InputHandler->IsKeyPressed(Keys::W))
 		camera->moveForward({ 0.0f, 0.0f, -camera_vel *dt });
@@ -151,9 +181,20 @@ void renderObjects()
 	//cube->MapMaterialBuffers(g_DeviceContext, g_MaterialBuffer, { 1, 0, 0, 0 });
 	//cube->render(g_DeviceContext);
 	
-	obj->MapMatrixBuffers(g_DeviceContext, g_MatrixBuffer, Mtyre, Mview, Mproj);
-	obj->MapMaterialBuffers(g_DeviceContext, g_MaterialBuffer, { 0.1f, 0.1f, 0.1f, 0 }, { 0.5f, 0.5f, 0.5f, 0.2f }, { 0.5f, 0.5f, 0.5f, 0 });
-	obj->render(g_DeviceContext);
+	if (obj)
+	{
+		obj->MapMatrixBuffers(g_DeviceContext, g_MatrixBuffer, Mtyre, Mview, Mproj);
+		obj->MapMaterialBuffers(g_DeviceContext, g_MaterialBuffer, { 0.1f, 0.1f, 0.1f, 0 }, { 0.5f, 0.5f, 0.5f, 0.2f }, { 0.5f, 0.5f, 0.5f, 0 });
+		obj->render(g_DeviceContext);
+	}
+	else if (obj_request)
+	{
+		// placeholder while loading, shaded by how far the load has come
+		float p = obj_request->progress;
+		cube->MapMatrixBuffers(g_DeviceContext, g_MatrixBuffer, Mtyre, Mview, Mproj);
+		cube->MapMaterialBuffers(g_DeviceContext, g_MaterialBuffer, { 0.1f, 0.1f, 0.1f, 0 }, { p, p, p, 0 }, { 0, 0, 0, 0 });
+		cube->render(g_DeviceContext);
+	}
 }
 
 //
@@ -161,8 +202,17 @@ void renderObjects()
 //
 void releaseObjects()
 {
+	// finish or cancel background loads before the vfs goes away
+	obj_request.reset();
+	SAFE_DELETE(model_loader);
+
 	SAFE_DELETE(cube);
 	SAFE_DELETE(obj);
+
+	// textures no longer referenced by any model
+	device_textures().trim();
+
+	vfs_unmount_all();
 }
 
 //--------------------------------------------------------------------------------------
@@ -354,8 +404,19 @@ HRESULT CreateShadersAndInputLayout()
 {
 	HRESULT hr = S_OK;
 
+	// the vertex shader decodes the vertex format that Geometry_t uploads
+	D3D10_SHADER_MACRO vsDefines[] = {
+#ifdef VERTEX_PACKED
+		{ "PACKED_VERTICES", "1" },
+#endif
+#ifdef VERTEX_QUANTIZED_POSITIONS
+		{ "QUANTIZED_POSITIONS", "1" },
+#endif
+		{ nullptr, nullptr }
+	};
+
 	ID3DBlob* pVertexShader = nullptr;
-	if(SUCCEEDED(hr = CompileShader("../Shaders/DrawTri.vs", "VS_main", "vs_5_0", nullptr, &pVertexShader)))
+	if(SUCCEEDED(hr = CompileShader("../Shaders/DrawTri.vs", "VS_main", "vs_5_0", vsDefines, &pVertexShader)))
 	{
 		if(SUCCEEDED(hr = g_Device->CreateVertexShader(
 			pVertexShader->GetBufferPointer(),
@@ -363,6 +424,19 @@ HRESULT CreateShadersAndInputLayout()
 			nullptr,
 			&g_VertexShader)))
 		{
+#ifdef VERTEX_PACKED
+			// packed_vertex_t, see vertexpack.h
+			D3D11_INPUT_ELEMENT_DESC inputDesc[] = {
+#ifdef VERTEX_QUANTIZED_POSITIONS
+				{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, offsetof(packed_vertex_t, Pos), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+#else
+				{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(packed_vertex_t, Pos), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+#endif
+				{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, offsetof(packed_vertex_t, Normal), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+				{ "TANGENT", 0, DXGI_FORMAT_R8G8B8A8_SNORM, 0, offsetof(packed_vertex_t, Tangent), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+				{ "TEX", 0, DXGI_FORMAT_R16G16_FLOAT, 0, offsetof(packed_vertex_t, TexCoord), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			};
+#else
 			D3D11_INPUT_ELEMENT_DESC inputDesc[] = {
 				{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
 				{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
@@ -370,6 +444,7 @@ HRESULT CreateShadersAndInputLayout()
 				{ "BINORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 36, D3D11_INPUT_PER_VERTEX_DATA, 0 },
 				{ "TEX", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 48, D3D11_INPUT_PER_VERTEX_DATA, 0 },
 			};
+#endif
 			//D3D11_INPUT_ELEMENT_DESC inputDesc[] = {
 			//	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
 			//	{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
@@ -0,0 +1,519 @@
+//
+//  assetpack.cpp
+//
+
+#include <cstdio>
+#include <iostream>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "assetpack.h"
+
+//
+// file layout: header, index entries, string table, then the entry data at aligned offsets
+//
+struct asset_pack_header_t
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t nbr_entries;
+	uint64_t file_size;			// detects truncation
+	uint64_t index_hash;		// hash of the entries & string table, detects corruption
+	uint64_t entries_ofs, strings_ofs, strings_size;
+};
+
+static const char asset_pack_magic[8] = { 'E', 'D', 'U', 'P', 'A', 'C', 'K', 0 };
+
+static uint64_t align_pack(uint64_t ofs)
+{
+	return (ofs + ASSET_PACK_ALIGNMENT - 1) & ~(uint64_t)(ASSET_PACK_ALIGNMENT - 1);
+}
+
+// path order of the index
+static int compare_path(const char* a, size_t alen, const char* b, size_t blen)
+{
+	int c = memcmp(a, b, std::min(alen, blen));
+	return c ? c : (alen < blen ? -1 : (alen > blen ? 1 : 0));
+}
+
+bool asset_pack_t::open(const std::string& packfile)
+{
+	close();
+
+	if (!file.map(packfile.c_str()))
+		return false;
+
+	asset_pack_header_t header;
+	if (file.size < sizeof(header))
+	{
+		close();
+		return false;
+	}
+	memcpy(&header, file.data, sizeof(header));
+
+	bool valid =
+		!memcmp(header.magic, asset_pack_magic, sizeof(asset_pack_magic)) &&
+		header.version == ASSET_PACK_VERSION &&
+		header.file_size == file.size &&
+		header.entries_ofs <= file.size &&
+		header.nbr_entries <= (file.size - header.entries_ofs) / sizeof(asset_pack_entry_t) &&
+		header.strings_ofs == header.entries_ofs + header.nbr_entries * sizeof(asset_pack_entry_t) &&
+		header.strings_size <= file.size - header.strings_ofs &&
+		hash_bytes(file.data + header.entries_ofs, (size_t)(header.strings_ofs + header.strings_size - header.entries_ofs)) == header.index_hash;
+
+	if (!valid)
+	{
+		printf("asset pack %s is invalid, ignoring it\n", packfile.c_str());
+		close();
+		return false;
+	}
+
+	entries = (const asset_pack_entry_t*)(file.data + header.entries_ofs);
+	strings = file.data + header.strings_ofs;
+	nbr_entries = header.nbr_entries;
+
+	// entries within the file and sorted, so find() can search them
+	for (size_t i = 0; i < nbr_entries; i++)
+	{
+		const asset_pack_entry_t& e = entries[i];
+		bool entry_valid =
+			e.offset <= file.size && e.size <= file.size - e.offset &&
+			e.path_ofs <= header.strings_size && e.path_len <= header.strings_size - e.path_ofs &&
+			(e.compression == ASSET_STORED ? e.size == e.raw_size : e.compression == ASSET_LZ) &&
+			(!i || compare_path(strings + entries[i-1].path_ofs, entries[i-1].path_len, strings + e.path_ofs, e.path_len) < 0);
+		if (!entry_valid)
+		{
+			printf("asset pack %s is invalid, ignoring it\n", packfile.c_str());
+			close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void asset_pack_t::close()
+{
+	file.close();
+	entries = nullptr;
+	strings = nullptr;
+	nbr_entries = 0;
+}
+
+const asset_pack_entry_t* asset_pack_t::find(const std::string& path) const
+{
+	size_t lo = 0, hi = nbr_entries;
+	while (lo < hi)
+	{
+		size_t mid = (lo + hi) / 2;
+		int c = compare_path(strings + entries[mid].path_ofs, entries[mid].path_len, path.data(), path.size());
+		if (!c)
+			return &entries[mid];
+		if (c < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return nullptr;
+}
+
+bool asset_pack_t::read(const asset_pack_entry_t& entry, mapped_file_t& dst) const
+{
+	const char* data = file.data + entry.offset;
+
+	if (entry.compression == ASSET_STORED)
+	{
+		dst.view(data, (size_t)entry.size);
+		return true;
+	}
+
+	char* buffer = dst.allocate((size_t)entry.raw_size);
+	if (!buffer ||
+		!lz_decompress(data, (size_t)entry.size, buffer, (size_t)entry.raw_size) ||
+		hash_bytes(buffer, (size_t)entry.raw_size) != entry.hash)
+	{
+		dst.close();
+		return false;
+	}
+	return true;
+}
+
+bool asset_pack_t::write(const std::string& packfile,
+						 const std::string& root_dir,
+						 const std::vector<std::string>& files,
+						 bool compress)
+{
+	std::vector<std::string> paths(files);
+	std::sort(paths.begin(), paths.end());
+	paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+	std::string strings;
+	std::vector<asset_pack_entry_t> entries(paths.size());
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		entries[i].path_ofs = (uint32_t)strings.size();
+		entries[i].path_len = (uint32_t)paths[i].size();
+		strings += paths[i];
+	}
+
+	asset_pack_header_t header = {};
+	memcpy(header.magic, asset_pack_magic, sizeof(asset_pack_magic));
+	header.version = ASSET_PACK_VERSION;
+	header.nbr_entries = (uint32_t)entries.size();
+	header.entries_ofs = sizeof(header);
+	header.strings_ofs = header.entries_ofs + entries.size() * sizeof(asset_pack_entry_t);
+	header.strings_size = strings.size();
+
+	// the index size is known up front, so entries are streamed to the file after it and
+	// the index is written last
+	//
+	std::string tmpfile = packfile + ".tmp";
+	FILE* fp = fopen(tmpfile.c_str(), "wb");
+	if (!fp)
+		return false;
+
+	std::vector<char> zeros(ASSET_PACK_ALIGNMENT, 0), packed;
+	uint64_t ofs = 0;
+	auto put = [&](const void* data, size_t size) -> bool
+	{
+		ofs += size;
+		return !size || fwrite(data, 1, size, fp) == size;
+	};
+	auto pad = [&]() -> bool
+	{
+		return put(zeros.data(), (size_t)(align_pack(ofs) - ofs));
+	};
+
+	// identical content is stored once: (hash, size) -> first entry with it
+	std::unordered_map<uint64_t, size_t> stored;
+	uint64_t raw_total = 0;
+
+	bool written = put(&header, sizeof(header)) && put(entries.data(), entries.size() * sizeof(asset_pack_entry_t)) && put(strings.data(), strings.size());
+	for (size_t i = 0; i < paths.size() && written; i++)
+	{
+		asset_pack_entry_t& e = entries[i];
+		std::string srcfile = root_dir + "/" + paths[i];
+
+		mapped_file_t src;
+		if (!src.map(srcfile.c_str()))
+		{
+			printf("failed to read %s\n", srcfile.c_str());
+			written = false;
+			break;
+		}
+		e.raw_size = src.size;
+		e.hash = hash_bytes(src.data, src.size);
+		raw_total += src.size;
+
+		auto dup = stored.find(e.hash ^ e.raw_size);
+		if (dup != stored.end() && entries[dup->second].raw_size == e.raw_size)
+		{
+			// same hash & size: compare with the first copy before sharing its data
+			mapped_file_t first;
+			if (first.map((root_dir + "/" + paths[dup->second]).c_str()) && first.size == src.size && !memcmp(first.data, src.data, src.size))
+			{
+				e.offset = entries[dup->second].offset;
+				e.size = entries[dup->second].size;
+				e.compression = entries[dup->second].compression;
+				continue;
+			}
+		}
+		stored[e.hash ^ e.raw_size] = i;
+
+		const char* data = src.data;
+		e.size = src.size;
+		e.compression = ASSET_STORED;
+		if (compress && src.size && src.size < 0xffffffffu)
+		{
+			lz_compress(src.data, src.size, packed);
+			if (packed.size() <= src.size * (1 - ASSET_PACK_MIN_SAVING))
+			{
+				data = packed.data();
+				e.size = packed.size();
+				e.compression = ASSET_LZ;
+			}
+		}
+
+		written = pad();
+		e.offset = ofs;
+		written = written && put(data, (size_t)e.size);
+	}
+	header.file_size = ofs;
+
+	// index last
+	if (written)
+	{
+		std::vector<char> index(sizeof(asset_pack_entry_t) * entries.size() + strings.size());
+		if (entries.size())
+			memcpy(index.data(), entries.data(), entries.size() * sizeof(asset_pack_entry_t));
+		if (strings.size())
+			memcpy(index.data() + entries.size() * sizeof(asset_pack_entry_t), strings.data(), strings.size());
+		header.index_hash = hash_bytes(index.data(), index.size());
+
+		written =
+			!fseek(fp, 0, SEEK_SET) &&
+			fwrite(&header, sizeof(header), 1, fp) == 1 &&
+			(index.empty() || fwrite(index.data(), 1, index.size(), fp) == index.size());
+	}
+	written &= (fclose(fp) == 0);
+
+	if (written)
+	{
+		remove(packfile.c_str());
+		written = (rename(tmpfile.c_str(), packfile.c_str()) == 0);
+	}
+	if (!written)
+	{
+		remove(tmpfile.c_str());
+		return false;
+	}
+
+	printf("wrote asset pack %s: %d entries, %.1f MB -> %.1f MB\n", packfile.c_str(), (int)entries.size(), raw_total / 1048576.0, header.file_size / 1048576.0);
+	return true;
+}
+
+//
+// LZ4 block format: sequences of
+//   token (literal length << 4 | match length - 4), [length bytes], literals, offset (16-bit LE), [length bytes]
+// where a nibble of 15 continues in bytes of 255 ending with one < 255. The last sequence has
+// literals only, the last 5 bytes are always literals and no match starts in the last 12 bytes.
+//
+static const size_t LZ_MIN_MATCH = 4;
+static const size_t LZ_LAST_LITERALS = 5;
+static const size_t LZ_MATCH_LIMIT = 12;
+static const unsigned LZ_HASH_BITS = 16;
+
+static void lz_put_length(std::vector<char>& dst, size_t len)
+{
+	for (; len >= 255; len -= 255)
+		dst.push_back((char)255);
+	dst.push_back((char)len);
+}
+
+void lz_compress(const char* src, size_t size, std::vector<char>& dst)
+{
+	dst.clear();
+	dst.reserve(size + size / 255 + 16);
+
+	const unsigned char* in = (const unsigned char*)src;
+	std::vector<uint32_t> table(1 << LZ_HASH_BITS, 0);
+
+	auto emit = [&](size_t anchor, size_t lit_len, size_t offset, size_t match_len)
+	{
+		size_t ml = match_len ? match_len - LZ_MIN_MATCH : 0;
+		dst.push_back((char)((std::min<size_t>(lit_len, 15) << 4) | std::min<size_t>(ml, 15)));
+		if (lit_len >= 15)
+			lz_put_length(dst, lit_len - 15);
+		dst.insert(dst.end(), src + anchor, src + anchor + lit_len);
+		if (!match_len)
+			return;
+		dst.push_back((char)(offset & 0xff));
+		dst.push_back((char)(offset >> 8));
+		if (ml >= 15)
+			lz_put_length(dst, ml - 15);
+	};
+
+	size_t anchor = 0, i = 1;
+	size_t match_limit = size > LZ_MATCH_LIMIT ? size - LZ_MATCH_LIMIT : 0;
+	while (i < match_limit)
+	{
+		uint32_t seq;
+		memcpy(&seq, in + i, 4);
+		uint32_t h = (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+		size_t ref = table[h];
+		table[h] = (uint32_t)i;
+
+		if (ref >= i || i - ref > 0xffff || memcmp(in + ref, in + i, LZ_MIN_MATCH))
+		{
+			// skip faster through data that does not compress (png, jpg)
+			i += 1 + ((i - anchor) >> 6);
+			continue;
+		}
+
+		size_t len = LZ_MIN_MATCH;
+		while (i + len < size - LZ_LAST_LITERALS && in[ref + len] == in[i + len])
+			len++;
+		while (i > anchor && ref > 0 && in[i - 1] == in[ref - 1])
+		{
+			i--; ref--; len++;
+		}
+
+		emit(anchor, i - anchor, i - ref, len);
+		i += len;
+		anchor = i;
+	}
+	emit(anchor, size - anchor, 0, 0);
+}
+
+bool lz_decompress(const char* src, size_t size, char* dst, size_t raw_size)
+{
+	const unsigned char* ip = (const unsigned char*)src;
+	const unsigned char* iend = ip + size;
+	size_t op = 0;
+
+	auto get_length = [&](size_t& len) -> bool
+	{
+		unsigned b;
+		do
+		{
+			if (ip >= iend)
+				return false;
+			b = *ip++;
+			len += b;
+		} while (b == 255);
+		return true;
+	};
+
+	while (ip < iend)
+	{
+		unsigned token = *ip++;
+
+		size_t lit_len = token >> 4;
+		if (lit_len == 15 && !get_length(lit_len))
+			return false;
+		if (lit_len > (size_t)(iend - ip) || lit_len > raw_size - op)
+			return false;
+		memcpy(dst + op, ip, lit_len);
+		ip += lit_len;
+		op += lit_len;
+
+		// the last sequence has no match
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return false;
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (!offset || offset > op)
+			return false;
+
+		size_t match_len = token & 15;
+		if (match_len == 15 && !get_length(match_len))
+			return false;
+		match_len += LZ_MIN_MATCH;
+		if (match_len > raw_size - op)
+			return false;
+
+		// matches may overlap their own output (runs): copy in chunks that do not, each twice the last
+		const char* match = dst + op - offset;
+		while (match_len)
+		{
+			size_t n = std::min(match_len, (size_t)(dst + op - match));
+			memcpy(dst + op, match, n);
+			op += n;
+			match_len -= n;
+		}
+	}
+	return op == raw_size;
+}
+
+//
+// virtual filesystem: mounted packs, searched last mounted first
+//
+struct vfs_mount_t
+{
+	std::string dir;	// normalized, empty or ending with '/'
+	std::unique_ptr<asset_pack_t> pack;
+};
+
+static std::vector<vfs_mount_t> vfs_mounts;
+static std::mutex vfs_mutex;
+
+std::string vfs_normalize_path(const std::string& path)
+{
+	std::string p(path);
+	std::replace(p.begin(), p.end(), '\\', '/');
+
+	// keep a root ("/" or a drive "C:/") as it is
+	size_t root = 0;
+	if (p.size() > 1 && p[1] == ':')
+		root = (p.size() > 2 && p[2] == '/') ? 3 : 2;
+	else if (p.size() && p[0] == '/')
+		root = 1;
+
+	std::vector<std::string> parts;
+	size_t start = root;
+	while (start <= p.size())
+	{
+		size_t end = p.find('/', start);
+		if (end == std::string::npos)
+			end = p.size();
+		std::string part = p.substr(start, end - start);
+
+		if (part == "..")
+		{
+			if (parts.size() && parts.back() != "..")
+				parts.pop_back();
+			else if (!root)
+				parts.push_back(part);
+		}
+		else if (part.size() && part != ".")
+			parts.push_back(part);
+		start = end + 1;
+	}
+
+	std::string res = p.substr(0, root);
+	for (size_t i = 0; i < parts.size(); i++)
+		res += (i ? "/" : "") + parts[i];
+	return res;
+}
+
+bool vfs_mount(const std::string& packfile, const std::string& mount_dir)
+{
+	std::unique_ptr<asset_pack_t> pack(new asset_pack_t());
+	if (!pack->open(packfile))
+		return false;
+
+	vfs_mount_t mount;
+	mount.dir = vfs_normalize_path(mount_dir);
+	if (mount.dir.size() && mount.dir.back() != '/')
+		mount.dir += "/";
+	printf("mounted asset pack %s at '%s', %d entries\n", packfile.c_str(), mount.dir.c_str(), (int)pack->size());
+	mount.pack = std::move(pack);
+
+	std::lock_guard<std::mutex> lock(vfs_mutex);
+	vfs_mounts.push_back(std::move(mount));
+	return true;
+}
+
+void vfs_unmount_all()
+{
+	std::lock_guard<std::mutex> lock(vfs_mutex);
+	vfs_mounts.clear();
+}
+
+// the pack and entry holding a path, if any. Packs stay mounted while their files are in use.
+static const asset_pack_t* vfs_find(const std::string& path, const asset_pack_entry_t*& entry)
+{
+	std::lock_guard<std::mutex> lock(vfs_mutex);
+	if (vfs_mounts.empty())
+		return nullptr;
+
+	std::string p = vfs_normalize_path(path);
+	for (auto m = vfs_mounts.rbegin(); m != vfs_mounts.rend(); ++m)
+	{
+		if (p.compare(0, m->dir.size(), m->dir))
+			continue;
+		if ((entry = m->pack->find(p.substr(m->dir.size()))))
+			return m->pack.get();
+	}
+	return nullptr;
+}
+
+bool vfs_open(const std::string& path, mapped_file_t& file, bool map)
+{
+	const asset_pack_entry_t* entry;
+	if (const asset_pack_t* pack = vfs_find(path, entry))
+		return pack->read(*entry, file);
+
+	return map ? file.map(path.c_str()) : file.read(path.c_str());
+}
+
+bool vfs_exists(const std::string& path)
+{
+	const asset_pack_entry_t* entry;
+	unsigned long long size;
+	long long mtime;
+	return vfs_find(path, entry) || file_stat(path.c_str(), size, mtime);
+}
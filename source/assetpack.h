@@ -0,0 +1,117 @@
+//
+//  assetpack.h
+//
+//  Asset pack: a single archive file holding a directory tree of assets, with an index of all
+//  entries up front and every entry starting on a 4 KiB boundary. Packs are memory-mapped, so an
+//  uncompressed entry is read without any copy. Entries may be compressed with a small LZ4-style
+//  block codec, which the pack writer only keeps where it pays off (not for png/jpg data).
+//
+//  The virtual filesystem on top resolves paths through the mounted packs first and falls back
+//  to loose files, so loaders (obj, mtl, mesh caches, textures) work the same with and without packs.
+//
+
+#pragma once
+#ifndef ASSETPACK_H
+#define ASSETPACK_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "file_rw.h"
+
+#define ASSET_PACK_SUFFIX ".pack"
+#define ASSET_PACK_VERSION 1
+#define ASSET_PACK_ALIGNMENT 4096
+#define ASSET_PACK_MIN_SAVING 0.125f	// compressed entries are kept if at least this much smaller
+
+enum asset_compression_t
+{
+	ASSET_STORED = 0,
+	ASSET_LZ = 1,
+};
+
+//
+// index entry, the index is sorted by path
+//
+struct asset_pack_entry_t
+{
+	uint64_t offset;		// from the start of the pack, ASSET_PACK_ALIGNMENT aligned
+	uint64_t size;			// stored size
+	uint64_t raw_size;		// size when decompressed
+	uint64_t hash;			// hash_bytes() of the raw content
+	uint32_t compression;	// asset_compression_t
+	uint32_t path_ofs, path_len;	// into the string table, '/'-separated and relative to the pack root
+	uint32_t reserved;
+};
+
+class asset_pack_t
+{
+	mapped_file_t file;
+	const asset_pack_entry_t* entries = nullptr;
+	const char* strings = nullptr;
+	size_t nbr_entries = 0;
+
+public:
+
+	//
+	// Map and validate a pack. Fails if the file is missing, has another version, is truncated
+	// or its index is corrupt.
+	//
+	bool open(const std::string& packfile);
+
+	void close();
+
+	size_t size() const { return nbr_entries; }
+	std::string path(size_t i) const { return std::string(strings + entries[i].path_ofs, entries[i].path_len); }
+	const asset_pack_entry_t& entry(size_t i) const { return entries[i]; }
+
+	// entry of a path relative to the pack root, nullptr if there is none
+	const asset_pack_entry_t* find(const std::string& path) const;
+
+	//
+	// Content of an entry: a view into the mapped pack if it is stored, decompressed into a buffer
+	// owned by file otherwise. Fails if the entry does not decompress to its size and hash.
+	//
+	bool read(const asset_pack_entry_t& entry, mapped_file_t& file) const;
+
+	//
+	// Write the files below root_dir (paths relative to it) as a pack. Identical files are stored
+	// once. With compress, entries are LZ-compressed where that saves ASSET_PACK_MIN_SAVING.
+	//
+	static bool write(const std::string& packfile,
+					  const std::string& root_dir,
+					  const std::vector<std::string>& files,
+					  bool compress);
+};
+
+//
+// LZ4-style block codec (LZ4 block layout: token, literals, 16-bit offset, extended lengths)
+//
+void lz_compress(const char* src, size_t size, std::vector<char>& dst);
+bool lz_decompress(const char* src, size_t size, char* dst, size_t raw_size);
+
+//
+// Virtual filesystem
+//
+// vfs_mount: make the entries of a pack visible under a directory, e.g. the pack of the assets
+// directory under "../../assets/". Later mounts take precedence.
+//
+bool vfs_mount(const std::string& packfile, const std::string& mount_dir);
+void vfs_unmount_all();
+
+//
+// Open a file through the mounted packs, or from disk if no pack holds it. Stored pack entries are
+// views into the mapped pack, loose files are memory-mapped if map is set (otherwise read in bulk).
+//
+bool vfs_open(const std::string& path, mapped_file_t& file, bool map = true);
+
+bool vfs_exists(const std::string& path);
+
+//
+// collapse "." and ".." components and use '/' separators, so paths from different
+// loaders match the pack index
+//
+std::string vfs_normalize_path(const std::string& path);
+
+#endif
@@ -0,0 +1,475 @@
+//
+//  cooker.cpp
+//
+//  Offline asset cooker: runs the OBJ import pipeline (meshcook.h) ahead of time and writes the
+//  mesh caches the renderer maps on load, so no parsing, welding, tangent generation or
+//  simplification happens at startup.
+//
+//  cooker [-j threads] [-f] [-c] [-p packfile [-z]] [-l] [-t] [-m] [-k] [-b] <obj file | directory> ...
+//
+//  Directories are searched recursively for .obj files. A model is skipped if its cache is valid,
+//  i.e. its data hashes as written and the obj and its mtl files have the size and mtime, or else
+//  the content hash, they were cooked from (-f cooks everything). Models are cooked in parallel, one per thread (-j, default one per
+//  hardware thread).
+//
+//  -c then block-compresses the color & normal maps of the models' materials to .dds files
+//  (texturecompress.h) the renderer uploads instead of the source images, skipping those already
+//  compressed from the current source unless -f. Reports the PSNR and throughput of each.
+//
+//  -p then writes everything below the (single) directory, caches included, to an asset pack
+//  (assetpack.h), -z with compressed entries where that pays off.
+//
+//  -l instead loads the models the way the renderer does, through the background loader
+//  (modelloader.h) with -j models in flight, and reports the wall time until all are ready.
+//
+//  -t benchmarks the texture pipeline on the png/tga files instead: decode, then decode + mip chain,
+//  serially and on -j threads.
+//
+//  -m checks the SIMD paths of the linalg library against the generic code and benchmarks both
+//  (linalgbench.h), batched transforms also on -j threads. No input needed.
+//
+//  -k checks the mesh processing passes against golden values and invariants on generated meshes
+//  (meshcheck.h). No input needed.
+//
+//  -b benchmarks the OBJ loader on a generated file of a million faces (meshbench.h), on 1 to 16
+//  parser threads, vertex welding on generated smooth and hard-edged meshes, shared against
+//  per-drawcall welding on one with many usemtl, and normal generation, also on -j threads. No
+//  input needed.
+//
+//  Headless and platform-independent, built from the Cooker project or e.g.
+//  g++ -std=c++11 -O2 -I. -Ivec cooker.cpp assetpack.cpp modelloader.cpp texturecache.cpp texturemips.cpp texturecompress.cpp imagedecode.cpp linalgbench.cpp meshbench.cpp meshcheck.cpp meshcook.cpp meshlet.cpp meshcache.cpp mesh.cpp meshopt.cpp meshsimplify.cpp vec/vec.cpp vec/mat.cpp vec/transform.cpp vec/quat.cpp -lpthread
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+
+#include "meshcook.h"
+#include "assetpack.h"
+#include "modelloader.h"
+#include "texturecache.h"
+#include "imagedecode.h"
+#include "texturecompress.h"
+#include "linalgbench.h"
+#include "meshbench.h"
+#include "meshcheck.h"
+
+struct cook_job_t
+{
+	std::string objfile;
+	unsigned long long size;
+};
+
+static bool is_directory(const std::string& path)
+{
+	struct stat st;
+	return !stat(path.c_str(), &st) && (st.st_mode & S_IFMT) == S_IFDIR;
+}
+
+// case-insensitive
+static bool has_suffix(const std::string& name, const std::string& suffix)
+{
+	if (name.size() < suffix.size())
+		return false;
+	std::string s = name.substr(name.size() - suffix.size());
+	std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+	return s == suffix;
+}
+
+//
+// all files below a directory, as paths relative to it
+//
+static void find_files(const std::string& dir, const std::string& rel_dir, std::vector<std::string>& files)
+{
+	std::vector<std::string> names;
+#ifdef _WIN32
+	WIN32_FIND_DATAA fd;
+	HANDLE h = FindFirstFileA((dir + "/*").c_str(), &fd);
+	if (h == INVALID_HANDLE_VALUE)
+		return;
+	do names.push_back(fd.cFileName); while (FindNextFileA(h, &fd));
+	FindClose(h);
+#else
+	DIR* d = opendir(dir.c_str());
+	if (!d)
+		return;
+	while (dirent* e = readdir(d))
+		names.push_back(e->d_name);
+	closedir(d);
+#endif
+
+	for (auto& name : names)
+	{
+		if (name == "." || name == "..")
+			continue;
+		std::string path = dir + "/" + name;
+		if (is_directory(path))
+			find_files(path, rel_dir + name + "/", files);
+		else
+			files.push_back(rel_dir + name);
+	}
+}
+
+static void print_usage()
+{
+	printf("usage: cooker [-j threads] [-f] [-c] [-p packfile [-z]] [-l] [-t] [-m] [-k] [-b] <obj file | directory> ...\n");
+	printf("  -j  number of models cooked in parallel (default: one per hardware thread)\n");
+	printf("  -f  cook all models, also those with an up-to-date cache\n");
+	printf("  -c  block-compress the material textures to .dds\n");
+	printf("  -p  write the directory to an asset pack after cooking\n");
+	printf("  -z  compress pack entries\n");
+	printf("  -l  load the models through the background loader and time it, instead of cooking\n");
+	printf("  -t  time texture decoding & mip generation of the png/tga files, instead of cooking\n");
+	printf("  -m  check & time the SIMD linalg paths, instead of cooking\n");
+	printf("  -k  check the mesh processing passes on generated meshes, instead of cooking\n");
+	printf("  -b  time the OBJ loader on a generated mesh, instead of cooking\n");
+}
+
+//
+// Load all models through the background loader, as the renderer does, and time it
+//
+static int load_models(const std::vector<cook_job_t>& jobs, unsigned nbr_workers)
+{
+	auto t0 = std::chrono::high_resolution_clock::now();
+
+	std::vector<model_request_ptr> requests;
+	{
+		model_loader_t loader(nbr_workers);
+		for (auto& job : jobs)
+			requests.push_back(loader.load(job.objfile));
+		loader.wait_idle();
+	}
+
+	auto t1 = std::chrono::high_resolution_clock::now();
+
+	int nbr_failed = 0;
+	size_t nbr_vertices = 0, nbr_indices = 0;
+	for (auto& request : requests)
+	{
+		if (request->ready())
+		{
+			nbr_vertices += request->data.nbr_vertices;
+			nbr_indices += request->data.nbr_indices;
+		}
+		else
+		{
+			printf("%s: FAILED - %s\n", request->objfile.c_str(), request->error.c_str());
+			nbr_failed++;
+		}
+	}
+	printf("%d loaded, %d failed, %.2f M vertices, %.2f M indices (%.2f s, %u models in flight)\n",
+		(int)(requests.size() - nbr_failed), nbr_failed, nbr_vertices * 1e-6, nbr_indices * 1e-6,
+		std::chrono::duration<double>(t1 - t0).count(), nbr_workers);
+
+	return nbr_failed ? 1 : 0;
+}
+
+//
+// Time the texture pipeline: decode only and decode + mips serially, then decode + mips in parallel,
+// each with an empty cache
+//
+static int time_textures(const std::vector<std::string>& images, unsigned nbr_threads)
+{
+	std::vector<texture_request_t> requests;
+	for (auto& f : images)
+		requests.push_back({ f, TEXTURE_MIPS | TEXTURE_SRGB, nullptr });
+
+	auto run = [&](const char* name, unsigned flags, unsigned threads) -> bool
+	{
+		for (auto& r : requests)
+			r.flags = flags;
+
+		texture_cache_t cache(decode_image);
+		auto t0 = std::chrono::high_resolution_clock::now();
+		cache.acquire_all(requests, threads);
+		auto t1 = std::chrono::high_resolution_clock::now();
+
+		texture_cache_stats_t ts = cache.stats();
+		printf("%-24s %3d textures, %7.1f MB, %8.1f ms (%u threads)\n", name,
+			(int)ts.misses, ts.decoded_bytes / (1024.0 * 1024.0),
+			std::chrono::duration<double, std::milli>(t1 - t0).count(), threads);
+		for (auto& r : requests)
+		{
+			if (!r.texture)
+				printf("  %s: FAILED\n", r.path.c_str());
+			cache.release(r.texture);
+		}
+		return !ts.failures;
+	};
+
+	bool ok = run("decode, serial", 0, 1);
+	ok &= run("decode + mips, serial", TEXTURE_MIPS | TEXTURE_SRGB, 1);
+	ok &= run("decode + mips, parallel", TEXTURE_MIPS | TEXTURE_SRGB, nbr_threads);
+	return ok ? 0 : 1;
+}
+
+//
+// Block-compress the color (map_Kd) and normal (map_bump) maps of the cooked models, each once,
+// with the blocks of each texture on nbr_threads threads
+//
+static int cook_textures(const std::vector<cook_job_t>& jobs, bool force, unsigned nbr_threads)
+{
+	std::vector<std::pair<std::string, bool> > maps;
+	std::unordered_set<std::string> seen;	// a map used both ways is compressed as the first, the renderer decodes it for the other
+	for (auto& job : jobs)
+	{
+		mesh_cache_t cache;
+		if (!cache.load(mesh_cache_t::cache_path(job.objfile), true))
+			continue;
+		for (auto& mtl : cache.materials)
+		{
+			if (mtl.map_Kd.size() && seen.insert(vfs_normalize_path(mtl.map_Kd)).second)
+				maps.push_back({ mtl.map_Kd, false });
+			if (mtl.map_bump.size() && seen.insert(vfs_normalize_path(mtl.map_bump)).second)
+				maps.push_back({ mtl.map_bump, true });
+		}
+	}
+
+	static const char* format_names[] = { "RGBA8", "BC1", "BC3", "BC5" };
+	int nbr_cooked = 0, nbr_current = 0, nbr_failed = 0;
+	size_t raw_bytes = 0, compressed_bytes = 0;
+	double ms = 0;
+
+	for (auto& map : maps)
+	{
+		const std::string& file = map.first;
+		if (!force)
+		{
+			// up to date if the .dds was compressed from the current content of the map, for the same use
+			mapped_file_t source, dds;
+			texture_image_t image;
+			std::vector<texture_image_t> mips;
+			unsigned long long source_hash;
+			if (source.map(file.c_str()) && dds.map((file + TEXTURE_DDS_SUFFIX).c_str()) &&
+				read_dds(dds.data, dds.size, image, mips, source_hash) && source_hash == hash_bytes(source.data, source.size) &&
+				(image.format == TEXTURE_BC5) == map.second)
+			{
+				nbr_current++;
+				printf("%s: up to date\n", file.c_str());
+				continue;
+			}
+		}
+
+		texture_cook_stats_t stats;
+		if (!cook_texture(file, map.second, stats, nbr_threads))
+		{
+			nbr_failed++;
+			printf("%s: FAILED - missing, unsupported format or size not a multiple of 4\n", file.c_str());
+			continue;
+		}
+		nbr_cooked++;
+		raw_bytes += stats.raw_bytes;
+		compressed_bytes += stats.compressed_bytes;
+		ms += stats.ms;
+		printf("%s: %s %ux%u, PSNR %.2f dB, %.1f ms (%.1f MB/s)\n", file.c_str(), format_names[stats.format],
+			stats.width, stats.height, stats.psnr, stats.ms, stats.raw_bytes / (1024.0 * 1024.0) / (stats.ms * 1e-3));
+	}
+
+	printf("%d textures compressed, %d up to date, %d failed, %.1f MB -> %.1f MB (%.1f ms, %.1f MB/s, %u threads)\n",
+		nbr_cooked, nbr_current, nbr_failed, raw_bytes / (1024.0 * 1024.0), compressed_bytes / (1024.0 * 1024.0),
+		ms, ms > 0 ? raw_bytes / (1024.0 * 1024.0) / (ms * 1e-3) : 0.0, nbr_threads);
+
+	return nbr_failed ? 1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned nbr_workers = std::max(1u, std::thread::hardware_concurrency());
+	bool force = false, compress = false, load_test = false, texture_test = false, cook_maps = false, linalg_test = false, mesh_check_test = false, mesh_test = false;
+	std::string packfile;
+	std::vector<std::string> files, images, dirs;
+	int nbr_inputs = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-j" && i + 1 < argc)
+			nbr_workers = std::max(1, atoi(argv[++i]));
+		else if (arg == "-f")
+			force = true;
+		else if (arg == "-p" && i + 1 < argc)
+			packfile = argv[++i];
+		else if (arg == "-c")
+			cook_maps = true;
+		else if (arg == "-z")
+			compress = true;
+		else if (arg == "-l")
+			load_test = true;
+		else if (arg == "-t")
+			texture_test = true;
+		else if (arg == "-m")
+			linalg_test = true;
+		else if (arg == "-k")
+			mesh_check_test = true;
+		else if (arg == "-b")
+			mesh_test = true;
+		else if (arg[0] == '-')
+		{
+			print_usage();
+			return 1;
+		}
+		else
+		{
+			// '/' separators work on all platforms, and get_parentdir only knows those
+			std::replace(arg.begin(), arg.end(), '\\', '/');
+			while (arg.size() > 1 && arg.back() == '/')
+				arg.pop_back();
+			nbr_inputs++;
+
+			if (is_directory(arg))
+			{
+				std::vector<std::string> dir_files;
+				find_files(arg, "", dir_files);
+				for (auto& f : dir_files)
+				{
+					if (has_suffix(f, ".obj"))
+						files.push_back(arg + "/" + f);
+					else if (has_suffix(f, ".png") || has_suffix(f, ".tga"))
+						images.push_back(arg + "/" + f);
+				}
+				dirs.push_back(arg);
+			}
+			else if (has_suffix(arg, ".png") || has_suffix(arg, ".tga"))
+				images.push_back(arg);
+			else
+				files.push_back(arg);
+		}
+	}
+	if (linalg_test)
+		return linalg_bench(nbr_workers) ? 0 : 1;
+	if (mesh_check_test)
+		return mesh_check() ? 0 : 1;
+	if (mesh_test)
+		return mesh_bench(nbr_workers) ? 0 : 1;
+
+	if (!nbr_inputs || (packfile.size() && (dirs.size() != 1 || nbr_inputs != 1)))
+	{
+		print_usage();
+		return 1;
+	}
+
+	if (texture_test)
+		return time_textures(images, nbr_workers);
+
+	// largest models first, so one big model does not end up last on a single thread
+	//
+	std::vector<cook_job_t> jobs;
+	for (auto& f : files)
+	{
+		unsigned long long size = 0;
+		long long mtime;
+		file_stat(f.c_str(), size, mtime);
+		jobs.push_back({ f, size });
+	}
+	std::sort(jobs.begin(), jobs.end(), [](const cook_job_t& a, const cook_job_t& b) { return a.size > b.size; });
+
+	unsigned nbr_threads = nbr_workers;
+	nbr_workers = (unsigned)std::max<size_t>(1, std::min<size_t>(nbr_workers, jobs.size()));
+
+	if (load_test)
+		return load_models(jobs, nbr_workers);
+
+	// models are cooked one per worker, so the pipeline itself runs serially unless there is only one worker
+	unsigned pipeline_threads = nbr_workers > 1 ? 1 : 0;
+
+	std::atomic<size_t> next_job(0);
+	std::atomic<int> nbr_cooked(0), nbr_current(0), nbr_failed(0);
+	std::mutex print_mutex;
+
+	auto report = [&](const std::string& objfile, const char* status)
+	{
+		std::lock_guard<std::mutex> lock(print_mutex);
+		printf("%s: %s\n", objfile.c_str(), status);
+	};
+
+	auto worker = [&]()
+	{
+		for (size_t i; (i = next_job++) < jobs.size(); )
+		{
+			const std::string& objfile = jobs[i].objfile;
+			std::string cachefile = mesh_cache_t::cache_path(objfile);
+
+			if (!force)
+			{
+				mesh_cache_t cache;
+				if (cache.load(cachefile, true))
+				{
+					nbr_current++;
+					report(objfile, "up to date");
+					continue;
+				}
+			}
+
+			try
+			{
+				cooked_mesh_t cooked;
+				cook_mesh(objfile, cooked, pipeline_threads);
+				if (!save_cooked_mesh(cachefile, cooked))
+					throw std::runtime_error("failed to write " + cachefile);
+
+				nbr_cooked++;
+				report(objfile, "cooked");
+			}
+			catch (const std::exception& e)
+			{
+				nbr_failed++;
+				report(objfile, (std::string("FAILED - ") + e.what()).c_str());
+			}
+		}
+	};
+
+	auto t0 = std::chrono::high_resolution_clock::now();
+
+	std::vector<std::thread> workers;
+	for (unsigned k = 1; k < nbr_workers; k++)
+		workers.push_back(std::thread(worker));
+	worker();
+	for (auto& w : workers)
+		w.join();
+
+	auto t1 = std::chrono::high_resolution_clock::now();
+	printf("%d cooked, %d up to date, %d failed (%.2f s, %u threads)\n",
+		(int)nbr_cooked, (int)nbr_current, (int)nbr_failed,
+		std::chrono::duration<double>(t1 - t0).count(), nbr_workers);
+
+	if (nbr_failed)
+		return 1;
+
+	if (cook_maps && cook_textures(jobs, force, nbr_threads))
+		return 1;
+
+	// pack the directory as it is now, with the caches just written
+	//
+	if (packfile.size())
+	{
+		std::vector<std::string> pack_files;
+		find_files(dirs[0], "", pack_files);
+
+		// leave out the pack itself and temporaries of interrupted writes
+		std::string pack_path = vfs_normalize_path(packfile);
+		pack_files.erase(std::remove_if(pack_files.begin(), pack_files.end(), [&](const std::string& f)
+		{
+			return vfs_normalize_path(dirs[0] + "/" + f) == pack_path || (f.size() > 4 && !f.compare(f.size() - 4, 4, ".tmp"));
+		}), pack_files.end());
+
+		if (!asset_pack_t::write(packfile, dirs[0], pack_files, compress))
+		{
+			printf("failed to write asset pack %s\n", packfile.c_str());
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -11,9 +11,13 @@
 #include <iostream>
 #include <vector>
 #include <unordered_map>
-#include "stdafx.h"
+#include <string>
 #include "vec/vec.h"
 
+// device types are only referenced, so meshes can be loaded without the D3D headers (e.g. by the cooker)
+struct ID3D11ShaderResourceView;
+struct ID3D11Resource;
+
 using namespace linalg;
 
 struct vertex_t
@@ -9,10 +9,25 @@
 #ifndef tau3d_file_rw_h
 #define tau3d_file_rw_h
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
 /**
  * mode e.g. "rb" (binary), "rt" (text)
+ * size, if given, receives the number of bytes read
  */
-static char* read_file(const char *filename, const char *mode)
+static char* read_file(const char *filename, const char *mode, long *size = NULL)
 {
     FILE *fp;
     char *content = NULL;
@@ -34,6 +49,7 @@ static char* read_file(const char *filename, const char *mode)
                 content[count] = '\0';
             }
             fclose(fp);
+            if (size) *size = count;
         } else {
             printf("EXITING : couldn't load file %s\n",filename);
             exit(77);
@@ -42,7 +58,7 @@ static char* read_file(const char *filename, const char *mode)
     return content;
 }
 
-static char* read_binary_file(const char *filename) { return read_file(filename, "rb"); }
+static char* read_binary_file(const char *filename, long *size = NULL) { return read_file(filename, "rb", size); }
 
 static char* read_text_file(const char *filename) { return read_file(filename, "rt"); }
 
@@ -67,4 +83,184 @@ static int file_write(char *fn, char *s, const char *mode)
     return(status);
 }
 
+/**
+ * size and modification time (seconds) of a file, false if it can't be stat'ed
+ */
+static bool file_stat(const char *filename, unsigned long long &size, long long &mtime)
+{
+    struct stat st;
+    if (stat(filename, &st))
+        return false;
+    
+    size = (unsigned long long)st.st_size;
+    mtime = (long long)st.st_mtime;
+    return true;
+}
+
+/**
+ * fast non-cryptographic 64-bit hash, 8 bytes per step
+ */
+static unsigned long long hash_bytes(const void *data, size_t size, unsigned long long seed = 0)
+{
+    const unsigned long long k0 = 0x9E3779B97F4A7C15ull, k1 = 0xFF51AFD7ED558CCDull;
+    const unsigned char *p = (const unsigned char*)data;
+    unsigned long long h = seed ^ (size * k0);
+    
+    for (size_t i = 0; i < size/8; i++, p += 8)
+    {
+        unsigned long long k;
+        memcpy(&k, p, 8);
+        k *= k1;
+        k ^= k >> 32;
+        h = (h ^ k) * k0;
+    }
+    
+    unsigned long long tail = 0;
+    memcpy(&tail, p, size & 7);
+    h = (h ^ tail * k1) * k0;
+    
+    // final avalanche
+    h ^= h >> 33; h *= k1;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * read-only view of a whole file
+ *
+ * map() memory-maps the file and falls back to one bulk read_file() if mapping
+ * is not possible, read() always does the bulk read. Either way the content is
+ * a contiguous [data, data+size) range that is NOT null-terminated. view() and
+ * allocate() let other sources (archives) hand out content the same way.
+ */
+struct mapped_file_t
+{
+    const char *data = NULL;
+    size_t size = 0;
+    
+    mapped_file_t() { }
+    mapped_file_t(const mapped_file_t&) = delete;
+    mapped_file_t& operator = (const mapped_file_t&) = delete;
+    ~mapped_file_t() { close(); }
+    
+    bool map(const char *filename)
+    {
+        close();
+        
+#ifdef _WIN32
+        HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        
+        LARGE_INTEGER file_size;
+        if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+        {
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping)
+            {
+                data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                if (data) size = (size_t)file_size.QuadPart;
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+#else
+        int fd = ::open(filename, O_RDONLY);
+        if (fd < 0)
+            return false;
+        
+        struct stat st;
+        if (!fstat(fd, &st) && st.st_size > 0)
+        {
+            void *view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view != MAP_FAILED)
+            {
+                madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+                data = (const char*)view;
+                size = (size_t)st.st_size;
+            }
+        }
+        ::close(fd);
+#endif
+        mapped = (data != NULL);
+        
+        // empty or unmappable file: fall back to a plain read
+        return mapped || read(filename);
+    }
+    
+    bool read(const char *filename)
+    {
+        close();
+        
+        FILE *fp = fopen(filename, "rb");
+        if (!fp)
+            return false;
+        fclose(fp);
+        
+        long count = 0;
+        buffer = read_binary_file(filename, &count);
+        data = buffer;
+        size = buffer ? (size_t)count : 0;
+        return true;
+    }
+    
+    /**
+     * non-owning view of memory that outlives this object, e.g. an entry of a mapped archive
+     */
+    void view(const char *view_data, size_t view_size)
+    {
+        close();
+        data = view_data;
+        size = view_size;
+    }
+    
+    /**
+     * owned buffer of buffer_size bytes for the caller to fill, e.g. with decompressed data
+     */
+    char* allocate(size_t buffer_size)
+    {
+        close();
+        buffer = (char*)malloc(buffer_size + 1);
+        if (!buffer)
+            return NULL;
+        data = buffer;
+        size = buffer_size;
+        return buffer;
+    }
+    
+    void close()
+    {
+        if (mapped)
+        {
+#ifdef _WIN32
+            UnmapViewOfFile(data);
+#else
+            munmap((void*)data, size);
+#endif
+        }
+        free(buffer);
+        data = buffer = NULL;
+        size = 0;
+        mapped = false;
+    }
+    
+private:
+    char *buffer = NULL;
+    bool mapped = false;
+};
+
+/**
+ * hash of a file's content, false if it can't be read
+ */
+static bool hash_file(const char *filename, unsigned long long &hash)
+{
+    mapped_file_t file;
+    if (!file.map(filename))
+        return false;
+    
+    hash = hash_bytes(file.data, file.size);
+    return true;
+}
+
 #endif
@@ -0,0 +1,586 @@
+//
+//  imagedecode.cpp
+//
+
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#include "imagedecode.h"
+
+#define HUFFMAN_FAST_BITS 10	// codes up to this length are decoded by a single table lookup
+
+namespace {
+
+//
+// LSB-first bit reader, reading zeros past the end (overrun tells whether those were consumed)
+//
+struct bit_reader_t
+{
+	const uint8_t* p;
+	const uint8_t* end;
+	uint64_t bits = 0;
+	int nbits = 0;
+	int overrun = 0;	// zero bytes fed past the end
+
+	bit_reader_t(const uint8_t* p, const uint8_t* end) : p(p), end(end) { }
+
+	void refill()
+	{
+		while (nbits <= 56)
+		{
+			uint64_t b = 0;
+			if (p < end)
+				b = *p++;
+			else
+				overrun++;
+			bits |= b << nbits;
+			nbits += 8;
+		}
+	}
+
+	unsigned peek(int n)
+	{
+		if (nbits < n)
+			refill();
+		return (unsigned)(bits & ((1ull << n) - 1));
+	}
+
+	void consume(int n)
+	{
+		bits >>= n;
+		nbits -= n;
+	}
+
+	unsigned get(int n)
+	{
+		unsigned v = peek(n);
+		consume(n);
+		return v;
+	}
+
+	// true if bits past the end of the stream have been consumed
+	bool overran() const { return overrun * 8 > nbits; }
+};
+
+//
+// canonical Huffman code, with a lookup table for the short codes
+//
+struct huffman_t
+{
+	uint16_t fast[1 << HUFFMAN_FAST_BITS];	// symbol | length << 9, 0 for longer codes
+	uint16_t count[16];						// number of codes per length
+	uint16_t symbol[288];					// symbols ordered by code
+
+	bool build(const uint8_t* lengths, int n)
+	{
+		memset(count, 0, sizeof(count));
+		for (int i = 0; i < n; i++)
+			count[lengths[i]]++;
+		count[0] = 0;
+
+		// over-subscribed codes are invalid, incomplete ones are allowed (e.g. a single distance code)
+		int left = 1;
+		for (int len = 1; len < 16; len++)
+		{
+			left = (left << 1) - count[len];
+			if (left < 0)
+				return false;
+		}
+
+		uint16_t offs[16] = { 0 };
+		for (int len = 1; len < 15; len++)
+			offs[len + 1] = offs[len] + count[len];
+		for (int i = 0; i < n; i++)
+			if (lengths[i])
+				symbol[offs[lengths[i]]++] = (uint16_t)i;
+
+		memset(fast, 0, sizeof(fast));
+		unsigned code = 0;
+		int k = 0;
+		for (int len = 1; len <= HUFFMAN_FAST_BITS; len++, code <<= 1)
+		{
+			for (int j = 0; j < count[len]; j++, k++, code++)
+			{
+				// codes are stored MSB first in the LSB-first stream, so index by the reversed code
+				unsigned rev = 0;
+				for (int b = 0; b < len; b++)
+					rev |= ((code >> b) & 1) << (len - 1 - b);
+				for (unsigned r = rev; r < (1u << HUFFMAN_FAST_BITS); r += 1u << len)
+					fast[r] = (uint16_t)(symbol[k] | (len << 9));
+			}
+		}
+		return true;
+	}
+
+	// next symbol, -1 if the bits are not a code
+	int decode(bit_reader_t& br) const
+	{
+		unsigned e = fast[br.peek(HUFFMAN_FAST_BITS)];
+		if (e)
+		{
+			br.consume(e >> 9);
+			return e & 511;
+		}
+
+		// longer codes, one bit at a time
+		int code = 0, first = 0, index = 0;
+		for (int len = 1; len < 16; len++)
+		{
+			code |= br.get(1);
+			int c = count[len];
+			if (code - c < first)
+				return symbol[index + (code - first)];
+			index += c;
+			first = (first + c) << 1;
+			code <<= 1;
+		}
+		return -1;
+	}
+};
+
+const uint16_t length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const uint8_t length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const uint16_t dist_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const uint8_t dist_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+const uint8_t code_length_order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+}
+
+bool zlib_inflate(const uint8_t* src, size_t size, std::vector<uint8_t>& out, size_t max_size)
+{
+	// deflate, no preset dictionary
+	if (size < 2 || (src[0] & 15) != 8 || ((src[0] << 8) | src[1]) % 31 || (src[1] & 32))
+		return false;
+
+	bit_reader_t br(src + 2, src + size);
+	huffman_t lit, dist;
+	out.resize(max_size);
+	size_t pos = 0;
+
+	for (bool last = false; !last; )
+	{
+		last = br.get(1) != 0;
+		unsigned type = br.get(2);
+
+		if (type == 0)
+		{
+			// stored block, byte aligned
+			br.consume(br.nbits & 7);
+			unsigned len = br.get(16), nlen = br.get(16);
+			if ((len ^ 0xffff) != nlen || len > max_size - pos)
+				return false;
+			for (unsigned i = 0; i < len; i++)
+				out[pos++] = (uint8_t)br.get(8);
+			if (br.overran())
+				return false;
+			continue;
+		}
+
+		uint8_t lengths[288 + 32];
+		if (type == 1)
+		{
+			// fixed codes
+			memset(lengths, 8, 144);
+			memset(lengths + 144, 9, 112);
+			memset(lengths + 256, 7, 24);
+			memset(lengths + 280, 8, 8);
+			memset(lengths + 288, 5, 30);
+			lit.build(lengths, 288);
+			dist.build(lengths + 288, 30);
+		}
+		else if (type == 2)
+		{
+			// dynamic codes, their lengths are Huffman-coded as well
+			int nlit = br.get(5) + 257, ndist = br.get(5) + 1, nclen = br.get(4) + 4;
+			uint8_t clen[19] = { 0 };
+			for (int i = 0; i < nclen; i++)
+				clen[code_length_order[i]] = (uint8_t)br.get(3);
+			huffman_t lenc;
+			if (nlit > 286 || ndist > 30 || !lenc.build(clen, 19))
+				return false;
+
+			for (int n = 0; n < nlit + ndist; )
+			{
+				int sym = lenc.decode(br);
+				if (sym < 0)
+					return false;
+				if (sym < 16)
+				{
+					lengths[n++] = (uint8_t)sym;
+					continue;
+				}
+
+				int rep;
+				uint8_t val = 0;
+				if (sym == 16)
+				{
+					if (!n)
+						return false;
+					val = lengths[n - 1];
+					rep = 3 + br.get(2);
+				}
+				else if (sym == 17)
+					rep = 3 + br.get(3);
+				else
+					rep = 11 + br.get(7);
+				if (n + rep > nlit + ndist)
+					return false;
+				memset(lengths + n, val, rep);
+				n += rep;
+			}
+			if (!lengths[256] || !lit.build(lengths, nlit) || !dist.build(lengths + nlit, ndist))
+				return false;
+		}
+		else
+			return false;
+
+		// literals & matches until the end-of-block code
+		for (;;)
+		{
+			int sym = lit.decode(br);
+			if (sym < 256)
+			{
+				if (sym < 0 || pos == max_size)
+					return false;
+				out[pos++] = (uint8_t)sym;
+				continue;
+			}
+			if (sym == 256)
+				break;
+
+			sym -= 257;
+			if (sym >= 29)
+				return false;
+			size_t len = length_base[sym] + br.get(length_extra[sym]);
+			int dsym = dist.decode(br);
+			if (dsym < 0 || dsym >= 30)
+				return false;
+			size_t d = dist_base[dsym] + br.get(dist_extra[dsym]);
+			if (d > pos || len > max_size - pos || br.overran())
+				return false;
+
+			// byte by byte, the match may overlap its own output
+			uint8_t* o = &out[pos];
+			const uint8_t* s = o - d;
+			for (size_t i = 0; i < len; i++)
+				o[i] = s[i];
+			pos += len;
+		}
+		if (br.overran())
+			return false;
+	}
+
+	out.resize(pos);
+	return true;
+}
+
+static uint32_t read_be32(const uint8_t* b)
+{
+	return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+}
+
+static inline uint8_t paeth(int a, int b, int c)
+{
+	int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	return (uint8_t)((pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c));
+}
+
+bool decode_png(const void* data, size_t size, texture_image_t& image)
+{
+	static const uint8_t signature[8] = { 137, 'P', 'N', 'G', 13, 10, 26, 10 };
+	const uint8_t* p = (const uint8_t*)data;
+	if (size < 8 || memcmp(p, signature, 8))
+		return false;
+
+	unsigned width = 0, height = 0;
+	int depth = 0, color_type = -1, interlace = 0;
+	std::vector<uint8_t> idat;
+	uint8_t palette[256 * 4];
+	int palette_size = 0;
+	bool has_key = false;
+	unsigned key[3] = { 0 };	// tRNS color key of gray & truecolor images, in sample units
+
+	memset(palette, 255, sizeof(palette));
+
+	for (size_t pos = 8; pos + 12 <= size; )
+	{
+		uint32_t len = read_be32(p + pos);
+		const uint8_t* type = p + pos + 4;
+		const uint8_t* body = p + pos + 8;
+		if (len > size - pos - 12)
+			return false;
+
+		if (!memcmp(type, "IHDR", 4) && len >= 13)
+		{
+			width = read_be32(body);
+			height = read_be32(body + 4);
+			depth = body[8];
+			color_type = body[9];
+			interlace = body[12];
+			if (body[10] || body[11])
+				return false;
+		}
+		else if (!memcmp(type, "PLTE", 4))
+		{
+			palette_size = std::min(256, (int)len / 3);
+			for (int i = 0; i < palette_size; i++)
+				memcpy(palette + i * 4, body + i * 3, 3);
+		}
+		else if (!memcmp(type, "tRNS", 4))
+		{
+			if (color_type == 3)
+			{
+				for (uint32_t i = 0; i < len && i < 256; i++)
+					palette[i * 4 + 3] = body[i];
+			}
+			else if ((color_type == 0 && len >= 2) || (color_type == 2 && len >= 6))
+			{
+				has_key = true;
+				for (int c = 0; c < (color_type ? 3 : 1); c++)
+					key[c] = (body[c * 2] << 8) | body[c * 2 + 1];
+			}
+		}
+		else if (!memcmp(type, "IDAT", 4))
+			idat.insert(idat.end(), body, body + len);
+		else if (!memcmp(type, "IEND", 4))
+			break;
+
+		pos += 12 + (size_t)len;
+	}
+
+	// supported combinations of color type & bit depth, interlaced images are left to other decoders
+	static const int channels_of[7] = { 1, 0, 3, 1, 2, 0, 4 };
+	if (color_type < 0 || color_type > 6 || !channels_of[color_type] || interlace ||
+		!width || !height || width > (1u << 15) || height > (1u << 15) ||
+		(depth != 8 && depth != 16 && (color_type == 2 || color_type == 4 || color_type == 6)) ||
+		(depth != 1 && depth != 2 && depth != 4 && depth != 8 && depth != 16) ||
+		(color_type == 3 && (depth == 16 || !palette_size)))
+		return false;
+
+	int channels = channels_of[color_type];
+	size_t stride = ((size_t)width * channels * depth + 7) / 8;
+	size_t bpp = std::max<size_t>(1, channels * depth / 8);	// filter distance in bytes
+
+	std::vector<uint8_t> raw;
+	if (!zlib_inflate(idat.data(), idat.size(), raw, height * (stride + 1)) || raw.size() != height * (stride + 1))
+		return false;
+
+	// undo the per-row filters in place
+	std::vector<uint8_t> zero_row(stride, 0);
+	for (unsigned y = 0; y < height; y++)
+	{
+		uint8_t* cur = &raw[y * (stride + 1) + 1];
+		const uint8_t* prev = y ? cur - (stride + 1) : zero_row.data();
+		size_t i;
+
+		switch (cur[-1])
+		{
+		case 0:
+			break;
+		case 1:
+			for (i = bpp; i < stride; i++)
+				cur[i] += cur[i - bpp];
+			break;
+		case 2:
+			for (i = 0; i < stride; i++)
+				cur[i] += prev[i];
+			break;
+		case 3:
+			for (i = 0; i < bpp; i++)
+				cur[i] += prev[i] >> 1;
+			for (; i < stride; i++)
+				cur[i] += (cur[i - bpp] + prev[i]) >> 1;
+			break;
+		case 4:
+			for (i = 0; i < bpp; i++)
+				cur[i] += prev[i];
+			for (; i < stride; i++)
+				cur[i] += paeth(cur[i - bpp], prev[i], prev[i - bpp]);
+			break;
+		default:
+			return false;
+		}
+	}
+
+	image.width = width;
+	image.height = height;
+	image.pixels.resize((size_t)width * height * 4);
+
+	for (unsigned y = 0; y < height; y++)
+	{
+		const uint8_t* row = &raw[y * (stride + 1) + 1];
+		uint8_t* d = &image.pixels[(size_t)y * width * 4];
+
+		// common cases
+		if (depth == 8 && color_type == 6)
+		{
+			memcpy(d, row, (size_t)width * 4);
+			continue;
+		}
+		if (depth == 8 && color_type == 2 && !has_key)
+		{
+			for (unsigned x = 0; x < width; x++, d += 4, row += 3)
+			{
+				d[0] = row[0];
+				d[1] = row[1];
+				d[2] = row[2];
+				d[3] = 255;
+			}
+			continue;
+		}
+
+		// the i-th sample of the row, and scaled to 8 bits
+		auto sample = [&](size_t i) -> unsigned
+		{
+			if (depth == 8)
+				return row[i];
+			if (depth == 16)
+				return (row[i * 2] << 8) | row[i * 2 + 1];
+			size_t bit = i * depth;
+			return (row[bit >> 3] >> (8 - depth - (bit & 7))) & ((1 << depth) - 1);
+		};
+		auto to8 = [&](unsigned v) -> uint8_t
+		{
+			return (uint8_t)(depth == 16 ? v >> 8 : (depth == 8 ? v : v * 255 / ((1 << depth) - 1)));
+		};
+
+		for (unsigned x = 0; x < width; x++, d += 4)
+		{
+			switch (color_type)
+			{
+			case 0:
+			{
+				unsigned g = sample(x);
+				d[0] = d[1] = d[2] = to8(g);
+				d[3] = (has_key && g == key[0]) ? 0 : 255;
+				break;
+			}
+			case 2:
+			{
+				unsigned r = sample(x * 3), g = sample(x * 3 + 1), b = sample(x * 3 + 2);
+				d[0] = to8(r);
+				d[1] = to8(g);
+				d[2] = to8(b);
+				d[3] = (has_key && r == key[0] && g == key[1] && b == key[2]) ? 0 : 255;
+				break;
+			}
+			case 3:
+				memcpy(d, palette + (std::min(sample(x), (unsigned)palette_size - 1) * 4), 4);
+				break;
+			case 4:
+				d[0] = d[1] = d[2] = to8(sample(x * 2));
+				d[3] = to8(sample(x * 2 + 1));
+				break;
+			case 6:
+				for (int c = 0; c < 4; c++)
+					d[c] = to8(sample(x * 4 + c));
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+bool decode_tga(const void* data, size_t size, texture_image_t& image)
+{
+	const uint8_t* p = (const uint8_t*)data;
+	if (size < 18)
+		return false;
+
+	unsigned id_len = p[0], cmap_type = p[1], type = p[2];
+	unsigned cmap_len = p[5] | (p[6] << 8), cmap_bits = p[7];
+	unsigned width = p[12] | (p[13] << 8), height = p[14] | (p[15] << 8);
+	unsigned bits = p[16], desc = p[17];
+
+	// truecolor (2) & grayscale (3), raw or RLE (+8)
+	unsigned base = type & 7;
+	bool rle = type & 8;
+	if (cmap_type > 1 || (base != 2 && base != 3) || (type & ~15u) || (type & 4) ||
+		!width || !height ||
+		(base == 2 && bits != 24 && bits != 32) || (base == 3 && bits != 8))
+		return false;
+
+	size_t ofs = 18 + id_len + (cmap_type ? cmap_len * ((cmap_bits + 7) / 8) : 0);
+	if (ofs > size)
+		return false;
+
+	const uint8_t* s = p + ofs;
+	const uint8_t* end = p + size;
+	size_t bpp = bits / 8, n = (size_t)width * height;
+	bool alpha = bpp == 4 && (desc & 15);	// attribute bits, alpha is undefined without them
+
+	image.width = width;
+	image.height = height;
+	image.pixels.resize(n * 4);
+	uint8_t* d = image.pixels.data();
+
+	// BGR(A) or gray to RGBA
+	auto put = [&](const uint8_t* px, uint8_t* dst)
+	{
+		if (bpp == 1)
+			dst[0] = dst[1] = dst[2] = px[0];
+		else
+		{
+			dst[0] = px[2];
+			dst[1] = px[1];
+			dst[2] = px[0];
+		}
+		dst[3] = alpha ? px[3] : 255;
+	};
+
+	if (!rle)
+	{
+		if ((size_t)(end - s) < n * bpp)
+			return false;
+		for (size_t i = 0; i < n; i++)
+			put(s + i * bpp, d + i * 4);
+	}
+	else
+	{
+		for (size_t i = 0; i < n; )
+		{
+			if (s >= end)
+				return false;
+			unsigned header = *s++, count = (header & 127) + 1;
+			if (count > n - i)
+				return false;
+			if (header & 128)
+			{
+				if ((size_t)(end - s) < bpp)
+					return false;
+				for (unsigned k = 0; k < count; k++)
+					put(s, d + (i + k) * 4);
+				s += bpp;
+			}
+			else
+			{
+				if ((size_t)(end - s) < count * bpp)
+					return false;
+				for (unsigned k = 0; k < count; k++)
+					put(s + k * bpp, d + (i + k) * 4);
+				s += count * bpp;
+			}
+			i += count;
+		}
+	}
+
+	// rows are stored bottom-up unless the origin is at the top
+	size_t row = (size_t)width * 4;
+	if (!(desc & 0x20))
+		for (unsigned y = 0; y < height / 2; y++)
+			std::swap_ranges(d + y * row, d + (y + 1) * row, d + (height - 1 - y) * row);
+	if (desc & 0x10)
+		for (unsigned y = 0; y < height; y++)
+			for (unsigned x = 0; x < width / 2; x++)
+				std::swap_ranges(d + y * row + x * 4, d + y * row + x * 4 + 4, d + y * row + (width - 1 - x) * 4);
+	return true;
+}
+
+bool decode_image(const void* data, size_t size, texture_image_t& image)
+{
+	const uint8_t* p = (const uint8_t*)data;
+	if (size >= 8 && p[0] == 137 && p[1] == 'P' && p[2] == 'N' && p[3] == 'G')
+		return decode_png(data, size, image);
+	return decode_tga(data, size, image);
+}
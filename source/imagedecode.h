@@ -0,0 +1,32 @@
+//
+//  imagedecode.h
+//
+//  Portable image decoders for the texture pipeline: PNG (all color types, 1 - 16 bits, not
+//  interlaced) and TGA (truecolor & grayscale, raw & RLE), decoded to RGBA8. Formats not handled
+//  here (jpg, interlaced png, ...) are left to a platform decoder. Headless and platform-independent.
+//
+
+#pragma once
+#ifndef IMAGEDECODE_H
+#define IMAGEDECODE_H
+
+#include <vector>
+#include <cstdint>
+
+#include "texturecache.h"
+
+bool decode_png(const void* data, size_t size, texture_image_t& image);
+bool decode_tga(const void* data, size_t size, texture_image_t& image);
+
+//
+// Decode by content: PNG by its signature, otherwise TGA if the header is consistent with the size
+//
+bool decode_image(const void* data, size_t size, texture_image_t& image);
+
+//
+// zlib stream (RFC 1950/1951) into out, which is grown up to max_size. False if the stream is
+// corrupt or inflates to more than max_size.
+//
+bool zlib_inflate(const uint8_t* src, size_t size, std::vector<uint8_t>& out, size_t max_size);
+
+#endif
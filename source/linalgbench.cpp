@@ -0,0 +1,563 @@
+//
+//  linalgbench.cpp
+//
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include "linalgbench.h"
+#include "vec/vec.h"
+#include "vec/mat.h"
+#include "vec/transform.h"
+#include "vec/quat.h"
+
+using namespace linalg;
+
+static std::mt19937 rng(1);
+
+static float random_float()
+{
+	// mostly unit range, some large and small magnitudes
+	std::uniform_real_distribution<float> u(-1.0f, 1.0f);
+	std::uniform_int_distribution<int> e(-8, 8);
+	return std::ldexp(u(rng), rng() % 4 ? 0 : e(rng));
+}
+
+static mat4f random_mat4f()
+{
+	mat4f m;
+	for (int i = 0; i < 16; i++)
+		m.array[i] = random_float();
+	return m;
+}
+
+static vec4f random_vec4f()
+{
+	return vec4f(random_float(), random_float(), random_float(), random_float());
+}
+
+static vec3f random_vec3f()
+{
+	return vec3f(random_float(), random_float(), random_float());
+}
+
+static mat4f abs(const mat4f& m)
+{
+	mat4f a;
+	for (int i = 0; i < 16; i++)
+		a.array[i] = std::fabs(m.array[i]);
+	return a;
+}
+
+static vec3f abs(const vec3f& v)
+{
+	return vec3f(std::fabs(v.x), std::fabs(v.y), std::fabs(v.z));
+}
+
+static vec4f abs(const vec4f& v)
+{
+	return vec4f(std::fabs(v.x), std::fabs(v.y), std::fabs(v.z), std::fabs(v.w));
+}
+
+//
+// Differences between results and their references: the number of results that are not identical,
+// and the largest error of an element relative to its bound, the sum of the magnitudes of the terms
+// it is computed from (so cancellation does not inflate it)
+//
+struct difference_t
+{
+	size_t nbr_results = 0, nbr_different = 0;
+	double max_error = 0;
+
+	void add(const float* a, const float* ref, const float* bound, int n)
+	{
+		nbr_results++;
+		if (memcmp(a, ref, n * sizeof(float)))
+			nbr_different++;
+
+		for (int i = 0; i < n; i++)
+			if (bound[i] > 0)
+				max_error = std::max(max_error, std::fabs((double)a[i] - ref[i]) / bound[i]);
+	}
+
+	// identical unless the compiler contracts the generic code to fused multiply-adds
+	bool report(const char* name, double tolerance) const
+	{
+		bool ok = max_error <= tolerance;
+		printf("%-28s %zu/%zu identical, max relative error %.3g - %s\n", name,
+			nbr_results - nbr_different, nbr_results, max_error, ok ? "OK" : "FAILED");
+		return ok;
+	}
+};
+
+//
+// Time generic(i) and simd(i) for i < n, in ns per call. Runs alternate and the best of each is
+// kept, which keeps the comparison fair on a busy or frequency-scaling machine.
+//
+template<class F, class G>
+static void time_ns(size_t n, const F& generic, const G& simd, double& generic_ns, double& simd_ns)
+{
+	generic_ns = simd_ns = 1e30;
+	for (int run = 0; run < 10; run++)
+	{
+		auto t0 = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < n; i++)
+			generic(i);
+		auto t1 = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < n; i++)
+			simd(i);
+		auto t2 = std::chrono::high_resolution_clock::now();
+		generic_ns = std::min(generic_ns, std::chrono::duration<double, std::nano>(t1 - t0).count() / n);
+		simd_ns = std::min(simd_ns, std::chrono::duration<double, std::nano>(t2 - t1).count() / n);
+	}
+}
+
+static void report_speed(const char* name, double generic_ns, double simd_ns, const char* simd_name = "simd", const char* generic_name = "generic")
+{
+	printf("%-28s %s %6.2f ns, %s %6.2f ns (%.2fx)\n", name, generic_name, generic_ns, simd_name, simd_ns, generic_ns / simd_ns);
+}
+
+//
+// time a batch of n elements, in ns per element, best of enough runs for about 20M elements
+//
+template<class F>
+static double time_batch_ns(size_t n, const F& fn)
+{
+	double best = 1e30;
+	for (size_t run = 0; run < std::max<size_t>(3, 20000000 / n); run++)
+	{
+		auto t0 = std::chrono::high_resolution_clock::now();
+		fn();
+		auto t1 = std::chrono::high_resolution_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::nano>(t1 - t0).count() / n);
+	}
+	return best;
+}
+
+//
+// Batched transforms (vec/transform.h) against a loop of generic mat4f * vec4f
+//
+static bool check_transforms(double tolerance, unsigned nbr_threads)
+{
+	bool ok = true;
+	const size_t nbr_checks = 100003;	// not a multiple of 4, so the scalar tail is checked too
+
+	mat4f m = random_mat4f();
+	std::vector<vec3f> in(nbr_checks), out(nbr_checks), out_n(nbr_checks), in_place(nbr_checks);
+	for (auto& v : in)
+		v = random_vec3f();
+
+	transform_points(m, in.data(), out.data(), nbr_checks, nbr_threads);
+	transform_normals(m, in.data(), out_n.data(), nbr_checks, nbr_threads);
+
+	difference_t points, normals;
+	const float unit[3] = { 1, 1, 1 };
+	for (size_t i = 0; i < nbr_checks; i++)
+	{
+		vec3f ref = mat4_mul_generic(m, in[i].xyz1()).xyz();
+		vec3f bound = mat4_mul_generic(abs(m), abs(in[i]).xyz1()).xyz();
+		points.add(out[i].vec, ref.vec, bound.vec, 3);
+
+		vec3f ref_n = normalize(mat4_mul_generic(m, in[i].xyz0()).xyz());
+		normals.add(out_n[i].vec, ref_n.vec, unit, 3);
+	}
+	ok &= points.report("transform_points", tolerance);
+	ok &= normals.report("transform_normals", tolerance);
+
+	// SoA and in-place results are the same as AoS
+	std::vector<float> x(nbr_checks), y(nbr_checks), z(nbr_checks);
+	for (size_t i = 0; i < nbr_checks; i++)
+	{
+		x[i] = in[i].x;
+		y[i] = in[i].y;
+		z[i] = in[i].z;
+	}
+	in_place = in;
+	transform_points(m, in_place.data(), in_place.data(), nbr_checks, nbr_threads);
+	transform_points_soa(m, x.data(), y.data(), z.data(), x.data(), y.data(), z.data(), nbr_checks, nbr_threads);
+	bool same = !memcmp(in_place.data(), out.data(), nbr_checks * sizeof(vec3f));
+	for (size_t i = 0; i < nbr_checks; i++)
+		same &= x[i] == out[i].x && y[i] == out[i].y && z[i] == out[i].z;
+	printf("%-28s %s\n", "in-place & SoA points", same ? "identical - OK" : "different - FAILED");
+	ok &= same;
+
+	return ok;
+}
+
+static void time_transforms(unsigned nbr_threads)
+{
+	mat4f m = random_mat4f();
+	const size_t sizes[] = { 1000, 100000, 10000000 };
+	for (size_t n : sizes)
+	{
+		std::vector<vec3f> in(n), out(n);
+		std::vector<float> x(n), y(n), z(n), ox(n), oy(n), oz(n);
+		for (size_t i = 0; i < n; i++)
+		{
+			in[i] = random_vec3f();
+			x[i] = in[i].x;
+			y[i] = in[i].y;
+			z[i] = in[i].z;
+		}
+
+		double generic_ns = time_batch_ns(n, [&]()
+		{
+			for (size_t i = 0; i < n; i++)
+				out[i] = mat4_mul_generic(m, vec4f(in[i].x, in[i].y, in[i].z, 1.0f)).xyz();
+		});
+		double aos_ns = time_batch_ns(n, [&]() { transform_points(m, in.data(), out.data(), n, 1); });
+		double aos_mt_ns = time_batch_ns(n, [&]() { transform_points(m, in.data(), out.data(), n, nbr_threads); });
+		double soa_ns = time_batch_ns(n, [&]() { transform_points_soa(m, x.data(), y.data(), z.data(), ox.data(), oy.data(), oz.data(), n, 1); });
+		double soa_mt_ns = time_batch_ns(n, [&]() { transform_points_soa(m, x.data(), y.data(), z.data(), ox.data(), oy.data(), oz.data(), n, nbr_threads); });
+		double normals_ns = time_batch_ns(n, [&]() { transform_normals(m, in.data(), out.data(), n, 1); });
+
+		printf("transform %8zu points     generic %5.2f ns, AoS %5.2f ns (%.2fx), %u threads %5.2f ns, SoA %5.2f ns, %u threads %5.2f ns; normals AoS %5.2f ns\n",
+			n, generic_ns, aos_ns, generic_ns / aos_ns, nbr_threads, aos_mt_ns, soa_ns, nbr_threads, soa_mt_ns, normals_ns);
+	}
+}
+
+//
+// rigid (rotation & translation), affine (with scaling & shear) and general transforms
+//
+static mat4f random_rigid()
+{
+	vec3f axis = random_vec3f();
+	if (axis.norm2() < 1e-3f)
+		axis = vec3f(0, 1, 0);
+	axis.normalize();
+	return mat4f::translation(random_vec3f() * 100.0f) * mat4f::rotation(random_float() * fPI, axis);
+}
+
+static mat4f random_affine()
+{
+	mat4f m = random_rigid() * mat4f::scaling(0.1f + std::fabs(random_float()) * 10, 0.1f + std::fabs(random_float()) * 10, 0.1f + std::fabs(random_float()) * 10);
+	m.m12 += random_float() * 0.5f;
+	m.m23 += random_float() * 0.5f;
+	return m;
+}
+
+static mat4f random_general()
+{
+	// a perspective projection of an affine transform, or a random matrix kept away from singular
+	if (rng() % 2)
+		return mat4f::projection(0.5f + std::fabs(random_float()), 1.0f + std::fabs(random_float()), 0.1f, 500.0f) * random_affine();
+	mat4f m = random_mat4f();
+	for (int i = 0; i < 4; i++)
+		m.mat[i][i] += 4.0f;
+	return m;
+}
+
+//
+// error of an inverse against one computed in double precision, relative to its largest element
+// and divided by the condition number of m (|m| |m^-1|, Frobenius norms), which bounds the error
+// any float inverse can reach
+//
+static double inverse_error(const mat4f& inverse, const mat4f& m)
+{
+	mat4<double> md, ref;
+	for (int i = 0; i < 16; i++)
+		md.array[i] = m.array[i];
+	ref = mat4_inverse_generic(md);
+
+	double scale = 0, error = 0, norm2 = 0, inverse_norm2 = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		scale = std::max(scale, std::fabs(ref.array[i]));
+		norm2 += md.array[i] * md.array[i];
+		inverse_norm2 += ref.array[i] * ref.array[i];
+	}
+	for (int i = 0; i < 16; i++)
+		error = std::max(error, std::fabs(inverse.array[i] - ref.array[i]) / scale);
+	return error / std::sqrt(norm2 * inverse_norm2);
+}
+
+//
+// inverse(), affine_inverse() & orthonormal_inverse() against the generic inverse, each on the
+// transforms it applies to
+//
+static bool check_inverses(double tolerance)
+{
+	const size_t nbr_checks = 100000;
+	bool ok = true;
+
+	struct { const char* name; mat4f (*make)(); } kinds[] = { { "rigid", random_rigid }, { "affine", random_affine }, { "general", random_general } };
+	for (int k = 0; k < 3; k++)
+	{
+		double generic = 0, simd = 0, affine = 0, orthonormal = 0;
+		for (size_t i = 0; i < nbr_checks; i++)
+		{
+			mat4f m = kinds[k].make();
+			generic = std::max(generic, inverse_error(mat4_inverse_generic(m), m));
+			simd = std::max(simd, inverse_error(m.inverse(), m));
+			if (k < 2)
+				affine = std::max(affine, inverse_error(m.affine_inverse(), m));
+			if (k < 1)
+				orthonormal = std::max(orthonormal, inverse_error(m.orthonormal_inverse(), m));
+		}
+
+		bool kind_ok = simd <= tolerance && affine <= tolerance && orthonormal <= tolerance;
+		printf("inverse, %-19s max error generic %.3g, simd %.3g", kinds[k].name, generic, simd);
+		if (k < 2)
+			printf(", affine %.3g", affine);
+		if (k < 1)
+			printf(", orthonormal %.3g", orthonormal);
+		printf(" - %s\n", kind_ok ? "OK" : "FAILED");
+		ok &= kind_ok;
+	}
+	return ok;
+}
+
+static void time_inverses(size_t nbr_calls)
+{
+	const size_t nbr_inputs = 1024, mask = nbr_inputs - 1;
+	std::vector<mat4f> rigid(nbr_inputs), general(nbr_inputs), out(nbr_inputs);
+	for (size_t i = 0; i < nbr_inputs; i++)
+	{
+		rigid[i] = random_rigid();
+		general[i] = random_general();
+	}
+
+	double generic_ns, fast_ns;
+	time_ns(nbr_calls,
+		[&](size_t i) { out[i & mask] = mat4_inverse_generic(general[i & mask]); },
+		[&](size_t i) { out[i & mask] = general[i & mask].inverse(); }, generic_ns, fast_ns);
+	report_speed("inverse", generic_ns, fast_ns);
+	time_ns(nbr_calls,
+		[&](size_t i) { out[i & mask] = mat4_inverse_generic(rigid[i & mask]); },
+		[&](size_t i) { out[i & mask] = rigid[i & mask].affine_inverse(); }, generic_ns, fast_ns);
+	report_speed("affine_inverse", generic_ns, fast_ns, "affine");
+	time_ns(nbr_calls,
+		[&](size_t i) { out[i & mask] = mat4_inverse_generic(rigid[i & mask]); },
+		[&](size_t i) { out[i & mask] = rigid[i & mask].orthonormal_inverse(); }, generic_ns, fast_ns);
+	report_speed("orthonormal_inverse", generic_ns, fast_ns, "orthonormal");
+}
+
+//
+// Quaternions (vec/quat.h) against the matrices they stand for, slerp against a double-precision
+// rotation by t times the angle between the ends, and the batched operations against the scalar
+// ones. Rotation matrices & unit quaternions have elements in [-1, 1], so errors are absolute.
+//
+static vec3f random_axis()
+{
+	vec3f axis = random_vec3f();
+	if (axis.norm2() < 1e-3f)
+		axis = vec3f(0, 1, 0);
+	return axis.normalize();
+}
+
+static bool check_quaternions(double tolerance)
+{
+	const size_t nbr_checks = 100003;
+	const float ones[16] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+	bool ok = true;
+
+	difference_t to_matrix, from_matrix, compose, rotate, dual, dual_compose, slerp_error;
+	std::vector<quatf> a(nbr_checks), b(nbr_checks);
+	for (size_t i = 0; i < nbr_checks; i++)
+	{
+		float theta_a = random_float() * fPI, theta_b = random_float() * fPI;
+		vec3f axis_a = random_axis(), axis_b = random_axis(), v = random_vec3f(), t = random_vec3f() * 100.0f;
+		a[i] = quatf::rotation(theta_a, axis_a);
+		b[i] = quatf::rotation(theta_b, axis_b);
+		mat4f ma = mat4f::rotation(theta_a, axis_a), mb = mat4f::rotation(theta_b, axis_b);
+
+		to_matrix.add(a[i].to_mat4().array, ma.array, ones, 16);
+		compose.add((a[i] * b[i]).to_mat4().array, (ma * mb).array, ones, 16);
+
+		quatf q = quatf::from_matrix(ma);
+		if (dot(q, a[i]) < 0)
+			q = -q;
+		from_matrix.add(q.q, a[i].q, ones, 4);
+
+		// rotations preserve lengths, errors are relative to them
+		float length = v.norm2();
+		vec3f av = a[i].rotate(v), av_ref = (ma * vec4f(v, 0)).xyz(), av_bound(length, length, length);
+		rotate.add(av.vec, av_ref.vec, av_bound.vec, 3);
+
+		// rigid transforms, and their composition, which translates by t - t rotated
+		mat4f mt = mat4f::translation(t) * ma, mt2 = mat4f::translation(-t) * mb;
+		dualquatf da(a[i], t), db(b[i], -t);
+		float p_length = length + t.norm2();
+		vec3f p = da.transform_point(v), p_ref = (mt * vec4f(v, 1)).xyz(), p_bound(p_length, p_length, p_length);
+		dual.add(p.vec, p_ref.vec, p_bound.vec, 3);
+		mat4f dab = (da * db).to_mat4(), dab_ref = mt * mt2, dab_bound(1.0f);
+		dab_bound.col[3] = vec4f(2 * t.norm2(), 2 * t.norm2(), 2 * t.norm2(), 1);
+		dual_compose.add(dab.array, dab_ref.array, dab_bound.array, 16);
+
+		// rotation from a by u times the angle to b, or to -b for the shorter arc (as slerp decides,
+		// which matters where they are 180 degrees apart and both arcs are as short)
+		float u = std::uniform_real_distribution<float>(0.0f, 1.0f)(rng);
+		quat<double> ad = normalize(quat<double>(a[i].x, a[i].y, a[i].z, a[i].w)), bd = normalize(quat<double>(b[i].x, b[i].y, b[i].z, b[i].w));
+		if (dot(a[i], b[i]) < 0)
+			bd = -bd;
+		quat<double> rel = ad.conjugate() * bd;
+		double angle = 2 * std::atan2(rel.xyz().norm2(), rel.w);
+		quat<double> ref = rel.xyz().norm2() > 1e-12 ? ad * quat<double>::rotation(u * angle, normalize(rel.xyz())) : ad;
+		quatf s = slerp(a[i], b[i], u), sref((float)ref.x, (float)ref.y, (float)ref.z, (float)ref.w);
+		if (dot(s, sref) < 0)
+			s = -s;
+		slerp_error.add(s.q, sref.q, ones, 4);
+	}
+	ok &= to_matrix.report("quatf to mat4f", tolerance);
+	ok &= from_matrix.report("quatf from mat4f", tolerance);
+	ok &= compose.report("quatf * quatf", tolerance);
+	ok &= rotate.report("quatf rotate vec3f", tolerance);
+	ok &= dual.report("dualquatf point", tolerance);
+	ok &= dual_compose.report("dualquatf * dualquatf", tolerance);
+	ok &= slerp_error.report("slerp", tolerance);
+
+	// batched, against the scalar code
+	std::vector<quatf> out(nbr_checks);
+	std::vector<mat4f> mats(nbr_checks);
+	difference_t mul, blend, matrices;
+	quat_mul(a.data(), b.data(), out.data(), nbr_checks);
+	for (size_t i = 0; i < nbr_checks; i++)
+		mul.add(out[i].q, (a[i] * b[i]).q, ones, 4);
+	quat_nlerp(a.data(), b.data(), 0.3f, out.data(), nbr_checks);
+	for (size_t i = 0; i < nbr_checks; i++)
+		blend.add(out[i].q, nlerp(a[i], b[i], 0.3f).q, ones, 4);
+	quat_to_mat4(a.data(), mats.data(), nbr_checks);
+	for (size_t i = 0; i < nbr_checks; i++)
+		matrices.add(mats[i].array, a[i].to_mat4().array, ones, 16);
+	ok &= mul.report("quat_mul", 0);
+	ok &= blend.report("quat_nlerp", 0);
+	ok &= matrices.report("quat_to_mat4", 0);
+
+	return ok;
+}
+
+static void time_quaternions(size_t nbr_calls)
+{
+	const size_t nbr_inputs = 1024, mask = nbr_inputs - 1;
+	std::vector<quatf> quats(nbr_inputs), quats_out(nbr_inputs);
+	std::vector<mat4f> mats(nbr_inputs), mats_out(nbr_inputs);
+	std::vector<vec3f> vecs(nbr_inputs), vecs_out(nbr_inputs);
+	std::vector<float> angles(nbr_inputs);
+	std::vector<vec3f> axes(nbr_inputs);
+	for (size_t i = 0; i < nbr_inputs; i++)
+	{
+		angles[i] = random_float() * fPI;
+		axes[i] = random_axis();
+		quats[i] = quatf::rotation(angles[i], axes[i]);
+		mats[i] = mat4f::rotation(angles[i], axes[i]);
+		vecs[i] = random_vec3f();
+	}
+
+	double mat_ns, quat_ns;
+	time_ns(nbr_calls,
+		[&](size_t i) { mats_out[i & mask] = mat4f::rotation(angles[i & mask], axes[i & mask]); },
+		[&](size_t i) { quats_out[i & mask] = quatf::rotation(angles[i & mask], axes[i & mask]); }, mat_ns, quat_ns);
+	report_speed("rotation from axis-angle", mat_ns, quat_ns, "quatf", "mat4f");
+	time_ns(nbr_calls,
+		[&](size_t i) { mats_out[i & mask] = mats[i & mask] * mats[(i >> 3) & mask]; },
+		[&](size_t i) { quats_out[i & mask] = quats[i & mask] * quats[(i >> 3) & mask]; }, mat_ns, quat_ns);
+	report_speed("rotation compose", mat_ns, quat_ns, "quatf", "mat4f");
+	time_ns(nbr_calls,
+		[&](size_t i) { vecs_out[i & mask] = (mats[i & mask] * vec4f(vecs[(i >> 3) & mask], 0)).xyz(); },
+		[&](size_t i) { vecs_out[i & mask] = quats[i & mask].rotate(vecs[(i >> 3) & mask]); }, mat_ns, quat_ns);
+	report_speed("rotate vec3f", mat_ns, quat_ns, "quatf", "mat4f");
+
+	double nlerp_ns, slerp_ns;
+	time_ns(nbr_calls,
+		[&](size_t i) { quats_out[i & mask] = nlerp(quats[i & mask], quats[(i >> 3) & mask], 0.3f); },
+		[&](size_t i) { quats_out[i & mask] = slerp(quats[i & mask], quats[(i >> 3) & mask], 0.3f); }, nlerp_ns, slerp_ns);
+	report_speed("interpolate", nlerp_ns, slerp_ns, "slerp", "nlerp");
+
+	// batches, per element
+	const size_t n = nbr_inputs;
+	std::vector<quatf> others(quats.rbegin(), quats.rend());
+	double scalar_ns = time_batch_ns(n, [&]()
+	{
+		for (size_t i = 0; i < n; i++)
+			quats_out[i] = nlerp(quats[i], others[i], 0.3f);
+	});
+	report_speed("quat_nlerp", scalar_ns, time_batch_ns(n, [&]() { quat_nlerp(quats.data(), others.data(), 0.3f, quats_out.data(), n); }), "batched", "scalar");
+	scalar_ns = time_batch_ns(n, [&]()
+	{
+		for (size_t i = 0; i < n; i++)
+			quats_out[i] = quats[i] * others[i];
+	});
+	report_speed("quat_mul", scalar_ns, time_batch_ns(n, [&]() { quat_mul(quats.data(), others.data(), quats_out.data(), n); }), "batched", "scalar");
+	scalar_ns = time_batch_ns(n, [&]()
+	{
+		for (size_t i = 0; i < n; i++)
+			mats_out[i] = quats[i].to_mat4();
+	});
+	report_speed("quat_to_mat4", scalar_ns, time_batch_ns(n, [&]() { quat_to_mat4(quats.data(), mats_out.data(), n); }), "batched", "scalar");
+}
+
+bool linalg_bench(unsigned nbr_threads)
+{
+#if defined(LINALG_AVX)
+	printf("linalg: AVX\n");
+#elif defined(LINALG_SSE)
+	printf("linalg: SSE\n");
+#else
+	printf("linalg: generic only (no SIMD for this target)\n");
+#endif
+	const double tolerance = 4 * FLT_EPSILON;	// a few roundings of the sum of 4 products
+	const size_t nbr_checks = 100000, nbr_calls = 1000000, nbr_inputs = 1024;	// inputs fit in L1/L2
+
+	bool ok = true;
+
+	// mat4f * mat4f, mat4f * vec4f
+	//
+	{
+		difference_t mm, mv;
+		for (size_t i = 0; i < nbr_checks; i++)
+		{
+			mat4f a = random_mat4f(), b = random_mat4f();
+			vec4f v = random_vec4f();
+			mat4f ab = a * b, ab_ref = mat4_mul_generic(a, b);
+			vec4f av = a * v, av_ref = mat4_mul_generic(a, v);
+			mm.add(ab.array, ab_ref.array, mat4_mul_generic(abs(a), abs(b)).array, 16);
+			mv.add(av.vec, av_ref.vec, mat4_mul_generic(abs(a), abs(v)).vec, 4);
+		}
+		ok &= mm.report("mat4f * mat4f", tolerance);
+		ok &= mv.report("mat4f * vec4f", tolerance);
+	}
+
+	std::vector<mat4f> mats(nbr_inputs);
+	std::vector<vec4f> vecs(nbr_inputs);
+	for (size_t i = 0; i < nbr_inputs; i++)
+	{
+		mats[i] = random_mat4f();
+		vecs[i] = random_vec4f();
+	}
+	size_t mask = nbr_inputs - 1;
+
+	// results are stored so the products are not optimized away
+	{
+		std::vector<mat4f> out(nbr_inputs);
+		double generic_ns, simd_ns;
+		time_ns(nbr_calls,
+			[&](size_t i) { out[i & mask] = mat4_mul_generic(mats[i & mask], mats[(i >> 3) & mask]); },
+			[&](size_t i) { out[i & mask] = mats[i & mask] * mats[(i >> 3) & mask]; }, generic_ns, simd_ns);
+		report_speed("mat4f * mat4f", generic_ns, simd_ns);
+	}
+	{
+		std::vector<vec4f> out(nbr_inputs);
+		double generic_ns, simd_ns;
+		time_ns(nbr_calls,
+			[&](size_t i) { out[i & mask] = mat4_mul_generic(mats[i & mask], vecs[(i >> 3) & mask]); },
+			[&](size_t i) { out[i & mask] = mats[i & mask] * vecs[(i >> 3) & mask]; }, generic_ns, simd_ns);
+		report_speed("mat4f * vec4f", generic_ns, simd_ns);
+	}
+
+	ok &= check_inverses(8 * FLT_EPSILON);
+	time_inverses(nbr_calls);
+
+	ok &= check_quaternions(8 * FLT_EPSILON);
+	time_quaternions(nbr_calls);
+
+	ok &= check_transforms(tolerance, nbr_threads);
+	time_transforms(nbr_threads);
+
+	return ok;
+}
@@ -0,0 +1,20 @@
+//
+//  linalgbench.h
+//
+//  Checks of the SIMD paths and special-case inverses of the linalg library (vec/mat.h) against
+//  the generic templates they replace, and of quaternions (vec/quat.h) against the matrices they
+//  stand for, and microbenchmarks of both. Run by the cooker (-m). Headless and platform-independent.
+//
+
+#pragma once
+#ifndef LINALGBENCH_H
+#define LINALGBENCH_H
+
+//
+// Compare SIMD and generic results on random input and print the differences and the throughput
+// of each, batched transforms also on nbr_threads threads. False if a result is outside the
+// tolerance.
+//
+bool linalg_bench(unsigned nbr_threads);
+
+#endif
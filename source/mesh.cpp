@@ -5,96 +5,569 @@
 //
 
 #include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
 #include "mesh.h"
+#include "assetpack.h"
 
 using linalg::int3;
 
 
+//
+// open an obj/mtl file as one contiguous read-only range, from a mounted asset pack or from disk
+// (memory-mapped if MESH_MAPPED_IO is set)
+//
+static void open_mesh_file(mapped_file_t& file, const std::string& filename)
+{
+#ifdef MESH_MAPPED_IO
+    bool opened = vfs_open(filename, file, true);
+#else
+    bool opened = vfs_open(filename, file, false);
+#endif
+    if (!opened)
+        throw std::runtime_error(std::string("failed to open ") + filename);
+    std::cout << "opened " << filename << "\n";
+}
+
 void mesh_t::load_mtl(	std::string path, 
 						std::string filename, 
 						mtl_hash_t &mtl_hash)
 {
     std::string fullpath = path+filename;
     
-    std::ifstream in(fullpath.c_str());
-    if (!in)
-        throw std::runtime_error(std::string("failed to open ") + fullpath);
-    std::cout << "opened " << fullpath << "\n";
+    mapped_file_t file;
+    open_mesh_file(file, fullpath);
     
-    std::string line;
     material_t *current_mtl = NULL;
     
-    while (getline(in, line, '\n'))
+    const char *cursor = file.data, *file_end = file.data + file.size;
+    const char *p, *end;
+    while (next_line(cursor, file_end, p, end))
     {
-        char str0[1024] = {0}, str1[1024];
-        float a,b,c;
+        const char* kw = skip_blanks(p, end);
+        p = skip_nonblanks(kw, end);
+        size_t kwlen = p - kw;
+        
+        // argument: rest of the line
+        const char* arg = skip_blanks(p, end);
+        if (!kwlen || arg == end)
+            continue;
         
-        if (sscanf(line.c_str(), "newmtl %s", str0) == 1)
+        float f[3];
+        
+        if (token_equals(kw, kwlen, "newmtl"))
         {
+            std::string name(arg, skip_nonblanks(arg, end));
+            
             // check for duplicate
-            if (mtl_hash.find(str0) != mtl_hash.end() ) printf("warning: duplicate material '%s'\n", str0);
+            if (mtl_hash.find(name) != mtl_hash.end() ) printf("warning: duplicate material '%s'\n", name.c_str());
             
-            mtl_hash[str0] = material_t();
-            current_mtl = &mtl_hash[str0];
-            current_mtl->name = str0;
+            mtl_hash[name] = material_t();
+            current_mtl = &mtl_hash[name];
+            current_mtl->name = name;
         }
         else if (!current_mtl)
         {
             // no parsed material so can't add any content
             continue;
         }
-        else if (sscanf(line.c_str(), "map_Kd %[^\n]", str0) == 1)
+        else if (token_equals(kw, kwlen, "map_Kd"))
         {
             // search for the image file and ignore the rest
             std::string mapfile;
-			if (find_filename_from_suffixes(str0, ALLOWED_TEXTURE_SUFFIXES, mapfile))
+			if (find_filename_from_suffixes(std::string(arg, end), ALLOWED_TEXTURE_SUFFIXES, mapfile))
                 current_mtl->map_Kd = path + mapfile;
             else
                 throw std::runtime_error(std::string("error: no allowed format found for 'map_Kd' in material ") + current_mtl->name);
         }
-        else if (sscanf(line.c_str(), "map_bump %[^\n]", str0) == 1)
+        else if (token_equals(kw, kwlen, "map_bump") || token_equals(kw, kwlen, "bump"))
         {
             // search for the image file and ignore the rest
             std::string mapfile;
-			if (find_filename_from_suffixes(str0, ALLOWED_TEXTURE_SUFFIXES, mapfile))
+			if (find_filename_from_suffixes(std::string(arg, end), ALLOWED_TEXTURE_SUFFIXES, mapfile))
                 current_mtl->map_bump = path+mapfile;
             else
-                throw std::runtime_error(std::string("error: no allowed format found for 'map_bump' in material ") + current_mtl->name);
+                throw std::runtime_error(std::string("error: no allowed format found for '") + std::string(kw, kwlen) + "' in material " + current_mtl->name);
         }
-        else if (sscanf(line.c_str(), "bump %[^\n]", str0) == 1)
+        else if (token_equals(kw, kwlen, "Ka"))
         {
-            // search for the image file and ignore the rest
-            std::string mapfile;
-			if (find_filename_from_suffixes(str0, ALLOWED_TEXTURE_SUFFIXES, mapfile))
-                current_mtl->map_bump = path+mapfile;
-            else
-                throw std::runtime_error(std::string("error: no allowed format found for 'bump' in material ") + current_mtl->name);
+            if (parse_floats(p, end, f, 3) == 3)
+                current_mtl->Ka = vec3f(f[0], f[1], f[2]);
         }
-        else if (sscanf(line.c_str(), "Ka %f %f %f", &a, &b, &c) == 3)
+        else if (token_equals(kw, kwlen, "Kd"))
         {
-            current_mtl->Ka = vec3f(a, b, c);
+            if (parse_floats(p, end, f, 3) == 3)
+                current_mtl->Kd = vec3f(f[0], f[1], f[2]);
         }
-        else if (sscanf(line.c_str(), "Kd %f %f %f", &a, &b, &c) == 3)
+        else if (token_equals(kw, kwlen, "Ks"))
         {
-            current_mtl->Kd = vec3f(a, b, c);
+            if (parse_floats(p, end, f, 3) == 3)
+                current_mtl->Ks = vec3f(f[0], f[1], f[2]);
         }
-        else if (sscanf(line.c_str(), "Ks %f %f %f", &a, &b, &c) == 3)
+    }
+}
+
+//
+// resolve a 1-based (or negative, relative) obj index to a 0-based index, -1 if absent
+//
+static inline int resolve_obj_index(int i, int count)
+{
+    return i > 0 ? i-1 : (i < 0 ? count+i : -1);
+}
+
+//
+// parse the corners of an 'f' record, v[/vt][/vn] per corner, and append them to a drawcall
+//
+// n-gons are fan-triangulated (quads are kept as quads if triangulate is false)
+// returns true if any corner used a relative index
+//
+static bool parse_face(const char* p, const char* end,
+                       int nbr_vertices, int nbr_normals, int nbr_texcoords,
+                       bool triangulate,
+                       std::vector<int>& corners,
+                       unwelded_drawcall_t& dc)
+{
+    // corners are stored as (vertex, normal, texel) triplets
+    corners.clear();
+    bool relative = false;
+    
+    for (;;)
+    {
+        p = skip_blanks(p, end);
+        
+        int v = 0, vt = 0, vn = 0;
+        if (!parse_int(p, end, v))
+            break;
+        if (p < end && *p == '/')
         {
-            current_mtl->Ks = vec3f(a, b, c);
+            p++;
+            parse_int(p, end, vt);
+            if (p < end && *p == '/')
+            {
+                p++;
+                parse_int(p, end, vn);
+            }
         }
+        relative |= (v < 0 || vt < 0 || vn < 0);
+        
+        corners.push_back(resolve_obj_index(v, nbr_vertices));
+        corners.push_back(resolve_obj_index(vn, nbr_normals));
+        corners.push_back(resolve_obj_index(vt, nbr_texcoords));
+    }
+    
+    int n = (int)corners.size() / 3;
+    if (n < 3)
+        return relative;
+    
+    const int* c = corners.data();
+    
+    if (n == 4 && !triangulate)
+    {
+        dc.quads.push_back({ c[0], c[3], c[6], c[9], c[1], c[4], c[7], c[10], c[2], c[5], c[8], c[11] });
+        return relative;
+    }
+    
+    for (int i = 1; i < n-1; i++)
+    {
+        const int *c0 = c, *c1 = c + 3*i, *c2 = c + 3*(i+1);
+        dc.tris.push_back({ c0[0], c1[0], c2[0], c0[1], c1[1], c2[1], c0[2], c1[2], c2[2] });
+    }
+    return relative;
+}
+
+//
+// chunked obj parsing
+//
+// The file is split into newline-aligned chunks that are parsed independently, each into its own
+// attribute arrays and drawcalls. Records whose effect depends on what came before in the file
+// (mtllib, usemtl, g and the skinning vertex offsets) are kept as an ordered event list that is
+// replayed serially afterwards, so the merged result is identical to parsing the file in one go.
+//
+// Relative face indices can point into earlier chunks. They are resolved against chunk-local
+// counts biased by OBJ_RELATIVE_BIAS and rebased onto the chunk's global offsets in the merge
+// (this limits attribute counts to 2^29).
+//
+static const int OBJ_RELATIVE_BIAS = 1 << 30;
+static const int OBJ_RELATIVE_MIN = 1 << 29;
+static const size_t OBJ_MIN_CHUNK_SIZE = 1 << 20;
+
+struct obj_chunk_event_t
+{
+    enum kind_t { mtllib, usemtl, group, vertex } kind;
+    std::string name;
+    int index;  // usemtl: local drawcall, vertex: local vertex index
+};
+
+struct obj_chunk_t
+{
+    const char *begin = nullptr, *end = nullptr;
+    
+    std::vector<vec3f> vertices, normals;
+    std::vector<vec2f> texcoords;
+    // [0] receives faces that precede the chunk's first usemtl
+    std::vector<unwelded_drawcall_t> drawcalls;
+    std::vector<obj_chunk_event_t> events;
+    bool has_relative_indices = false;
+    
+    // global offsets of the attribute arrays (prefix sums over preceding chunks)
+    size_t v_base = 0, vn_base = 0, vt_base = 0;
+};
+
+static void parse_obj_chunk(obj_chunk_t& chunk, bool triangulate)
+{
+    chunk.drawcalls.resize(1);
+    
+    // skinning offsets only need the first vertex of the chunk and the first one after each usemtl
+    bool await_vertex = true;
+    
+    std::vector<int> face_corners;
+    const char *cursor = chunk.begin, *p, *end;
+    while (next_line(cursor, chunk.end, p, end))
+    {
+        // dispatch once on the leading keyword
+        //
+        const char* kw = skip_blanks(p, end);
+        p = skip_nonblanks(kw, end);
+        size_t kwlen = p - kw;
+        
+        if (!kwlen || kw[0] == '#')
+            continue;
+        
+        float f[3];
+        
+        // 3D/2D vertex
+        //
+        if (token_equals(kw, kwlen, "v"))
+        {
+            int n = parse_floats(p, end, f, 3);
+            if (n < 2)
+                continue;
+            
+            if (await_vertex) {
+                chunk.events.push_back({ obj_chunk_event_t::vertex, std::string(), (int)chunk.vertices.size() });
+                await_vertex = false;
+            }
+            
+            chunk.vertices.push_back(vec3f(f[0], f[1], n == 3 ? f[2] : 0.0f));
+        }
+        // 2D/3D texel (not supported: ignore last component)
+        //
+        else if (token_equals(kw, kwlen, "vt"))
+        {
+            int n = parse_floats(p, end, f, 2);
+            if (n < 1)
+                continue;
+            
+            chunk.texcoords.push_back(vec2f(f[0], n == 2 ? f[1] : 0.0f));
+        }
+        // normal
+        //
+        else if (token_equals(kw, kwlen, "vn"))
+        {
+            if (parse_floats(p, end, f, 3) == 3)
+                chunk.normals.push_back(vec3f(f[0], f[1], f[2]));
+        }
+        // face: n-gon of vertex[/texel][/normal] corners
+        //
+        else if (token_equals(kw, kwlen, "f"))
+        {
+            chunk.has_relative_indices |= parse_face(p, end,
+                                                     OBJ_RELATIVE_BIAS + (int)chunk.vertices.size(),
+                                                     OBJ_RELATIVE_BIAS + (int)chunk.normals.size(),
+                                                     OBJ_RELATIVE_BIAS + (int)chunk.texcoords.size(),
+                                                     triangulate,
+                                                     face_corners,
+                                                     chunk.drawcalls.back());
+        }
+        else
+        {
+            // the remaining records take a single name argument
+            const char* arg = skip_blanks(p, end);
+            std::string str(arg, skip_nonblanks(arg, end));
+            
+            if (str.empty())
+                continue;
+            
+            // material file
+            //
+            if (token_equals(kw, kwlen, "mtllib"))
+            {
+                chunk.events.push_back({ obj_chunk_event_t::mtllib, str, 0 });
+            }
+            // active material
+            //
+            else if (token_equals(kw, kwlen, "usemtl"))
+            {
+                unwelded_drawcall_t udc;
+                udc.mtl_name = str;
+                chunk.drawcalls.push_back(udc);
+                chunk.events.push_back({ obj_chunk_event_t::usemtl, std::string(), (int)chunk.drawcalls.size()-1 });
+                await_vertex = true;
+            }
+            else if (token_equals(kw, kwlen, "g"))
+            {
+                chunk.events.push_back({ obj_chunk_event_t::group, str, 0 });
+            }
+            // unknown obj syntax
+            //
+            else
+            {
+                
+            }
+        }
+    }
+}
+
+//
+// copy chunk attributes to their global offsets and rebase relative face indices
+//
+static void merge_obj_chunk(obj_chunk_t& chunk,
+                            std::vector<vec3f>& vertices,
+                            std::vector<vec3f>& normals,
+                            std::vector<vec2f>& texcoords)
+{
+    std::copy(chunk.vertices.begin(), chunk.vertices.end(), vertices.begin() + chunk.v_base);
+    std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.vn_base);
+    std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + chunk.vt_base);
+    
+    if (!chunk.has_relative_indices)
+        return;
+    
+    const int base[3] = { (int)chunk.v_base, (int)chunk.vn_base, (int)chunk.vt_base };
+    
+    for (auto& dc : chunk.drawcalls)
+    {
+        for (auto& tri : dc.tris)
+            for (int i = 0; i < 9; i++)
+                if (tri.vi[i] >= OBJ_RELATIVE_MIN) tri.vi[i] += base[i/3] - OBJ_RELATIVE_BIAS;
+        
+        for (auto& quad : dc.quads)
+            for (int i = 0; i < 12; i++)
+                if (quad.vi[i] >= OBJ_RELATIVE_MIN) quad.vi[i] += base[i/4] - OBJ_RELATIVE_BIAS;
+    }
+}
+
+//
+// run fn(0..n-1), one worker thread per index (index 0 on the calling thread)
+//
+template<class F>
+static void parallel_for_chunks(size_t n, const F& fn)
+{
+    std::vector<std::thread> workers;
+    for (size_t k = 1; k < n; k++)
+        workers.push_back(std::thread(fn, k));
+    fn(0);
+    for (auto& w : workers)
+        w.join();
+}
+
+static void append_faces(unwelded_drawcall_t& dst, const unwelded_drawcall_t& src)
+{
+    dst.tris.insert(dst.tris.end(), src.tris.begin(), src.tris.end());
+    dst.quads.insert(dst.quads.end(), src.quads.begin(), src.quads.end());
+}
+
+//
+// normalize, also for the very short vectors of small-scale geometry (zero stays zero)
+//
+static inline vec3f normalize_or_zero(const vec3f& u)
+{
+    float l2 = u.norm2squared();
+    return l2 > 0 ? u * (1.0f / sqrtf(l2)) : u;
+}
+
+//
+// angle between two unit vectors, clamped against rounding outside [-1, 1]
+//
+static inline float angle_between_unit(const vec3f& u, const vec3f& w)
+{
+    return acosf(std::min(1.0f, std::max(-1.0f, linalg::dot(u, w))));
+}
+
+//
+// weighted normal of a face, added to those of its vertices in [begin, end)
+//
+static inline void accumulate_face_normal(const std::vector<vec3f>& v, int a, int b, int c, size_t begin, size_t end,
+                                          normal_weighting_t weighting, vec3f* sums)
+{
+    bool in_a = (size_t)a >= begin && (size_t)a < end, in_b = (size_t)b >= begin && (size_t)b < end, in_c = (size_t)c >= begin && (size_t)c < end;
+    if (!in_a && !in_b && !in_c)
+        return;
+    
+    const vec3f v0 = v[a], v1 = v[b], v2 = v[c];
+    
+    // |n| is twice the face area
+    vec3f n = (v1-v0)%(v2-v0);
+    
+    if (weighting == NORMAL_WEIGHT_AREA)
+    {
+        if (in_a) sums[a] += n;
+        if (in_b) sums[b] += n;
+        if (in_c) sums[c] += n;
     }
-    in.close();
+    else
+    {
+        // unit edges, each shared by two corner angles
+        const vec3f e0 = normalize_or_zero(v1-v0), e1 = normalize_or_zero(v2-v1), e2 = normalize_or_zero(v0-v2);
+        n = normalize_or_zero(n);
+        if (in_a) sums[a] += n * angle_between_unit(e0, -e2);
+        if (in_b) sums[b] += n * angle_between_unit(e1, -e0);
+        if (in_c) sums[c] += n * angle_between_unit(e2, -e1);
+    }
+}
+
+void compute_normals(const std::vector<vec3f> &v,
+                     std::vector<vec3f> &vn,
+                     std::vector<unwelded_drawcall_t> &drawcalls,
+                     normal_weighting_t weighting,
+                     unsigned nbr_threads)
+{
+    const size_t min_faces_per_thread = 1 << 16;
+    
+    size_t nbr_faces = 0;
+    for (auto& dc : drawcalls)
+        nbr_faces += dc.tris.size() + dc.quads.size();
+    
+    if (!nbr_threads)
+        nbr_threads = std::max(1u, std::thread::hardware_concurrency());
+    nbr_threads = (unsigned)std::max<size_t>(1, std::min<size_t>(nbr_threads, nbr_faces / min_faces_per_thread));
+    
+    // every thread only writes the sums of its own vertex range
+    vn.assign(v.size(), vec3f(0,0,0));
+    
+    parallel_for_chunks(nbr_threads, [&](size_t t)
+    {
+        size_t begin = v.size() * t / nbr_threads, end = v.size() * (t+1) / nbr_threads;
+        vec3f* sums = vn.data();
+        
+        // all faces, in order: the sums of a vertex are added in the same order on any number of threads.
+        // The normal indices are only written by thread 0, the others read the position indices.
+        for (auto& dc : drawcalls)
+        {
+            for (auto& tri : dc.tris)
+            {
+                int* vi = tri.vi;
+                accumulate_face_normal(v, vi[0], vi[1], vi[2], begin, end, weighting, sums);
+                if (!t)
+                    memcpy(vi+3, vi, 3*sizeof(int));
+            }
+            
+            for (auto& quad : dc.quads)
+            {
+                int* vi = quad.vi;
+                accumulate_face_normal(v, vi[0], vi[1], vi[2], begin, end, weighting, sums);
+                accumulate_face_normal(v, vi[0], vi[2], vi[3], begin, end, weighting, sums);
+                if (!t)
+                    memcpy(vi+4, vi, 4*sizeof(int));
+            }
+        }
+        
+        for (size_t i = begin; i < end; i++)
+            sums[i] = normalize_or_zero(sums[i]);
+    });
+}
+
+//
+// texture-space tangent (along u) and binormal (along v) of a face, from Lengyel's method, added to
+// those of its vertices in [begin, end)
+//
+static inline void accumulate_face_tangents(const std::vector<vertex_t>& vertices, unsigned a, unsigned b, unsigned c,
+                                            size_t begin, size_t end, vec3f* tangents, vec3f* binormals)
+{
+    bool in_a = a >= begin && a < end, in_b = b >= begin && b < end, in_c = c >= begin && c < end;
+    if (!in_a && !in_b && !in_c)
+        return;
+    
+    const vertex_t &v0 = vertices[a], &v1 = vertices[b], &v2 = vertices[c];
+    
+    vec3f D = v1.Pos - v0.Pos, E = v2.Pos - v0.Pos;
+    vec2f F = v1.TexCoord - v0.TexCoord, G = v2.TexCoord - v0.TexCoord;
+    
+    float det = F.x*G.y - G.x*F.y;
+    if (det == 0)
+        return;
+    float r = 1.0f / det;
+    
+    vec3f t = (D*G.y - E*F.y) * r;
+    vec3f bn = (E*F.x - D*G.x) * r;
+    
+    if (in_a) { tangents[a] += t; binormals[a] += bn; }
+    if (in_b) { tangents[b] += t; binormals[b] += bn; }
+    if (in_c) { tangents[c] += t; binormals[c] += bn; }
+}
+
+void compute_tangentspace(std::vector<vertex_t> &vertices,
+                          const std::vector<drawcall_t> &drawcalls,
+                          unsigned nbr_threads)
+{
+    const size_t min_faces_per_thread = 1 << 16;
+    
+    size_t nbr_faces = 0;
+    for (auto& dc : drawcalls)
+        nbr_faces += dc.tris.size() + dc.quads.size();
+    
+    if (!nbr_threads)
+        nbr_threads = std::max(1u, std::thread::hardware_concurrency());
+    nbr_threads = (unsigned)std::max<size_t>(1, std::min<size_t>(nbr_threads, nbr_faces / min_faces_per_thread));
+    
+    // tangent & binormal sums, every thread only writes those of its own vertex range
+    std::vector<vec3f> tangents(vertices.size(), vec3f(0,0,0)), binormals(vertices.size(), vec3f(0,0,0));
+    
+    parallel_for_chunks(nbr_threads, [&](size_t t)
+    {
+        size_t begin = vertices.size() * t / nbr_threads, end = vertices.size() * (t+1) / nbr_threads;
+        vec3f *T = tangents.data(), *B = binormals.data();
+        
+        // all faces, in order: the sums of a vertex are added in the same order on any number of threads
+        for (auto& dc : drawcalls)
+        {
+            for (auto& tri : dc.tris)
+                accumulate_face_tangents(vertices, tri.vi[0], tri.vi[1], tri.vi[2], begin, end, T, B);
+            
+            for (auto& quad : dc.quads)
+            {
+                accumulate_face_tangents(vertices, quad.vi[0], quad.vi[1], quad.vi[2], begin, end, T, B);
+                accumulate_face_tangents(vertices, quad.vi[0], quad.vi[2], quad.vi[3], begin, end, T, B);
+            }
+        }
+        
+        // orthonormalize & store
+        for (size_t i = begin; i < end; i++)
+        {
+            vertex_t& v = vertices[i];
+            const vec3f N = normalize_or_zero(v.Normal);
+            
+            // Gram-Schmidt: remove the normal component of the tangent
+            vec3f tangent = normalize_or_zero(T[i] - N * linalg::dot(N, T[i]));
+            if (tangent.norm2squared() == 0)
+            {
+                // no uv gradient (or tangent along the normal): any direction perpendicular to N
+                vec3f axis = fabsf(N.x) < 0.9f ? vec3f(1,0,0) : vec3f(0,1,0);
+                tangent = normalize_or_zero(axis - N * linalg::dot(N, axis));
+            }
+            
+            // handedness: mirrored uvs have the summed binormal on the other side of N x T
+            vec3f binormal = N % tangent;
+            if (linalg::dot(binormal, B[i]) < 0)
+                binormal = -binormal;
+            
+            v.Tangent = tangent;
+            v.Binormal = binormal;
+        }
+    });
 }
 
 void mesh_t::load_obj(const std::string& filename,
                       bool auto_generate_normals,
-                      bool triangulate)
+                      bool triangulate,
+                      unsigned nbr_threads)
 {
     std::string parentdir = get_parentdir(filename);
     
-    std::ifstream in(filename.c_str());
-    if (!in) throw std::runtime_error(std::string("failed to open ") + filename);
-    std::cout << "opened " << filename << "\n";
+    mapped_file_t file;
+    open_mesh_file(file, filename);
     
     // raw data from obj
     std::vector<vec3f> file_vertices, file_normals;
@@ -102,147 +575,97 @@ void mesh_t::load_obj(const std::string& filename,
     std::vector<unwelded_drawcall_t> file_drawcalls;
     mtl_hash_t file_materials;
     
+    size_t bytes_parsed = file.size;
+    auto parse_start = std::chrono::high_resolution_clock::now();
+    
+    // split the file into newline-aligned chunks, one per thread
+    //
+    if (!nbr_threads)
+        nbr_threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t nbr_chunks = std::max<size_t>(1, std::min<size_t>(nbr_threads, file.size / OBJ_MIN_CHUNK_SIZE));
+    
+    std::vector<obj_chunk_t> chunks(nbr_chunks);
+    const char *file_end = file.data + file.size, *chunk_begin = file.data;
+    for (size_t k = 0; k < nbr_chunks; k++)
+    {
+        const char* chunk_end = file_end;
+        if (k < nbr_chunks-1)
+        {
+            chunk_end = std::max(chunk_begin, file.data + file.size / nbr_chunks * (k+1));
+            const char* eol = (const char*)memchr(chunk_end, '\n', file_end - chunk_end);
+            chunk_end = eol ? eol+1 : file_end;
+        }
+        chunks[k].begin = chunk_begin;
+        chunks[k].end = chunk_end;
+        chunk_begin = chunk_end;
+    }
+    
+    // parse chunks in parallel, straight out of the file bytes
+    parallel_for_chunks(nbr_chunks, [&](size_t k) { parse_obj_chunk(chunks[k], triangulate); });
+    
+    // prefix sums give every chunk its global attribute offsets
+    size_t nbr_v = 0, nbr_vn = 0, nbr_vt = 0;
+    for (auto& chunk : chunks)
+    {
+        chunk.v_base = nbr_v; nbr_v += chunk.vertices.size();
+        chunk.vn_base = nbr_vn; nbr_vn += chunk.normals.size();
+        chunk.vt_base = nbr_vt; nbr_vt += chunk.texcoords.size();
+    }
+    file_vertices.resize(nbr_v);
+    file_normals.resize(nbr_vn);
+    file_texcoords.resize(nbr_vt);
+    
+    parallel_for_chunks(nbr_chunks, [&](size_t k) { merge_obj_chunk(chunks[k], file_vertices, file_normals, file_texcoords); });
+    
+    // replay order-dependent records serially to stitch the drawcalls together
+    //
     std::string current_group_name;
     unwelded_drawcall_t default_drawcall;
     unwelded_drawcall_t* current_drawcall = &default_drawcall;
     int last_ofs = 0; bool face_section = false; // info for skin weight mapping
     
-    std::string line;
-    while (getline(in, line))
+    for (auto& chunk : chunks)
     {
-        float x, y, z;
-        int a[3], b[3], c[3], d[3];
-        char str[1024];
+        // faces preceding the chunk's first usemtl continue the active drawcall
+        append_faces(*current_drawcall, chunk.drawcalls[0]);
         
-        // material file
-        //
-        if (sscanf(line.c_str(), "mtllib %s", str) == 1)
-         {
-             load_mtl(parentdir, str, file_materials);
-         }
-         // active material
-         //
-         else if (sscanf(line.c_str(), "usemtl %s", str) == 1)
-         {
-             unwelded_drawcall_t udc;
-             udc.mtl_name = str;
-             udc.group_name = current_group_name;
-             udc.v_ofs = last_ofs; face_section = true; // skinning: set current vertex offset and mark beginning of a face-section
-             file_drawcalls.push_back(udc);
-             current_drawcall = &file_drawcalls.back();
-         }
-         else if (sscanf(line.c_str(), "g %s", str) == 1)
-         {
-             current_group_name = str;
-         }
-        // 3D vertex
-        //
-         else if (sscanf(line.c_str(), "v %f %f %f", &x, &y, &z) == 3)
-         {
-             // update vertex offset and mark end to a face section
-             if (face_section) {
-                 last_ofs = file_vertices.size();
-                 face_section = false;
-             }
-             
-             file_vertices.push_back(vec3f(x, y, z));
-         }
-        // 2D vertex
-        //
-         else if (sscanf(line.c_str(), "v %f %f", &x, &y) == 2)
-         {
-             file_vertices.push_back(vec3f(x, y, 0.0f));
-         }
-        // 3D texel (not supported: ignore last component)
-        //
-         else if (sscanf(line.c_str(), "vt %f %f %f", &x, &y, &z) == 3)
-         {
-             file_texcoords.push_back(vec2f(x, y));
-         }
-        // 2D texel
-        //
-         else if (sscanf(line.c_str(), "vt %f %f", &x, &y) == 2)
-         {
-             file_texcoords.push_back(vec2f(x, y));
-         }
-        // normal
-        //
-         else if (sscanf(line.c_str(), "vn %f %f %f", &x, &y, &z) == 3)
-         {
-             file_normals.push_back(vec3f(x, y, z));
-         }
-        // face: 4x vertex
-        //
-         else if (sscanf(line.c_str(), "f %d %d %d %d", &a[0], &b[0], &c[0], &d[0]) == 4)
-         {
-             if (triangulate) {
-                 current_drawcall->tris.push_back({ a[0]-1, b[0]-1, c[0]-1, -1, -1, -1, -1, -1, -1 });
-                 current_drawcall->tris.push_back({ a[0]-1, c[0]-1, d[0]-1, -1, -1, -1, -1, -1, -1 });
-             } else
-                 current_drawcall->quads.push_back({ a[0]-1, b[0]-1, c[0]-1, d[0]-1, -1, -1, -1, -1, -1, -1, -1, -1 });
-         }
-        // face: 3x vertex
-        //
-         else if (sscanf(line.c_str(), "f %d %d %d", &a[0], &b[0], &c[0]) == 3)
-         {
-             current_drawcall->tris.push_back({ a[0]-1, b[0]-1, c[0]-1, -1, -1, -1, -1, -1, -1 });
-         }
-        // face: 4x vertex/texel (triangulate)
-        //
-         else if (sscanf(line.c_str(), "f %d/%d %d/%d %d/%d %d/%d", &a[0], &a[1], &b[0], &b[1], &c[0], &c[1], &d[0], &d[1]) == 8)
-         {
-             if (triangulate) {
-                 current_drawcall->tris.push_back({ a[0]-1, b[0]-1, c[0]-1, -1, -1, -1, a[1]-1, b[1]-1, c[1]-1 });
-                 current_drawcall->tris.push_back({ a[0]-1, c[0]-1, d[0]-1, -1, -1, -1, a[1]-1, c[1]-1, d[1]-1 });
-             } else
-                 current_drawcall->quads.push_back({ a[0]-1, b[0]-1, c[0]-1, d[0]-1, -1, -1, -1, -1, a[1]-1, b[1]-1, c[1]-1, d[1]-1 });
-         }
-        // face: 3x vertex/texel
-        //
-         else if (sscanf(line.c_str(), "f %d/%d %d/%d %d/%d", &a[0], &a[1], &b[0], &b[1], &c[0], &c[1]) == 6)
-         {
-             current_drawcall->tris.push_back({ a[0]-1, b[0]-1, c[0]-1, -1, -1, -1, a[1]-1, b[1]-1, c[1]-1 });
-         }
-        // face: 4x vertex//normal (triangulate)
-        //
-         else if (sscanf(line.c_str(), "f %d//%d %d//%d %d//%d %d//%d", &a[0], &a[1], &b[0], &b[1], &c[0], &c[1], &d[0], &d[1]) == 8)
-         {
-             if (triangulate) {
-                 current_drawcall->tris.push_back({ a[0]-1, b[0]-1, c[0]-1, a[1]-1, b[1]-1, c[1]-1, -1, -1, -1 });
-                 current_drawcall->tris.push_back({ a[0]-1, c[0]-1, d[0]-1, a[1]-1, c[1]-1, d[1]-1, -1, -1, -1 });
-             } else
-                 current_drawcall->quads.push_back({ a[0]-1, b[0]-1, c[0]-1, d[0]-1, a[2]-1, b[2]-1, c[2]-1, d[2]-1, -1, -1, -1, -1 });
-         }
-        // face: 3x vertex//normal
-        //
-         else if (sscanf(line.c_str(), "f %d//%d %d//%d %d//%d", &a[0], &a[1], &b[0], &b[1], &c[0], &c[1]) == 6)
-         {
-             current_drawcall->tris.push_back({ a[0]-1, b[0]-1, c[0]-1, a[1]-1, b[1]-1, c[1]-1, -1, -1, -1 });
-         }
-        // face: 4x vertex/texel/normal (triangulate)
-        //
-         else if (sscanf(line.c_str(), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d", &a[0], &a[1], &a[2], &b[0], &b[1], &b[2], &c[0], &c[1], &c[2], &d[0], &d[1], &d[2]) == 12)
-         {
-             if (triangulate) {
-                 current_drawcall->tris.push_back({ a[0]-1, b[0]-1, c[0]-1, a[2]-1, b[2]-1, c[2]-1, a[1]-1, b[1]-1, c[1]-1 });
-                 current_drawcall->tris.push_back({ a[0]-1, c[0]-1, d[0]-1, a[2]-1, c[2]-1, d[2]-1, a[1]-1, c[1]-1, d[1]-1 });
-             } else
-                 current_drawcall->quads.push_back({ a[0]-1, b[0]-1, c[0]-1, d[0]-1, a[2]-1, b[2]-1, c[2]-1, d[2]-1, a[1]-1, b[1]-1, c[1]-1, d[1]-1 });
-         }
-        // face: 3x vertex/texel/normal
-        //
-         else if (sscanf(line.c_str(), "f %d/%d/%d %d/%d/%d %d/%d/%d", &a[0], &a[1], &a[2], &b[0], &b[1], &b[2], &c[0], &c[1], &c[2]) == 9)
-         {
-             current_drawcall->tris.push_back({ a[0]-1, b[0]-1, c[0]-1, a[2]-1, b[2]-1, c[2]-1, a[1]-1, b[1]-1, c[1]-1 });
-         }
-        // unknown obj syntax
-        //
-         else
-         {
-             
-         }
+        for (auto& e : chunk.events)
+        {
+            switch (e.kind)
+            {
+                case obj_chunk_event_t::mtllib:
+                    load_mtl(parentdir, e.name, file_materials);
+                    mtllibs.push_back(parentdir + e.name);
+                    break;
+                    
+                case obj_chunk_event_t::group:
+                    current_group_name = e.name;
+                    break;
+                    
+                case obj_chunk_event_t::vertex:
+                    // update vertex offset and mark end to a face section
+                    if (face_section) {
+                        last_ofs = (int)chunk.v_base + e.index;
+                        face_section = false;
+                    }
+                    break;
+                    
+                case obj_chunk_event_t::usemtl:
+                {
+                    unwelded_drawcall_t& udc = chunk.drawcalls[e.index];
+                    udc.group_name = current_group_name;
+                    udc.v_ofs = last_ofs; face_section = true; // skinning: set current vertex offset and mark beginning of a face-section
+                    file_drawcalls.push_back(std::move(udc));
+                    current_drawcall = &file_drawcalls.back();
+                    break;
+                }
+            }
+        }
     }
-    in.close();
+    chunks.clear();
+    file.close();
+    
+    parse_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - parse_start).count();
     
     // use defualt drawcall if no instance of usemtl
     if (!file_drawcalls.size())
@@ -253,12 +676,14 @@ void mesh_t::load_obj(const std::string& filename,
     
     printf("loaded from obj: vertices %d, texels %d, normals %d, drawcalls %d\n",
            (int)file_vertices.size(), (int)file_texcoords.size(), (int)file_normals.size(), (int)file_drawcalls.size());
+    printf("parsed %.2f MB in %.1f ms (%.1f MB/s, %d threads)\n",
+           bytes_parsed / 1048576.0, parse_ms, bytes_parsed / 1048576.0 / (parse_ms / 1000.0 + 1e-9), (int)nbr_chunks);
 
 #if 1
     // auto-generate normals
     if (!has_normals && auto_generate_normals)
     {
-        compute_normals(file_vertices, file_normals, file_drawcalls);
+        compute_normals(file_vertices, file_normals, file_drawcalls, NORMAL_WEIGHT_AREA, nbr_threads);
         has_normals = true;
         printf("auto-generated %d normals\n", (int)file_normals.size());
     }
@@ -268,20 +693,27 @@ void mesh_t::load_obj(const std::string& filename,
     printf("welding vertex array...");
     
     std::unordered_map<std::string, unsigned> mtl_to_index_hash;
+    weld_table_t weld_table;
     
-    // hash function for int3
-    struct int3_hashfunction {
-        std::size_t operator () (const int3& i3) const {
-            return i3.x;
-        }
-    };
+#ifdef MESH_SHARED_WELDING
+    // one table for all drawcalls: a vertex used by several drawcalls (material switches,
+    // repeated usemtl within a group) is stored once, each drawcall still gets its own faces.
+    // At least one vertex per position, and a closed triangle mesh has about 6 corners per vertex.
+    size_t nbr_corners = 0;
+    for (auto &dc : file_drawcalls)
+        nbr_corners += dc.tris.size()*3 + dc.quads.size()*4;
+    weld_table.reset(std::max(file_vertices.size(), nbr_corners/6));
+#endif
     
     for(auto &dc : file_drawcalls)
     {
         drawcall_t wdc;
         wdc.group_name = dc.group_name;
-                
-        std::unordered_map<int3, unsigned, int3_hashfunction> index3_to_index_hash;
+        
+#ifndef MESH_SHARED_WELDING
+        // about 6 corners per vertex, the table grows if there are more vertices
+        weld_table.reset((dc.tris.size()*3 + dc.quads.size()*4)/6);
+#endif
         
         // material
         //
@@ -309,77 +741,64 @@ void mesh_t::load_obj(const std::string& filename,
             // mtl string is empty, use empty index
             wdc.mtl_index = -1;
         
+        // look up an index-combo, create the vertex if it does not exist
+        auto weld = [&](const int3& i3) -> unsigned
+        {
+            bool inserted;
+            unsigned index = weld_table.find_or_insert(i3, (unsigned)vertices.size(), inserted);
+            if (inserted)
+            {
+                vertex_t v;
+                v.Pos = file_vertices[i3.x];
+                if (i3.y > -1) v.Normal = file_normals[i3.y];
+                if (i3.z > -1) v.TexCoord = file_texcoords[i3.z];
+                vertices.push_back(v);
+            }
+            return index;
+        };
+        
         // weld vertices from triangles
         //
+        wdc.tris.reserve(dc.tris.size());
         for(auto &tri : dc.tris)
         {
             triangle_t wtri;
-            
             for (int i=0; i<3; i++)
-            {
-                int3 i3 = { tri.vi[0+i], tri.vi[3+i], tri.vi[6+i] };
-                
-                auto s = index3_to_index_hash.find(i3);
-                if (s == index3_to_index_hash.end())
-                {
-                    // index-combo does not exist, create it
-                    vertex_t v;
-                    v.Pos = file_vertices[i3.x];
-                    if (i3.y > -1) v.Normal = file_normals[i3.y];
-                    if (i3.z > -1) v.TexCoord = file_texcoords[i3.z];
-                    
-                    wtri.vi[i] = (unsigned)vertices.size();
-                    index3_to_index_hash[i3] = (unsigned)(vertices.size());
-                    
-                    vertices.push_back(v);
-                }
-                else
-                {
-                    // use existing index-combo
-                    wtri.vi[i] = s->second;
-                }
-            }
+                wtri.vi[i] = weld(int3(tri.vi[0+i], tri.vi[3+i], tri.vi[6+i]));
             wdc.tris.push_back(wtri);
         }
-
-#if 1
+        
         // weld vertices from quads
         //
+        wdc.quads.reserve(dc.quads.size());
         for(auto &quad : dc.quads)
         {
             quad_t_ wquad;
-            
             for (int i=0; i<4; i++)
-            {
-                int3 i3 = { quad.vi[0+i], quad.vi[3+i], quad.vi[6+i] };
-                
-                auto s = index3_to_index_hash.find(i3);
-                if (s == index3_to_index_hash.end())
-                {
-                    // index-combo does not exist, create it
-                    vertex_t v;
-                    v.Pos = file_vertices[i3.x];
-                    if (i3.y > -1) v.Normal = file_normals[i3.y];
-                    if (i3.z > -1) v.TexCoord = file_texcoords[i3.z];
-                    
-                    wquad.vi[i] = (unsigned)vertices.size();
-                    index3_to_index_hash[i3] = (unsigned)(vertices.size());
-                    
-                    vertices.push_back(v);
-                }
-                else
-                {
-                    // use existing index-combo
-                    wquad.vi[i] = s->second;
-                }
-            }
+                wquad.vi[i] = weld(int3(quad.vi[0+i], quad.vi[4+i], quad.vi[8+i]));
             wdc.quads.push_back(wquad);
         }
-#endif
         
         drawcalls.push_back(wdc);
     }
     
+#ifdef MESH_SHARED_WELDING
+    {
+        // vertices that per-drawcall welding would have produced: the distinct vertices of each drawcall
+        std::vector<int> last_dc(vertices.size(), -1);
+        size_t nbr_unshared = 0;
+        for (size_t d = 0; d < drawcalls.size(); d++)
+        {
+            auto count = [&](unsigned vi) { if (last_dc[vi] != (int)d) { last_dc[vi] = (int)d; nbr_unshared++; } };
+            for (auto& tri : drawcalls[d].tris) for (int i=0; i<3; i++) count(tri.vi[i]);
+            for (auto& quad : drawcalls[d].quads) for (int i=0; i<4; i++) count(quad.vi[i]);
+        }
+        size_t saved = nbr_unshared - vertices.size();
+        printf("shared welding: %d vertices instead of %d (%.1f KB saved)...",
+               (int)vertices.size(), (int)nbr_unshared, saved*sizeof(vertex_t)/1024.0);
+    }
+#endif
+    
 #ifdef MESH_FORCE_CCW
     // force ccw: flip triangle if geometric normal points away from vertex normal (at index=0)
     
@@ -23,6 +23,8 @@ using linalg::vec3ui;
 
 #define MESH_FORCE_CCW
 #define MESH_SORT_DRAWCALLS
+#define MESH_MAPPED_IO      // memory-map obj/mtl files (otherwise one bulk read per file)
+#define MESH_SHARED_WELDING // weld vertices across drawcalls (otherwise every drawcall gets its own vertices)
 // note: all these formats *should* supposedly be supported by DirectXTex ...
 #define ALLOWED_TEXTURE_SUFFIXES { "bmp", "jpg", "png", "tiff", "gif" }
 
@@ -41,44 +43,143 @@ struct unwelded_drawcall_t
 };
 
 //
-// Creates normals to a set of vertices by averaging the geometric normals of the faces they belong to
+// open-addressing (linear probing) table from (position, normal, texcoord) index triplets
+// to welded vertex indices
 //
-// If a model lacks normals, this function can be used to create them. Works best for relatively smooth models.
+// Slots live in one flat array, so welding does no per-vertex allocation, and the key is
+// hashed on all three components: corners that share a position but differ in normal or
+// texcoord (hard edges, uv seams) spread over the table instead of piling up in one bucket.
 //
-static void compute_normals(const std::vector<vec3f> &v, std::vector<vec3f> &vn, std::vector<unwelded_drawcall_t> &drawcalls)
+class weld_table_t
 {
-    std::vector<vec3f> *v_bin = new std::vector<vec3f>[v.size()];
+    struct slot_t
+    {
+        linalg::int3 key;
+        unsigned value;
+    };
     
-    // bin normals from all faces to vertex bins
-    for (unwelded_drawcall_t& dc : drawcalls)
-        for(unwelded_triangle_t& tri : dc.tris)
-        {
-            int a = tri.vi[0], b = tri.vi[1], c = tri.vi[2];
-            vec3f v0 = v[a], v1 = v[b], v2 = v[c];
-            vec3f n = linalg::normalize((v1-v0)%(v2-v0));
-            
-            v_bin[a].push_back(n);
-            v_bin[b].push_back(n);
-            v_bin[c].push_back(n);
-            
-            memcpy(tri.vi+3, tri.vi, 3*sizeof(int));
-        }
-
-    // average binned normals and add to array
-    for (int i=0; i<v.size(); i++)
+    static const unsigned empty = ~0u;
+    
+    std::vector<slot_t> slots;
+    size_t mask = 0, count = 0;
+    
+    //
+    // combine the components, then mix all bits into the low ones the mask keeps (MurmurHash3's fmix64)
+    //
+    static size_t hash(const linalg::int3& k)
+    {
+        unsigned long long h = ((unsigned long long)(unsigned)k.x << 32 | (unsigned)k.y) ^ (unsigned long long)(unsigned)k.z * 0x9E3779B97F4A7C15ull;
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return (size_t)h;
+    }
+    
+    void rehash(size_t capacity)
+    {
+        std::vector<slot_t> old;
+        old.swap(slots);
+        
+        slot_t e;
+        e.value = empty;
+        slots.assign(capacity, e);
+        mask = capacity-1;
+        
+        for (auto& s : old)
+            if (s.value != empty)
+            {
+                size_t i = hash(s.key) & mask;
+                while (slots[i].value != empty) i = (i+1) & mask;
+                slots[i] = s;
+            }
+    }
+    
+public:
+    
+    //
+    // clear the table and size it for about n entries at a load factor of at most 1/2; it grows
+    // (rehashes) when more are inserted, so n is an estimate rather than an upper bound
+    //
+    void reset(size_t n)
+    {
+        size_t capacity = 16;
+        while (capacity < 2*n) capacity *= 2;
+        
+        slot_t e;
+        e.value = empty;
+        slots.assign(capacity, e);
+        mask = capacity-1;
+        count = 0;
+    }
+    
+    //
+    // return the value stored for key, or store and return value if key is new
+    //
+    unsigned find_or_insert(const linalg::int3& key, unsigned value, bool& inserted)
     {
-        vec3f n = vec3f(0,0,0);
-        for (int j=0; j<v_bin[i].size(); j++)
+        if (2*(count+1) > slots.size())
+            rehash(slots.size() ? 2*slots.size() : 16);
+        
+        size_t i = hash(key) & mask;
+        for (;;)
         {
-            n += v_bin[i][j];
+            slot_t& s = slots[i];
+            if (s.value == empty)
+            {
+                s.key = key;
+                s.value = value;
+                count++;
+                inserted = true;
+                return value;
+            }
+            if (s.key.x == key.x && s.key.y == key.y && s.key.z == key.z)
+            {
+                inserted = false;
+                return s.value;
+            }
+            i = (i+1) & mask;
         }
-        n = linalg::normalize(n);
-        
-        vn.push_back(n);
     }
+};
+
+//
+// weighting of face normals when they are summed into vertex normals
+//
+enum normal_weighting_t
+{
+    NORMAL_WEIGHT_AREA,     // by face area, large faces dominate
+    NORMAL_WEIGHT_ANGLE     // by the face angle at the vertex, independent of how faces are tessellated
+};
 
-    delete[] v_bin;
-}
+//
+// Creates normals to a set of vertices by averaging the geometric normals of the faces they belong to
+//
+// If a model lacks normals, this function can be used to create them. Works best for relatively smooth models.
+// Weighted face normals are summed straight into vn (one entry per vertex, normal indices are set to the
+// vertex indices). With nbr_threads != 1 the vertices are split over the threads, each summing the faces
+// of its own vertices in face order, so the result is the same on any number of threads. nbr_threads = 0
+// means one per hardware thread. Area weighting is the cheaper one, about as fast as plain averaging.
+//
+void compute_normals(const std::vector<vec3f> &v,
+                     std::vector<vec3f> &vn,
+                     std::vector<unwelded_drawcall_t> &drawcalls,
+                     normal_weighting_t weighting = NORMAL_WEIGHT_AREA,
+                     unsigned nbr_threads = 1);
+
+//
+// Creates per-vertex tangent frames for a welded mesh
+//
+// Texture-space tangents of all faces sharing a vertex are summed, then Gram-Schmidt orthonormalized
+// against the vertex normal. The handedness of the uv mapping is kept in the binormal, which is
+// cross(Normal, Tangent) flipped for mirrored uvs. Vertices without a usable uv gradient get an
+// arbitrary frame around the normal. nbr_threads as for compute_normals, the same on any number of
+// threads.
+//
+void compute_tangentspace(std::vector<vertex_t> &vertices,
+                          const std::vector<drawcall_t> &drawcalls,
+                          unsigned nbr_threads = 1);
 
 
 //
@@ -94,14 +195,22 @@ public:
     std::vector<vertex_t> vertices;
     std::vector<drawcall_t> drawcalls;
     std::vector<material_t> materials;
+    std::vector<std::string> mtllibs;   // paths of the material files referenced by the obj
+    
+    double parse_ms = 0;                // of the last load_obj: parsing only, without normals & welding
     
     static void load_mtl(	std::string dir,
 							std::string filename,
 							mtl_hash_t &mtl_hash);
     
+    //
+    // nbr_threads: upper bound on parser threads, 0 = one per hardware thread
+    // (every thread gets at least 1 MB of the file, so small files are parsed serially)
+    //
     void load_obj(	const std::string& filename,
 					bool auto_generate_normals = true,
-					bool triangulate = true);
+					bool triangulate = true,
+					unsigned nbr_threads = 0);
 };
 
 #endif
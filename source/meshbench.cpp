@@ -0,0 +1,467 @@
+//
+//  meshbench.cpp
+//
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+#include "meshbench.h"
+#include "mesh.h"
+
+using linalg::vec2f;
+using linalg::int3;
+
+static const char* generated_obj = "meshbench_generated.obj";
+static const char* generated_materials_obj = "meshbench_materials.obj";
+static const char* generated_mtl = "meshbench_materials.mtl";
+
+//
+// unwelded mesh data, as load_obj has it before welding
+//
+struct generated_mesh_t
+{
+	std::vector<vec3f> v, vn;
+	std::vector<vec2f> vt;
+	unwelded_drawcall_t dc;
+};
+
+//
+// A w x h quad grid over a wavy heightfield, two triangles per quad, with one texcoord per position
+// and either one normal per position (smooth) or one per quad (flat shaded, so a position is shared
+// by up to four (position, normal, texcoord) combinations)
+//
+static void generate_grid(int w, int h, bool hard_edges, generated_mesh_t& mesh)
+{
+	for (int y = 0; y <= h; y++)
+		for (int x = 0; x <= w; x++)
+		{
+			float s = std::sin(x * 0.7f), c = std::cos(y * 0.5f);
+			mesh.v.push_back(vec3f((float)x, 0.25f * s * c, (float)y));
+			mesh.vt.push_back(vec2f(x / (float)w, y / (float)h));
+			if (!hard_edges)
+				mesh.vn.push_back(linalg::normalize(vec3f(-0.175f * std::cos(x * 0.7f) * c, 1.0f, 0.125f * s * std::sin(y * 0.5f))));
+		}
+
+	auto add_triangle = [&](int a, int b, int c, int n)
+	{
+		unwelded_triangle_t tri = { a, b, c, a, b, c, a, b, c };
+		if (hard_edges)
+			tri.vi[3] = tri.vi[4] = tri.vi[5] = n;
+		mesh.dc.tris.push_back(tri);
+	};
+
+	// ccw seen from above
+	for (int y = 0; y < h; y++)
+		for (int x = 0; x < w; x++)
+		{
+			int i00 = y * (w + 1) + x, i10 = i00 + 1, i01 = i00 + w + 1, i11 = i01 + 1;
+			int n = (int)mesh.vn.size();
+			if (hard_edges)
+				mesh.vn.push_back(linalg::normalize((mesh.v[i01] - mesh.v[i10]) % (mesh.v[i11] - mesh.v[i00])));
+			add_triangle(i00, i01, i11, n);
+			add_triangle(i00, i11, i10, n);
+		}
+}
+
+//
+// write the mesh as an obj file, false if it could not be written. With an mtllib, a usemtl
+// switches to the next of nbr_materials materials every faces_per_usemtl faces, cycling.
+//
+static bool write_obj(const char* filename, const generated_mesh_t& mesh,
+					  const char* mtllib = nullptr, size_t faces_per_usemtl = 0, int nbr_materials = 0)
+{
+	FILE* f = fopen(filename, "wb");
+	if (!f)
+		return false;
+
+	if (mtllib)
+		fprintf(f, "mtllib %s\n", mtllib);
+	for (auto& v : mesh.v)
+		fprintf(f, "v %.6f %.6f %.6f\n", v.x, v.y, v.z);
+	for (auto& vt : mesh.vt)
+		fprintf(f, "vt %.6f %.6f\n", vt.x, vt.y);
+	for (auto& vn : mesh.vn)
+		fprintf(f, "vn %.6f %.6f %.6f\n", vn.x, vn.y, vn.z);
+	fprintf(f, "g grid\n");
+
+	// every other face with relative indices, which the chunked parser resolves across chunks
+	int nbr_v = (int)mesh.v.size(), nbr_vt = (int)mesh.vt.size(), nbr_vn = (int)mesh.vn.size();
+	for (size_t i = 0; i < mesh.dc.tris.size(); i++)
+	{
+		if (mtllib && i % faces_per_usemtl == 0)
+			fprintf(f, "usemtl mtl%d\n", (int)(i / faces_per_usemtl % nbr_materials));
+
+		const int* vi = mesh.dc.tris[i].vi;
+		int v = 1, vt = 1, vn = 1;
+		if (i & 1)
+		{
+			v = -nbr_v;
+			vt = -nbr_vt;
+			vn = -nbr_vn;
+		}
+		fprintf(f, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", vi[0] + v, vi[6] + vt, vi[3] + vn, vi[1] + v, vi[7] + vt, vi[4] + vn, vi[2] + v, vi[8] + vt, vi[5] + vn);
+	}
+
+	bool ok = !ferror(f);
+	return !fclose(f) && ok;
+}
+
+static long long file_size(const char* filename)
+{
+	FILE* f = fopen(filename, "rb");
+	if (!f)
+		return -1;
+	fseek(f, 0, SEEK_END);
+	long long size = ftell(f);
+	fclose(f);
+	return size;
+}
+
+//
+// load_obj on nbr_threads parser threads, in ms, best of nbr_runs; parse_ms is the best time of the
+// parse phase alone
+//
+static double time_load_ms(const char* filename, unsigned nbr_threads, int nbr_runs, mesh_t& mesh, double& parse_ms)
+{
+	double best = 1e30;
+	parse_ms = 1e30;
+	for (int run = 0; run < nbr_runs; run++)
+	{
+		mesh = mesh_t();
+		auto t0 = std::chrono::high_resolution_clock::now();
+		mesh.load_obj(filename, false, true, nbr_threads);
+		auto t1 = std::chrono::high_resolution_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::milli>(t1 - t0).count());
+		parse_ms = std::min(parse_ms, mesh.parse_ms);
+	}
+	return best;
+}
+
+//
+// the loaded mesh has every generated triangle and, the grid being smooth, one vertex per position
+//
+static bool matches(const mesh_t& mesh, const generated_mesh_t& generated)
+{
+	size_t nbr_tris = 0, nbr_quads = 0;
+	for (auto& dc : mesh.drawcalls)
+	{
+		nbr_tris += dc.tris.size();
+		nbr_quads += dc.quads.size();
+	}
+	return mesh.has_normals && mesh.has_texcoords && mesh.vertices.size() == generated.v.size() &&
+		nbr_tris == generated.dc.tris.size() && !nbr_quads;
+}
+
+//
+// same vertices and faces, bit for bit
+//
+static bool identical(const mesh_t& a, const mesh_t& b)
+{
+	if (a.vertices.size() != b.vertices.size() || a.drawcalls.size() != b.drawcalls.size() ||
+		memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(vertex_t)))
+		return false;
+	for (size_t i = 0; i < a.drawcalls.size(); i++)
+	{
+		const drawcall_t &da = a.drawcalls[i], &db = b.drawcalls[i];
+		if (da.mtl_index != db.mtl_index || da.group_name != db.group_name ||
+			da.tris.size() != db.tris.size() || da.quads.size() != db.quads.size() ||
+			memcmp(da.tris.data(), db.tris.data(), da.tris.size() * sizeof(triangle_t)) ||
+			memcmp(da.quads.data(), db.quads.data(), da.quads.size() * sizeof(quad_t_)))
+			return false;
+	}
+	return true;
+}
+
+//
+// Welding as load_obj did it before weld_table_t: a std::unordered_map (one node allocation per
+// vertex) hashed on the position index only
+//
+struct position_hash_t
+{
+	size_t operator () (const int3& i3) const
+	{
+		return i3.x;
+	}
+};
+
+static size_t weld_reference(const unwelded_drawcall_t& dc, std::vector<unsigned>& indices)
+{
+	std::unordered_map<int3, unsigned, position_hash_t> index3_to_index;
+	indices.clear();
+	for (auto& tri : dc.tris)
+		for (int i = 0; i < 3; i++)
+		{
+			auto r = index3_to_index.insert(std::make_pair(int3(tri.vi[0+i], tri.vi[3+i], tri.vi[6+i]), (unsigned)index3_to_index.size()));
+			indices.push_back(r.first->second);
+		}
+	return index3_to_index.size();
+}
+
+static size_t weld(const unwelded_drawcall_t& dc, size_t nbr_positions, std::vector<unsigned>& indices)
+{
+	// sized as load_obj does
+	weld_table_t table;
+	table.reset(std::max(nbr_positions, dc.tris.size() * 3 / 6));
+	unsigned nbr_vertices = 0;
+	indices.clear();
+	for (auto& tri : dc.tris)
+		for (int i = 0; i < 3; i++)
+		{
+			bool inserted;
+			indices.push_back(table.find_or_insert(int3(tri.vi[0+i], tri.vi[3+i], tri.vi[6+i]), nbr_vertices, inserted));
+			nbr_vertices += inserted;
+		}
+	return nbr_vertices;
+}
+
+//
+// weld_table_t against the map it replaced, on a smooth and a hard-edged grid; both number the
+// vertices in order of first use, so the results are identical
+//
+static bool time_welding()
+{
+	bool ok = true;
+	for (int hard_edges = 0; hard_edges < 2; hard_edges++)
+	{
+		generated_mesh_t grid;
+		generate_grid(1000, 500, hard_edges != 0, grid);
+
+		std::vector<unsigned> indices, ref_indices;
+		size_t nbr_vertices = 0, ref_nbr_vertices = 0;
+		double ms = 1e30, ref_ms = 1e30;
+		for (int run = 0; run < 3; run++)
+		{
+			auto t0 = std::chrono::high_resolution_clock::now();
+			ref_nbr_vertices = weld_reference(grid.dc, ref_indices);
+			auto t1 = std::chrono::high_resolution_clock::now();
+			nbr_vertices = weld(grid.dc, grid.v.size(), indices);
+			auto t2 = std::chrono::high_resolution_clock::now();
+			ref_ms = std::min(ref_ms, std::chrono::duration<double, std::milli>(t1 - t0).count());
+			ms = std::min(ms, std::chrono::duration<double, std::milli>(t2 - t1).count());
+		}
+
+		bool same = nbr_vertices == ref_nbr_vertices && indices == ref_indices;
+		ok &= same;
+		printf("%-28s %d corners -> %d vertices, unordered_map %.1f ms, weld_table_t %.1f ms (%.2fx) - %s\n",
+			hard_edges ? "weld, hard edges" : "weld, smooth", (int)indices.size(), (int)nbr_vertices,
+			ref_ms, ms, ref_ms / ms, same ? "identical" : "FAILED, differs from unordered_map");
+	}
+	return ok;
+}
+
+//
+// compute_normals as it was before accumulating in place: every face normal is pushed to a vector
+// per vertex, then averaged (unweighted, triangles only)
+//
+static void compute_normals_reference(const std::vector<vec3f>& v, std::vector<vec3f>& vn, std::vector<unwelded_drawcall_t>& drawcalls)
+{
+	std::vector<vec3f>* v_bin = new std::vector<vec3f>[v.size()];
+
+	for (unwelded_drawcall_t& dc : drawcalls)
+		for (unwelded_triangle_t& tri : dc.tris)
+		{
+			int a = tri.vi[0], b = tri.vi[1], c = tri.vi[2];
+			vec3f n = linalg::normalize((v[b] - v[a]) % (v[c] - v[a]));
+			v_bin[a].push_back(n);
+			v_bin[b].push_back(n);
+			v_bin[c].push_back(n);
+			memcpy(tri.vi + 3, tri.vi, 3 * sizeof(int));
+		}
+
+	vn.clear();
+	for (size_t i = 0; i < v.size(); i++)
+	{
+		vec3f n = vec3f(0, 0, 0);
+		for (auto& face_n : v_bin[i])
+			n += face_n;
+		vn.push_back(linalg::normalize(n));
+	}
+
+	delete[] v_bin;
+}
+
+static void report_normals(const char* weighting, double ms, double ref_ms, unsigned nbr_threads)
+{
+	printf("%-28s %s %.1f ms (%u thread%s, %.2fx)\n", "compute_normals", weighting, ms, nbr_threads, nbr_threads > 1 ? "s" : "", ref_ms / ms);
+}
+
+//
+// compute_normals against the function it replaced, serially and on nbr_threads threads
+//
+static bool time_normals(unsigned nbr_threads)
+{
+	generated_mesh_t grid;
+	generate_grid(1000, 500, false, grid);
+
+	// compute_normals rewrites the normal indices, so every run gets fresh drawcalls
+	auto time_ms = [&](std::vector<vec3f>& vn, const std::function<void(std::vector<unwelded_drawcall_t>&)>& fn) -> double
+	{
+		double best = 1e30;
+		for (int run = 0; run < 3; run++)
+		{
+			std::vector<unwelded_drawcall_t> drawcalls(1, grid.dc);
+			vn.clear();
+			auto t0 = std::chrono::high_resolution_clock::now();
+			fn(drawcalls);
+			auto t1 = std::chrono::high_resolution_clock::now();
+			best = std::min(best, std::chrono::duration<double, std::milli>(t1 - t0).count());
+		}
+		return best;
+	};
+
+	std::vector<vec3f> ref_vn, area_vn, angle_vn, parallel_area_vn, parallel_angle_vn;
+	double ref_ms = time_ms(ref_vn, [&](std::vector<unwelded_drawcall_t>& dcs) { compute_normals_reference(grid.v, ref_vn, dcs); });
+	double area_ms = time_ms(area_vn, [&](std::vector<unwelded_drawcall_t>& dcs) { compute_normals(grid.v, area_vn, dcs, NORMAL_WEIGHT_AREA, 1); });
+	double angle_ms = time_ms(angle_vn, [&](std::vector<unwelded_drawcall_t>& dcs) { compute_normals(grid.v, angle_vn, dcs, NORMAL_WEIGHT_ANGLE, 1); });
+	double parallel_area_ms = time_ms(parallel_area_vn, [&](std::vector<unwelded_drawcall_t>& dcs) { compute_normals(grid.v, parallel_area_vn, dcs, NORMAL_WEIGHT_AREA, nbr_threads); });
+	double parallel_angle_ms = time_ms(parallel_angle_vn, [&](std::vector<unwelded_drawcall_t>& dcs) { compute_normals(grid.v, parallel_angle_vn, dcs, NORMAL_WEIGHT_ANGLE, nbr_threads); });
+
+	printf("%-28s %d faces, vector per vertex %.1f ms\n", "compute_normals", (int)grid.dc.tris.size(), ref_ms);
+	report_normals("area weighted", area_ms, ref_ms, 1);
+	report_normals("area weighted", parallel_area_ms, ref_ms, nbr_threads);
+	report_normals("angle weighted", angle_ms, ref_ms, 1);
+	report_normals("angle weighted", parallel_angle_ms, ref_ms, nbr_threads);
+
+	// the sums of a vertex are formed in face order on any number of threads
+	auto same = [&](const std::vector<vec3f>& a, const std::vector<vec3f>& b)
+	{
+		return a.size() == grid.v.size() && b.size() == a.size() && !memcmp(a.data(), b.data(), a.size() * sizeof(vec3f));
+	};
+	bool area_ok = same(parallel_area_vn, area_vn), angle_ok = same(parallel_angle_vn, angle_vn);
+	printf("%-28s area weighted on %u threads - %s\n", "compute_normals", nbr_threads, area_ok ? "identical" : "FAILED, differs from 1 thread");
+	printf("%-28s angle weighted on %u threads - %s\n", "compute_normals", nbr_threads, angle_ok ? "identical" : "FAILED, differs from 1 thread");
+	return area_ok && angle_ok;
+}
+
+//
+// A smooth grid in bands of rows, each band a usemtl of its own (cycling through 4 materials),
+// so neighbouring drawcalls share the row of vertices between them. Vertex count & bytes with
+// shared welding (one vertex per position) and with welding per drawcall, and that load_obj
+// produces the one MESH_SHARED_WELDING selects.
+//
+static bool report_shared_welding(unsigned nbr_threads)
+{
+	const int w = 1000, h = 100, rows_per_band = 5, nbr_materials = 4;
+	generated_mesh_t grid;
+	generate_grid(w, h, false, grid);
+
+	FILE* f = fopen(generated_mtl, "wb");
+	if (!f)
+	{
+		printf("%s: FAILED - could not write\n", generated_mtl);
+		return false;
+	}
+	for (int m = 0; m < nbr_materials; m++)
+		fprintf(f, "newmtl mtl%d\nKd %.2f %.2f %.2f\n", m, (m & 1) * 1.0f, (m >> 1 & 1) * 1.0f, 0.5f);
+	bool written = !ferror(f);
+	written &= !fclose(f);
+
+	const size_t faces_per_band = 2 * w * rows_per_band;
+	written = written && write_obj(generated_materials_obj, grid, generated_mtl, faces_per_band, nbr_materials);
+	if (!written)
+	{
+		printf("%s: FAILED - could not write\n", generated_materials_obj);
+		remove(generated_mtl);
+		return false;
+	}
+
+	// per drawcall: the distinct positions of each band
+	size_t nbr_shared = grid.v.size(), nbr_per_drawcall = 0;
+	std::vector<size_t> last_band(grid.v.size(), ~(size_t)0);
+	for (size_t i = 0; i < grid.dc.tris.size(); i++)
+		for (int j = 0; j < 3; j++)
+		{
+			size_t& last = last_band[grid.dc.tris[i].vi[j]];
+			if (last != i / faces_per_band)
+			{
+				last = i / faces_per_band;
+				nbr_per_drawcall++;
+			}
+		}
+
+	bool ok = true;
+	try
+	{
+		mesh_t mesh;
+		mesh.load_obj(generated_materials_obj, false, true, nbr_threads);
+#ifdef MESH_SHARED_WELDING
+		const char* mode = "shared";
+		ok = mesh.vertices.size() == nbr_shared;
+#else
+		const char* mode = "per drawcall";
+		ok = mesh.vertices.size() == nbr_per_drawcall;
+#endif
+		ok &= mesh.drawcalls.size() == (grid.dc.tris.size() + faces_per_band - 1) / faces_per_band && mesh.materials.size() == (size_t)nbr_materials;
+
+		double kb = sizeof(vertex_t) / 1024.0;
+		printf("%-28s %d drawcalls, %d materials: per drawcall %d vertices (%.1f KB), shared %d vertices (%.1f KB, %.1f%% less)\n",
+			"weld, usemtl bands", (int)mesh.drawcalls.size(), (int)mesh.materials.size(), (int)nbr_per_drawcall, nbr_per_drawcall * kb,
+			(int)nbr_shared, nbr_shared * kb, 100.0 * (nbr_per_drawcall - nbr_shared) / nbr_per_drawcall);
+		printf("%-28s %s welding, %d vertices - %s\n", "load_obj, usemtl bands", mode, (int)mesh.vertices.size(), ok ? "OK" : "FAILED");
+	}
+	catch (const std::exception& e)
+	{
+		printf("%s: FAILED - %s\n", generated_materials_obj, e.what());
+		ok = false;
+	}
+
+	remove(generated_materials_obj);
+	remove(generated_mtl);
+	return ok;
+}
+
+bool mesh_bench(unsigned nbr_threads)
+{
+	generated_mesh_t grid;
+	generate_grid(1000, 500, false, grid);
+	if (!write_obj(generated_obj, grid))
+	{
+		printf("%s: FAILED - could not write\n", generated_obj);
+		return false;
+	}
+	double mb = file_size(generated_obj) / (1024.0 * 1024.0);
+
+	bool ok = true;
+	try
+	{
+		// parse MB/s of the parse phase alone, next to the whole of load_obj (parse + weld)
+		mesh_t mesh;
+		double parse_ms;
+		double ms = time_load_ms(generated_obj, 1, 3, mesh, parse_ms);
+		ok = matches(mesh, grid);
+		printf("%-28s %d faces, %.1f MB, parse %.1f ms, %.1f MB/s, total %.1f ms (1 thread) - %s\n", "load_obj",
+			(int)grid.dc.tris.size(), mb, parse_ms, mb / (parse_ms * 1e-3), ms, ok ? "OK" : "FAILED");
+
+		// chunked parsing: same result as the serial parse on any number of threads
+		for (unsigned nbr_threads = 2; nbr_threads <= 16; nbr_threads *= 2)
+		{
+			mesh_t parallel_mesh;
+			double parallel_parse_ms;
+			double parallel_ms = time_load_ms(generated_obj, nbr_threads, 3, parallel_mesh, parallel_parse_ms);
+			bool same = identical(parallel_mesh, mesh);
+			ok &= same;
+			printf("%-28s parse %.1f ms, %.1f MB/s (%.2fx), total %.1f ms (%u threads) - %s\n", "load_obj",
+				parallel_parse_ms, mb / (parallel_parse_ms * 1e-3), parse_ms / parallel_parse_ms, parallel_ms, nbr_threads,
+				same ? "identical" : "FAILED, differs from 1 thread");
+		}
+	}
+	catch (const std::exception& e)
+	{
+		printf("%s: FAILED - %s\n", generated_obj, e.what());
+		ok = false;
+	}
+
+	remove(generated_obj);
+
+	ok &= time_welding();
+	ok &= report_shared_welding(nbr_threads);
+	ok &= time_normals(nbr_threads);
+	return ok;
+}
@@ -0,0 +1,27 @@
+//
+//  meshbench.h
+//
+//  Benchmarks of the OBJ import pipeline (mesh.h) on meshes generated on the fly, so the numbers
+//  do not depend on which assets happen to be on disk. Run by the cooker (-b). Headless and
+//  platform-independent.
+//
+
+#pragma once
+#ifndef MESHBENCH_H
+#define MESHBENCH_H
+
+//
+// Write a generated OBJ file of about a million faces to the working directory, time loading it
+// (the parse phase alone and the whole of load_obj) on 1, 2, 4, 8 and 16 parser threads and delete
+// it again. False if the loaded mesh is not the
+// generated one, or differs between thread counts.
+//
+// Then time vertex welding against the std::unordered_map it replaced, on smooth and hard-edged
+// meshes, report the vertices & bytes of shared and per-drawcall welding on a mesh with many
+// usemtl, and time compute_normals against the per-vertex vectors it replaced, also on nbr_threads
+// threads. False if the welded results differ, load_obj welds to another vertex count than
+// expected, or the normals differ between thread counts.
+//
+bool mesh_bench(unsigned nbr_threads);
+
+#endif
@@ -0,0 +1,319 @@
+//
+//  meshcache.cpp
+//
+
+#include <cstdio>
+#include <iostream>
+#include "meshcache.h"
+#include "parseutil.h"
+#include "assetpack.h"
+
+//
+// file layout: header, then the sections at the offsets given in the header
+//
+struct mesh_cache_header_t
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t vertex_size;		// sizeof(vertex_t) when written, guards against layout changes
+	uint64_t file_size;			// detects truncation
+	uint64_t payload_hash;		// hash of everything after the header, detects corruption (if verified, see load)
+
+	uint32_t nbr_sources, nbr_vertices, nbr_indices, nbr_ranges, nbr_materials, strings_size;
+	uint64_t sources_ofs, vertices_ofs, indices_ofs, ranges_ofs, materials_ofs, strings_ofs;
+};
+
+static const char mesh_cache_magic[8] = { 'E', 'D', 'U', 'M', 'E', 'S', 'H', 0 };
+
+// strings are stored as (offset, length) into a shared string table
+struct mesh_cache_string_t
+{
+	uint32_t ofs, len;
+};
+
+// fingerprint of a source file
+struct mesh_cache_source_t
+{
+	uint64_t size;
+	int64_t mtime;
+	uint64_t hash;
+	mesh_cache_string_t path;
+};
+
+struct mesh_cache_material_t
+{
+	float Ka[3], Kd[3], Ks[3];
+	mesh_cache_string_t name, map_Kd, map_bump;
+};
+
+static bool fingerprint_source(const std::string& path, mesh_cache_source_t& src)
+{
+	unsigned long long size, hash;
+	long long mtime;
+	if (!file_stat(path.c_str(), size, mtime) || !hash_file(path.c_str(), hash))
+		return false;
+
+	src.size = size;
+	src.mtime = mtime;
+	src.hash = hash;
+	return true;
+}
+
+//
+// A source with the size and mtime it was cooked from is taken as unchanged without reading it.
+// If only the mtime differs, the content hash decides, so touching a file or checking it out again
+// does not invalidate its cache. A source that is not there at all is not checked: cooked caches
+// can be shipped without the OBJs.
+//
+static bool source_unchanged(const std::string& path, const mesh_cache_source_t& src)
+{
+	unsigned long long size, hash;
+	long long mtime;
+	if (!file_stat(path.c_str(), size, mtime))
+		return true;
+	if (size != src.size)
+		return false;
+	return mtime == src.mtime || (hash_file(path.c_str(), hash) && hash == src.hash);
+}
+
+//
+// Paths are stored relative to the directory of the cache, so a cache cooked from one working
+// directory loads from any other. Paths outside that directory are stored as given.
+//
+static bool is_absolute_path(const std::string& path)
+{
+	return (path.size() > 0 && (path[0] == '/' || path[0] == '\\')) || (path.size() > 1 && path[1] == ':');
+}
+
+static std::string to_cache_path(const std::string& path, const std::string& dir)
+{
+	return (dir.size() && !path.compare(0, dir.size(), dir)) ? path.substr(dir.size()) : path;
+}
+
+static std::string from_cache_path(const std::string& path, const std::string& dir)
+{
+	return (path.empty() || is_absolute_path(path)) ? path : dir + path;
+}
+
+// true if the section [ofs, ofs + count*elem_size) lies within the file
+static bool section_fits(uint64_t ofs, uint64_t count, uint64_t elem_size, uint64_t file_size)
+{
+	return ofs <= file_size && count <= (file_size - ofs) / elem_size;
+}
+
+static uint64_t align16(uint64_t ofs)
+{
+	return (ofs + 15) & ~15ull;
+}
+
+bool mesh_cache_t::load(const std::string& cachefile, bool verify_payload)
+{
+	close();
+
+	if (!vfs_open(cachefile, file))
+		return false;
+
+	// validate header & sections
+	//
+	mesh_cache_header_t header;
+	if (file.size < sizeof(header))
+	{
+		close();
+		return false;
+	}
+	memcpy(&header, file.data, sizeof(header));
+
+	bool valid =
+		!memcmp(header.magic, mesh_cache_magic, sizeof(mesh_cache_magic)) &&
+		header.version == MESH_CACHE_VERSION &&
+		header.vertex_size == sizeof(vertex_t) &&
+		header.file_size == file.size &&
+		section_fits(header.sources_ofs, header.nbr_sources, sizeof(mesh_cache_source_t), file.size) &&
+		section_fits(header.vertices_ofs, header.nbr_vertices, sizeof(vertex_t), file.size) &&
+		section_fits(header.indices_ofs, header.nbr_indices, sizeof(unsigned), file.size) &&
+		section_fits(header.ranges_ofs, header.nbr_ranges, sizeof(mesh_cache_range_t), file.size) &&
+		section_fits(header.materials_ofs, header.nbr_materials, sizeof(mesh_cache_material_t), file.size) &&
+		section_fits(header.strings_ofs, header.strings_size, 1, file.size) &&
+		(!verify_payload || hash_bytes(file.data + sizeof(header), file.size - sizeof(header)) == header.payload_hash);
+
+	if (!valid)
+	{
+		printf("mesh cache %s is invalid, ignoring it\n", cachefile.c_str());
+		close();
+		return false;
+	}
+
+	const char* strings = file.data + header.strings_ofs;
+	std::string dir = get_parentdir(cachefile);
+	auto get_string = [&](const mesh_cache_string_t& s, std::string& res) -> bool
+	{
+		if (s.ofs > header.strings_size || s.len > header.strings_size - s.ofs)
+			return false;
+		res.assign(strings + s.ofs, s.len);
+		return true;
+	};
+	auto get_path = [&](const mesh_cache_string_t& s, std::string& res) -> bool
+	{
+		if (!get_string(s, res))
+			return false;
+		res = from_cache_path(res, dir);
+		return true;
+	};
+
+	// stale if the content of any source changed
+	//
+	const mesh_cache_source_t* sources = (const mesh_cache_source_t*)(file.data + header.sources_ofs);
+	for (uint32_t i = 0; i < header.nbr_sources; i++)
+	{
+		std::string path;
+		if (!get_path(sources[i].path, path) || !source_unchanged(path, sources[i]))
+		{
+			printf("mesh cache %s is stale, ignoring it\n", cachefile.c_str());
+			close();
+			return false;
+		}
+	}
+
+	// materials
+	//
+	const mesh_cache_material_t* mtls = (const mesh_cache_material_t*)(file.data + header.materials_ofs);
+	for (uint32_t i = 0; i < header.nbr_materials; i++)
+	{
+		material_t mtl;
+		mtl.Ka = vec3f(mtls[i].Ka[0], mtls[i].Ka[1], mtls[i].Ka[2]);
+		mtl.Kd = vec3f(mtls[i].Kd[0], mtls[i].Kd[1], mtls[i].Kd[2]);
+		mtl.Ks = vec3f(mtls[i].Ks[0], mtls[i].Ks[1], mtls[i].Ks[2]);
+		if (!get_string(mtls[i].name, mtl.name) ||
+			!get_path(mtls[i].map_Kd, mtl.map_Kd) ||
+			!get_path(mtls[i].map_bump, mtl.map_bump))
+		{
+			close();
+			return false;
+		}
+		materials.push_back(mtl);
+	}
+
+	// vertex, index & range data are used in place
+	//
+	vertices = (const vertex_t*)(file.data + header.vertices_ofs);
+	indices = (const unsigned*)(file.data + header.indices_ofs);
+	ranges = (const mesh_cache_range_t*)(file.data + header.ranges_ofs);
+	nbr_vertices = header.nbr_vertices;
+	nbr_indices = header.nbr_indices;
+	nbr_ranges = header.nbr_ranges;
+
+	for (size_t i = 0; i < nbr_ranges; i++)
+		if (ranges[i].start > nbr_indices || ranges[i].size > nbr_indices - ranges[i].start ||
+			ranges[i].mtl_index >= (int32_t)materials.size() || ranges[i].lod < 0 || !(ranges[i].lod_error >= 0))
+		{
+			close();
+			return false;
+		}
+
+	std::cout << "loaded mesh cache " << cachefile << "\n";
+	return true;
+}
+
+bool mesh_cache_t::save(const std::string& cachefile,
+						const std::vector<std::string>& sources,
+						const std::vector<vertex_t>& vertices,
+						const std::vector<unsigned>& indices,
+						const std::vector<mesh_cache_range_t>& ranges,
+						const std::vector<material_t>& materials)
+{
+	std::string strings;
+	std::string dir = get_parentdir(cachefile);
+	auto add_string = [&](const std::string& s) -> mesh_cache_string_t
+	{
+		mesh_cache_string_t res = { (uint32_t)strings.size(), (uint32_t)s.size() };
+		strings += s;
+		return res;
+	};
+
+	std::vector<mesh_cache_source_t> cache_sources(sources.size());
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		if (!fingerprint_source(sources[i], cache_sources[i]))
+			return false;
+		cache_sources[i].path = add_string(to_cache_path(sources[i], dir));
+	}
+
+	std::vector<mesh_cache_material_t> cache_materials(materials.size());
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		const material_t& mtl = materials[i];
+		mesh_cache_material_t& cmtl = cache_materials[i];
+		memcpy(cmtl.Ka, mtl.Ka.vec, sizeof(cmtl.Ka));
+		memcpy(cmtl.Kd, mtl.Kd.vec, sizeof(cmtl.Kd));
+		memcpy(cmtl.Ks, mtl.Ks.vec, sizeof(cmtl.Ks));
+		cmtl.name = add_string(mtl.name);
+		cmtl.map_Kd = add_string(to_cache_path(mtl.map_Kd, dir));
+		cmtl.map_bump = add_string(to_cache_path(mtl.map_bump, dir));
+	}
+
+	// lay out sections, 16-byte aligned
+	//
+	mesh_cache_header_t header = {};
+	memcpy(header.magic, mesh_cache_magic, sizeof(mesh_cache_magic));
+	header.version = MESH_CACHE_VERSION;
+	header.vertex_size = sizeof(vertex_t);
+	header.nbr_sources = (uint32_t)cache_sources.size();
+	header.nbr_vertices = (uint32_t)vertices.size();
+	header.nbr_indices = (uint32_t)indices.size();
+	header.nbr_ranges = (uint32_t)ranges.size();
+	header.nbr_materials = (uint32_t)cache_materials.size();
+	header.strings_size = (uint32_t)strings.size();
+
+	header.sources_ofs = align16(sizeof(header));
+	header.vertices_ofs = align16(header.sources_ofs + cache_sources.size() * sizeof(mesh_cache_source_t));
+	header.indices_ofs = align16(header.vertices_ofs + vertices.size() * sizeof(vertex_t));
+	header.ranges_ofs = align16(header.indices_ofs + indices.size() * sizeof(unsigned));
+	header.materials_ofs = align16(header.ranges_ofs + ranges.size() * sizeof(mesh_cache_range_t));
+	header.strings_ofs = align16(header.materials_ofs + cache_materials.size() * sizeof(mesh_cache_material_t));
+	header.file_size = header.strings_ofs + strings.size();
+
+	std::vector<char> blob((size_t)header.file_size, 0);
+	auto put = [&](uint64_t ofs, const void* data, size_t size) { if (size) memcpy(&blob[(size_t)ofs], data, size); };
+	put(header.sources_ofs, cache_sources.data(), cache_sources.size() * sizeof(mesh_cache_source_t));
+	put(header.vertices_ofs, vertices.data(), vertices.size() * sizeof(vertex_t));
+	put(header.indices_ofs, indices.data(), indices.size() * sizeof(unsigned));
+	put(header.ranges_ofs, ranges.data(), ranges.size() * sizeof(mesh_cache_range_t));
+	put(header.materials_ofs, cache_materials.data(), cache_materials.size() * sizeof(mesh_cache_material_t));
+	put(header.strings_ofs, strings.data(), strings.size());
+
+	header.payload_hash = hash_bytes(blob.data() + sizeof(header), blob.size() - sizeof(header));
+	put(0, &header, sizeof(header));
+
+	// write to a temporary and swap it in, so a failed write never leaves a truncated cache behind
+	//
+	std::string tmpfile = cachefile + ".tmp";
+	FILE* fp = fopen(tmpfile.c_str(), "wb");
+	if (!fp)
+		return false;
+	bool written = fwrite(blob.data(), 1, blob.size(), fp) == blob.size();
+	written &= (fclose(fp) == 0);
+
+	if (written)
+	{
+		remove(cachefile.c_str());
+		written = (rename(tmpfile.c_str(), cachefile.c_str()) == 0);
+	}
+	if (!written)
+	{
+		remove(tmpfile.c_str());
+		return false;
+	}
+
+	std::cout << "wrote mesh cache " << cachefile << "\n";
+	return true;
+}
+
+void mesh_cache_t::close()
+{
+	file.close();
+	vertices = nullptr;
+	indices = nullptr;
+	ranges = nullptr;
+	nbr_vertices = nbr_indices = nbr_ranges = 0;
+	materials.clear();
+}
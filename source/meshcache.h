@@ -0,0 +1,75 @@
+//
+//  meshcache.h
+//
+//  Binary cache of a loaded OBJ model: welded vertices, indices, drawcall ranges of all LODs and
+//  resolved materials. The cache is written next to the source file, by the renderer or ahead of
+//  time by the cooker, and memory-mapped on later loads, so vertex and index data go to the device
+//  without any parsing.
+//
+
+#pragma once
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "drawcall.h"
+#include "file_rw.h"
+
+#define MESH_CACHE_SUFFIX ".meshcache"
+#define MESH_CACHE_VERSION 7
+
+//
+// drawcall range within the cached index array
+//
+struct mesh_cache_range_t
+{
+	uint32_t start;
+	uint32_t size;
+	int32_t mtl_index;
+	int32_t lod;			// level of detail, 0 = full mesh
+	float lod_error;		// simplification error of the LOD, model units
+};
+
+class mesh_cache_t
+{
+	mapped_file_t file;
+
+public:
+
+	// views into the mapped cache, valid while the cache is open
+	const vertex_t* vertices = nullptr;
+	const unsigned* indices = nullptr;
+	const mesh_cache_range_t* ranges = nullptr;
+	size_t nbr_vertices = 0, nbr_indices = 0, nbr_ranges = 0;
+
+	// materials with names and map paths restored (device pointers are null)
+	std::vector<material_t> materials;
+
+	static std::string cache_path(const std::string& srcfile) { return srcfile + MESH_CACHE_SUFFIX; }
+
+	//
+	// Map (through the asset packs, see assetpack.h) and validate a cache. Fails if the file is missing,
+	// has another version or vertex layout, is truncated, or if any of its source files changed. With
+	// verify_payload the data is also hashed to detect corruption: the cooker does that before it
+	// trusts or packs a cache, a load at run time only checks the structure.
+	//
+	bool load(const std::string& cachefile, bool verify_payload = false);
+
+	//
+	// Write a cache. sources are the files the data was built from (obj and mtl files),
+	// they are fingerprinted (size, mtime, content hash) for the staleness check in load().
+	//
+	static bool save(const std::string& cachefile,
+					 const std::vector<std::string>& sources,
+					 const std::vector<vertex_t>& vertices,
+					 const std::vector<unsigned>& indices,
+					 const std::vector<mesh_cache_range_t>& ranges,
+					 const std::vector<material_t>& materials);
+
+	void close();
+};
+
+#endif
@@ -0,0 +1,310 @@
+//
+//  meshcheck.cpp
+//
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "meshcheck.h"
+#include "mesh.h"
+#include "meshlet.h"
+#include "meshopt.h"
+
+using linalg::vec2f;
+using linalg::int3;
+
+static const float pi = 3.14159265358979f;
+
+//
+// Cube [-1,1]^3 with its own four vertices per face, uv (0,0)-(1,1) per face with u along U and v along
+// V. The -z face is mapped mirrored, u along +x as on the +z face, so its binormal must be flipped.
+//
+static void generate_cube(std::vector<vertex_t>& vertices, std::vector<drawcall_t>& drawcalls)
+{
+	struct face_t { vec3f N, U, V; };
+	const face_t faces[] =
+	{
+		{ vec3f( 1, 0, 0), vec3f(0, 0, -1), vec3f(0, 1, 0) },
+		{ vec3f(-1, 0, 0), vec3f(0, 0, 1), vec3f(0, 1, 0) },
+		{ vec3f(0, 1, 0), vec3f(1, 0, 0), vec3f(0, 0, -1) },
+		{ vec3f(0, -1, 0), vec3f(1, 0, 0), vec3f(0, 0, 1) },
+		{ vec3f(0, 0, 1), vec3f(1, 0, 0), vec3f(0, 1, 0) },
+		{ vec3f(0, 0, -1), vec3f(1, 0, 0), vec3f(0, 1, 0) }
+	};
+
+	drawcall_t dc;
+	for (auto& f : faces)
+	{
+		unsigned base = (unsigned)vertices.size();
+		const float s[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+		for (auto& c : s)
+		{
+			vertex_t v;
+			v.Pos = f.N + f.U * c[0] + f.V * c[1];
+			v.Normal = f.N;
+			v.TexCoord = vec2f((c[0] + 1) * 0.5f, (c[1] + 1) * 0.5f);
+			vertices.push_back(v);
+		}
+
+		// ccw seen from outside, which is the other way around on the mirrored face
+		bool mirrored = linalg::dot(f.U % f.V, f.N) < 0;
+		unsigned b = mirrored ? 3 : 1, d = mirrored ? 1 : 3;
+		dc.tris.push_back({ { base, base + b, base + 2 } });
+		dc.tris.push_back({ { base, base + 2, base + d } });
+	}
+	drawcalls.push_back(dc);
+}
+
+//
+// Unit uv sphere, u around the y axis (longitude) and v from the north to the south pole, with a
+// seam of duplicated vertices at u = 0/1 and a row of vertices per pole
+//
+static vec3f sphere_point(float theta, float phi)
+{
+	return vec3f(std::sin(theta) * std::sin(phi), std::cos(theta), std::sin(theta) * std::cos(phi));
+}
+
+static void generate_sphere(int slices, int stacks, std::vector<vertex_t>& vertices, std::vector<drawcall_t>& drawcalls)
+{
+	for (int i = 0; i <= stacks; i++)
+		for (int j = 0; j <= slices; j++)
+		{
+			vertex_t v;
+			v.Pos = v.Normal = sphere_point(pi * i / stacks, 2 * pi * j / slices);
+			v.TexCoord = vec2f(j / (float)slices, i / (float)stacks);
+			vertices.push_back(v);
+		}
+
+	// ccw seen from outside, without the zero-area triangles at the poles
+	drawcall_t dc;
+	for (int i = 0; i < stacks; i++)
+		for (int j = 0; j < slices; j++)
+		{
+			unsigned a = i * (slices + 1) + j, b = a + slices + 1, c = b + 1, d = a + 1;
+			if (i < stacks - 1)
+				dc.tris.push_back({ { a, b, c } });
+			if (i > 0)
+				dc.tris.push_back({ { a, c, d } });
+		}
+	drawcalls.push_back(dc);
+}
+
+//
+// Tangent frames: the cube's T/B along its uv axes, including the mirrored -z face, and on the
+// sphere orthonormal frames along the longitude & latitude directions away from the poles, the same
+// on any number of threads
+//
+static bool check_tangentspace()
+{
+	const float tolerance = 1e-5f;
+	bool ok = true;
+
+	{
+		std::vector<vertex_t> cube;
+		std::vector<drawcall_t> drawcalls;
+		generate_cube(cube, drawcalls);
+		compute_tangentspace(cube, drawcalls);
+
+		// golden values of the +z face (regular) & the -z face (mirrored), both T = +x, B = +y
+		float max_error = 0;
+		for (auto& v : cube)
+			if (std::fabs(v.Normal.z) == 1)
+				max_error = std::max(max_error, std::max((v.Tangent - vec3f(1, 0, 0)).norm2(), (v.Binormal - vec3f(0, 1, 0)).norm2()));
+		bool cube_ok = max_error <= tolerance;
+		ok &= cube_ok;
+		printf("%-28s max error of T/B on the +-z faces %.3g - %s\n", "tangents, cube", max_error, cube_ok ? "OK" : "FAILED");
+	}
+
+	const int slices = 1024, stacks = 512;
+	std::vector<vertex_t> sphere;
+	std::vector<drawcall_t> drawcalls;
+	generate_sphere(slices, stacks, sphere, drawcalls);
+	std::vector<vertex_t> reference = sphere;
+	compute_tangentspace(reference, drawcalls, 1);
+
+	{
+		// unit length & orthogonality everywhere; away from the poles, T along dP/du and B along dP/dv
+		float max_length_error = 0, max_dot = 0, min_alignment = 1;
+		for (int i = 0; i <= stacks; i++)
+			for (int j = 0; j <= slices; j++)
+			{
+				const vertex_t& v = reference[i * (slices + 1) + j];
+				const vec3f N = v.Normal, T = v.Tangent, B = v.Binormal;
+				max_length_error = std::max(max_length_error, std::max(std::fabs(T.norm2() - 1), std::fabs(B.norm2() - 1)));
+				max_dot = std::max(max_dot, std::max(std::fabs(linalg::dot(T, N)), std::max(std::fabs(linalg::dot(B, N)), std::fabs(linalg::dot(T, B)))));
+				if (i == 0 || i == stacks)
+					continue;
+
+				float theta = pi * i / stacks, phi = 2 * pi * j / slices;
+				vec3f east(std::cos(phi), 0, -std::sin(phi));
+				vec3f south(std::cos(theta) * std::sin(phi), -std::sin(theta), std::cos(theta) * std::cos(phi));
+				min_alignment = std::min(min_alignment, std::min(linalg::dot(T, east), linalg::dot(B, south)));
+			}
+		bool sphere_ok = max_length_error <= tolerance && max_dot <= tolerance && min_alignment >= 0.999f;
+		ok &= sphere_ok;
+		printf("%-28s max |length - 1| %.3g, max |dot| %.3g, min alignment to dP/du & dP/dv %.6f - %s\n", "tangents, sphere",
+			max_length_error, max_dot, min_alignment, sphere_ok ? "OK" : "FAILED");
+	}
+
+	for (unsigned nbr_threads = 2; nbr_threads <= 8; nbr_threads *= 2)
+	{
+		std::vector<vertex_t> threaded = sphere;
+		compute_tangentspace(threaded, drawcalls, nbr_threads);
+		bool same = !memcmp(threaded.data(), reference.data(), threaded.size() * sizeof(vertex_t));
+		ok &= same;
+		printf("%-28s %d faces on %u threads - %s\n", "tangents, sphere",
+			(int)drawcalls[0].tris.size(), nbr_threads, same ? "identical" : "FAILED, differs from 1 thread");
+	}
+
+	return ok;
+}
+
+//
+// Meshlets of one triangle list: within the limits, covering the list in order, bounding spheres
+// that contain their vertices, and no front-facing triangle in a meshlet culled as back-facing from
+// a set of cameras orbiting the mesh at several distances
+//
+static bool check_meshlets(const char* name, const std::vector<vertex_t>& vertices, const std::vector<drawcall_t>& drawcalls,
+						   unsigned max_vertices, unsigned max_triangles)
+{
+	std::vector<unsigned> indices;
+	for (auto& dc : drawcalls)
+		for (auto& tri : dc.tris)
+			indices.insert(indices.end(), tri.vi, tri.vi + 3);
+
+	std::vector<meshlet_t> meshlets;
+	build_meshlets(indices.data(), 0, indices.size(), vertices.data(), meshlets, max_vertices, max_triangles);
+
+	bool limits_ok = true, coverage_ok = !meshlets.empty(), spheres_ok = true;
+	size_t next = 0;
+	for (auto& m : meshlets)
+	{
+		std::vector<unsigned> distinct(indices.begin() + m.start, indices.begin() + m.start + m.size);
+		std::sort(distinct.begin(), distinct.end());
+		distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+		limits_ok &= m.size > 0 && m.size % 3 == 0 && m.size / 3 <= max_triangles &&
+			m.nbr_vertices == distinct.size() && m.nbr_vertices <= max_vertices;
+
+		coverage_ok &= m.start == next;
+		next = m.start + m.size;
+
+		// the radius is rounded once, allow for that
+		for (unsigned v : distinct)
+			spheres_ok &= (vertices[v].Pos - m.center).norm2() <= m.radius * (1 + 1e-6f);
+	}
+	coverage_ok &= next == indices.size();
+
+	// cameras on three orbits (inside the bounds, near and far) of 64 directions each
+	const int nbr_directions = 64;
+	const float distances[] = { 0.5f, 1.5f, 10.0f };
+	size_t nbr_tests = 0, nbr_culled = 0, nbr_wrongly_culled = 0;
+	for (float distance : distances)
+		for (int k = 0; k < nbr_directions; k++)
+		{
+			// Fibonacci sphere
+			float y = 1 - 2 * (k + 0.5f) / nbr_directions, r = std::sqrt(1 - y * y), phi = k * 2.39996323f;
+			vec3f camera = vec3f(r * std::cos(phi), y, r * std::sin(phi)) * distance;
+
+			for (auto& m : meshlets)
+			{
+				nbr_tests++;
+				if (!meshlet_backfacing(m, camera))
+					continue;
+				nbr_culled++;
+
+				for (unsigned i = m.start; i < m.start + m.size; i += 3)
+				{
+					const vec3f &p0 = vertices[indices[i]].Pos, &p1 = vertices[indices[i+1]].Pos, &p2 = vertices[indices[i+2]].Pos;
+					if (linalg::dot((p1 - p0) % (p2 - p0), p0 - camera) < 0)
+					{
+						nbr_wrongly_culled++;
+						break;
+					}
+				}
+			}
+		}
+	bool culling_ok = !nbr_wrongly_culled;
+
+	print_meshlet_stats(meshlets, max_vertices, max_triangles);
+	printf("%-28s %d meshlets, limits %s, coverage %s, bounding spheres %s\n", name, (int)meshlets.size(),
+		limits_ok ? "OK" : "FAILED", coverage_ok ? "OK" : "FAILED", spheres_ok ? "OK" : "FAILED");
+	printf("%-28s %d of %d culled as back-facing, %d with a front-facing triangle - %s\n", name,
+		(int)nbr_culled, (int)nbr_tests, (int)nbr_wrongly_culled, culling_ok ? "OK" : "FAILED");
+
+	return limits_ok && coverage_ok && spheres_ok && culling_ok;
+}
+
+//
+// Overdraw of two nested spheres, the inner one at half the radius listed first, so it is drawn
+// before the outer one that hides it from every view: optimize_overdraw draws the outer one first,
+// keeps the triangles and stays within its ACMR threshold
+//
+static bool check_overdraw()
+{
+	std::vector<vertex_t> vertices;
+	std::vector<drawcall_t> inner, outer;
+	generate_sphere(64, 32, vertices, inner);
+	for (auto& v : vertices)
+		v.Pos = v.Pos * 0.5f;
+	unsigned base = (unsigned)vertices.size();
+	generate_sphere(64, 32, vertices, outer);
+
+	std::vector<unsigned> indices;
+	for (auto& tri : inner[0].tris)
+		indices.insert(indices.end(), tri.vi, tri.vi + 3);
+	for (auto& tri : outer[0].tris)
+		for (unsigned v : tri.vi)
+			indices.push_back(base + v);
+
+	// as optimize_triangle_order does, the overdraw pass works on a cache-optimized list
+	optimize_vertex_cache(indices.data(), indices.size(), vertices.size());
+	float overdraw_before = estimate_overdraw(indices.data(), indices.size(), vertices);
+	float acmr_before = compute_vertex_cache_stats(indices.data(), indices.size(), vertices.size()).acmr;
+
+	std::vector<unsigned> optimized = indices;
+	optimize_overdraw(optimized.data(), optimized.size(), vertices);
+	float overdraw_after = estimate_overdraw(optimized.data(), optimized.size(), vertices);
+	float acmr_after = compute_vertex_cache_stats(optimized.data(), optimized.size(), vertices.size()).acmr;
+
+	// the same triangles, each with its vertices in the same order
+	auto sorted_triangles = [](const std::vector<unsigned>& list)
+	{
+		std::vector<int3> tris;
+		for (size_t i = 0; i < list.size(); i += 3)
+			tris.push_back(int3(list[i], list[i+1], list[i+2]));
+		std::sort(tris.begin(), tris.end(), [](const int3& a, const int3& b)
+		{
+			return a.x != b.x ? a.x < b.x : (a.y != b.y ? a.y < b.y : a.z < b.z);
+		});
+		return tris;
+	};
+	std::vector<int3> tris_before = sorted_triangles(indices), tris_after = sorted_triangles(optimized);
+	bool same_tris = tris_before.size() == tris_after.size() &&
+		std::equal(tris_before.begin(), tris_before.end(), tris_after.begin(), [](const int3& a, const int3& b) { return a.x == b.x && a.y == b.y && a.z == b.z; });
+
+	bool ok = same_tris && overdraw_after < overdraw_before && acmr_after <= MESH_OVERDRAW_THRESHOLD * acmr_before;
+	printf("%-28s overdraw %.3f -> %.3f, ACMR %.3f -> %.3f (threshold %.2fx), triangles %s - %s\n", "overdraw, nested spheres",
+		overdraw_before, overdraw_after, acmr_before, acmr_after, MESH_OVERDRAW_THRESHOLD, same_tris ? "kept" : "changed", ok ? "OK" : "FAILED");
+	return ok;
+}
+
+bool mesh_check()
+{
+	bool ok = check_tangentspace();
+
+	std::vector<vertex_t> cube, sphere;
+	std::vector<drawcall_t> cube_drawcalls, sphere_drawcalls;
+	generate_cube(cube, cube_drawcalls);
+	generate_sphere(64, 32, sphere, sphere_drawcalls);
+
+	// a meshlet per cube face, with flat normal cones
+	ok &= check_meshlets("meshlets, cube", cube, cube_drawcalls, 4, 2);
+	ok &= check_meshlets("meshlets, sphere", sphere, sphere_drawcalls, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+	ok &= check_meshlets("meshlets, sphere, small", sphere, sphere_drawcalls, 16, 8);
+
+	ok &= check_overdraw();
+	return ok;
+}
@@ -0,0 +1,22 @@
+//
+//  meshcheck.h
+//
+//  Golden-value and invariant checks of the mesh processing passes (mesh.h) on meshes generated
+//  on the fly, so they do not depend on which assets happen to be on disk. Run by the cooker (-k).
+//  Headless and platform-independent.
+//
+
+#pragma once
+#ifndef MESHCHECK_H
+#define MESHCHECK_H
+
+//
+// Check the tangent frames of compute_tangentspace on a uv-mapped cube and sphere, on 1 and more
+// threads, and the meshlets of build_meshlets (meshlet.h) on the same meshes: limits, coverage,
+// bounding spheres and back-face culling. Then optimize_overdraw (meshopt.h) on nested spheres:
+// less overdraw, the same triangles, ACMR within the threshold. Prints a line per check, false if
+// any failed.
+//
+bool mesh_check();
+
+#endif
@@ -0,0 +1,117 @@
+//
+//  meshcook.cpp
+//
+
+#include "meshcook.h"
+#include "meshopt.h"
+#include "meshsimplify.h"
+
+void cook_mesh(const std::string& objfile,
+			   cooked_mesh_t& cooked,
+			   unsigned nbr_threads,
+			   const cook_progress_t& progress)
+{
+	// rough share of the pipeline time of each stage, for progress reports
+	auto report = [&](float done) { if (progress) progress(done); };
+
+	mesh_t mesh;
+	mesh.load_obj(objfile, true, true, nbr_threads);
+	report(0.35f);
+
+#ifdef MESH_OPTIMIZE_VERTEX_CACHE
+	// triangle order for the post-transform cache, vertex order for fetch
+	optimize_mesh(mesh);
+#endif
+	report(0.45f);
+
+	// per-vertex tangent frames for normal mapping
+	compute_tangentspace(mesh.vertices, mesh.drawcalls, nbr_threads);
+	report(0.5f);
+
+	// indices in ranges per drawcall (material), one set of ranges per LOD
+	//
+	cooked.indices.clear();
+	cooked.ranges.clear();
+	auto append_ranges = [&](const std::vector<drawcall_t>& drawcalls, int lod, float lod_error)
+	{
+		for (auto& dc : drawcalls)
+		{
+			size_t i_ofs = cooked.indices.size();
+			for (auto& tri : dc.tris)
+				cooked.indices.insert(cooked.indices.end(), tri.vi, (tri.vi + 3));
+
+			int mtl_index = dc.mtl_index > -1 ? dc.mtl_index : -1;
+			cooked.ranges.push_back({ (uint32_t)i_ofs, (uint32_t)(dc.tris.size() * 3), mtl_index, lod, lod_error });
+		}
+	};
+
+	append_ranges(mesh.drawcalls, 0, 0.0f);
+
+#ifdef MESH_LOD_CHAIN
+	// simplified LODs follow the full mesh in the index array, sharing its vertices
+	std::vector<mesh_lod_t> lods;
+	build_lod_chain(mesh, lods);
+	for (size_t i = 0; i < lods.size(); i++)
+		append_ranges(lods[i].drawcalls, (int)i + 1, lods[i].error);
+#endif
+	report(0.95f);
+
+	cooked.sources = mesh.mtllibs;
+	cooked.sources.insert(cooked.sources.begin(), objfile);
+	cooked.vertices.swap(mesh.vertices);
+	cooked.materials.swap(mesh.materials);
+}
+
+bool save_cooked_mesh(const std::string& cachefile, const cooked_mesh_t& cooked)
+{
+	return mesh_cache_t::save(cachefile, cooked.sources, cooked.vertices, cooked.indices, cooked.ranges, cooked.materials);
+}
+
+void model_data_t::release()
+{
+	cache.close();
+	cooked = cooked_mesh_t();
+	vertices = nullptr;
+	indices = nullptr;
+	ranges = nullptr;
+	materials = nullptr;
+	nbr_vertices = nbr_indices = nbr_ranges = 0;
+}
+
+void load_model_data(const std::string& objfile,
+					 model_data_t& data,
+					 unsigned nbr_threads,
+					 const cook_progress_t& progress)
+{
+	data.release();
+
+	std::string cachefile = mesh_cache_t::cache_path(objfile);
+	if (data.cache.load(cachefile))
+	{
+		data.vertices = data.cache.vertices;
+		data.indices = data.cache.indices;
+		data.ranges = data.cache.ranges;
+		data.materials = &data.cache.materials;
+		data.nbr_vertices = data.cache.nbr_vertices;
+		data.nbr_indices = data.cache.nbr_indices;
+		data.nbr_ranges = data.cache.nbr_ranges;
+	}
+	else
+	{
+		// load the OBJ and run the import pipeline, then write a cache for the next run
+		cook_mesh(objfile, data.cooked, nbr_threads, progress);
+		if (!save_cooked_mesh(cachefile, data.cooked))
+			printf("failed to write mesh cache %s\n", cachefile.c_str());
+
+		data.vertices = data.cooked.vertices.data();
+		data.indices = data.cooked.indices.data();
+		data.ranges = data.cooked.ranges.data();
+		data.materials = &data.cooked.materials;
+		data.nbr_vertices = data.cooked.vertices.size();
+		data.nbr_indices = data.cooked.indices.size();
+		data.nbr_ranges = data.cooked.ranges.size();
+	}
+
+	if (progress)
+		progress(1.0f);
+}
@@ -0,0 +1,78 @@
+//
+//  meshcook.h
+//
+//  The OBJ import pipeline shared by the renderer and the offline cooker: parse & weld, optimize,
+//  tangent frames and the LOD chain, producing exactly what a mesh cache holds. Headless and
+//  platform-independent, so assets can be cooked ahead of time and the renderer only maps the result.
+//
+
+#pragma once
+#ifndef MESHCOOK_H
+#define MESHCOOK_H
+
+#include <vector>
+#include <string>
+#include <functional>
+
+#include "mesh.h"
+#include "meshcache.h"
+
+//
+// a model ready for upload (or for writing as a mesh cache)
+//
+struct cooked_mesh_t
+{
+	std::vector<std::string> sources;			// the obj and its mtl files
+	std::vector<vertex_t> vertices;
+	std::vector<unsigned> indices;
+	std::vector<mesh_cache_range_t> ranges;		// LOD 0 first, then the simplified LODs
+	std::vector<material_t> materials;
+};
+
+// called with the fraction of the pipeline done (0 - 1) as stages finish
+typedef std::function<void(float)> cook_progress_t;
+
+//
+// Load an OBJ and run the full import pipeline on it. Throws like mesh_t::load_obj if the obj or
+// its materials cannot be read. nbr_threads is passed on to the parser and the tangent pass
+// (0 = one per hardware thread).
+//
+void cook_mesh(const std::string& objfile,
+			   cooked_mesh_t& cooked,
+			   unsigned nbr_threads = 0,
+			   const cook_progress_t& progress = nullptr);
+
+//
+// Write a cooked mesh as the cache file the renderer loads
+//
+bool save_cooked_mesh(const std::string& cachefile, const cooked_mesh_t& cooked);
+
+//
+// Model data ready for upload: views into the mapped cache if that is up to date, otherwise into
+// a freshly cooked mesh (which is then written as the cache for the next run)
+//
+struct model_data_t
+{
+	mesh_cache_t cache;
+	cooked_mesh_t cooked;
+
+	const vertex_t* vertices = nullptr;
+	const unsigned* indices = nullptr;
+	const mesh_cache_range_t* ranges = nullptr;
+	const std::vector<material_t>* materials = nullptr;
+	size_t nbr_vertices = 0, nbr_indices = 0, nbr_ranges = 0;
+
+	// unmap the cache / free the cooked mesh once the data is on the device
+	void release();
+};
+
+//
+// Fill model data from the cache of an OBJ or by cooking it. Throws like cook_mesh. Safe to call
+// from worker threads, except for the same objfile from two threads at once.
+//
+void load_model_data(const std::string& objfile,
+					 model_data_t& data,
+					 unsigned nbr_threads = 0,
+					 const cook_progress_t& progress = nullptr);
+
+#endif
@@ -0,0 +1,185 @@
+//
+//  meshlet.cpp
+//
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include "meshlet.h"
+
+//
+// bounds & normal cone of the triangles indices[start, end)
+//
+static void compute_meshlet_bounds(meshlet_t& m, const unsigned* indices, const vertex_t* vertices)
+{
+    // sphere around the box center, radius to the farthest vertex
+    vec3f lo = vertices[indices[m.start]].Pos, hi = lo;
+    for (unsigned i = m.start; i < m.start + m.size; i++)
+    {
+        const vec3f& p = vertices[indices[i]].Pos;
+        lo = vec3f(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+        hi = vec3f(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+    }
+    m.center = (lo + hi) * 0.5f;
+
+    float r2 = 0;
+    for (unsigned i = m.start; i < m.start + m.size; i++)
+        r2 = std::max(r2, (vertices[indices[i]].Pos - m.center).norm2squared());
+    m.radius = sqrtf(r2);
+
+    // normal cone: axis along the mean face normal, width from the face normal furthest from it
+    vec3f axis(0, 0, 0);
+    std::vector<vec3f> normals;
+    normals.reserve(m.size / 3);
+    for (unsigned i = m.start; i < m.start + m.size; i += 3)
+    {
+        const vec3f &p0 = vertices[indices[i]].Pos, &p1 = vertices[indices[i+1]].Pos, &p2 = vertices[indices[i+2]].Pos;
+        vec3f n = linalg::normalize((p1-p0)%(p2-p0));
+        if (n.norm2squared() == 0)
+            continue;
+        normals.push_back(n);
+        axis += n;
+    }
+    m.cone_axis = linalg::normalize(axis);
+
+    float min_dot = 1;
+    for (auto& n : normals)
+        min_dot = std::min(min_dot, linalg::dot(n, m.cone_axis));
+
+    // half-angles of 90 degrees and beyond (or no usable normals) cannot cull anything
+    if (min_dot <= 0 || m.cone_axis.norm2squared() == 0)
+        m.cone_cutoff = 2;
+    else
+        m.cone_cutoff = sqrtf(1 - min_dot*min_dot);
+}
+
+void build_meshlets(const unsigned* indices,
+                    size_t start,
+                    size_t size,
+                    const vertex_t* vertices,
+                    std::vector<meshlet_t>& meshlets,
+                    unsigned max_vertices,
+                    unsigned max_triangles)
+{
+    std::vector<unsigned> meshlet_vertices;
+    meshlet_vertices.reserve(max_vertices);
+
+    meshlet_t m;
+    m.start = (unsigned)start;
+    m.size = 0;
+
+    auto emit = [&]()
+    {
+        if (!m.size)
+            return;
+        m.nbr_vertices = (unsigned)meshlet_vertices.size();
+        compute_meshlet_bounds(m, indices, vertices);
+        meshlets.push_back(m);
+
+        m.start += m.size;
+        m.size = 0;
+        meshlet_vertices.clear();
+    };
+
+    for (size_t i = start; i + 2 < start + size; i += 3)
+    {
+        // vertices of this triangle not yet in the meshlet (the meshlet holds at most max_vertices, so a scan is cheap)
+        unsigned new_vertices[3], nbr_new = 0;
+        for (int j = 0; j < 3; j++)
+        {
+            unsigned v = indices[i+j];
+            if (std::find(meshlet_vertices.begin(), meshlet_vertices.end(), v) == meshlet_vertices.end() &&
+                std::find(new_vertices, new_vertices + nbr_new, v) == new_vertices + nbr_new)
+                new_vertices[nbr_new++] = v;
+        }
+
+        if (meshlet_vertices.size() + nbr_new > max_vertices || m.size/3 + 1 > max_triangles)
+        {
+            emit();
+            // all of the triangle's vertices are new to the next meshlet
+            nbr_new = 0;
+            for (int j = 0; j < 3; j++)
+                if (std::find(new_vertices, new_vertices + nbr_new, indices[i+j]) == new_vertices + nbr_new)
+                    new_vertices[nbr_new++] = indices[i+j];
+        }
+
+        meshlet_vertices.insert(meshlet_vertices.end(), new_vertices, new_vertices + nbr_new);
+        m.size += 3;
+    }
+    emit();
+}
+
+//
+// Gribb-Hartmann plane extraction, planes normalized so distances are in model units
+//
+frustum_t frustum_t::from_matrix(const mat4f& M)
+{
+    vec4f row[4] = {
+        vec4f(M.m11, M.m12, M.m13, M.m14),
+        vec4f(M.m21, M.m22, M.m23, M.m24),
+        vec4f(M.m31, M.m32, M.m33, M.m34),
+        vec4f(M.m41, M.m42, M.m43, M.m44) };
+
+    frustum_t f;
+    f.planes[0] = row[3] + row[0];      // left
+    f.planes[1] = row[3] - row[0];      // right
+    f.planes[2] = row[3] + row[1];      // bottom
+    f.planes[3] = row[3] - row[1];      // top
+    f.planes[4] = row[3] + row[2];      // near (GL clip space, contains the D3D one)
+    f.planes[5] = row[3] - row[2];      // far
+
+    for (auto& p : f.planes)
+    {
+        float l = sqrtf(p.x*p.x + p.y*p.y + p.z*p.z);
+        if (l > 0)
+            p = p * (1 / l);
+    }
+    return f;
+}
+
+bool frustum_t::intersects_sphere(const vec3f& center, float radius) const
+{
+    for (auto& p : planes)
+        if (p.x*center.x + p.y*center.y + p.z*center.z + p.w < -radius)
+            return false;
+    return true;
+}
+
+//
+// A face with normal n is back-facing if dot(n, p - camera) >= 0 for its points p. For normals
+// within the cone this holds when the view vector is within 90 degrees - half-angle of the axis,
+// i.e. dot(v, axis) >= cone_cutoff |v|. Taken conservatively over the bounding sphere:
+// dot(c - camera, axis) >= cone_cutoff |c - camera| + radius (1 + cone_cutoff).
+//
+bool meshlet_backfacing(const meshlet_t& m, const vec3f& camera_pos)
+{
+    if (m.cone_cutoff > 1)
+        return false;
+
+    vec3f v = m.center - camera_pos;
+    return linalg::dot(v, m.cone_axis) >= m.cone_cutoff * v.norm2() + m.radius * (1 + m.cone_cutoff);
+}
+
+void print_meshlet_stats(const std::vector<meshlet_t>& meshlets, unsigned max_vertices, unsigned max_triangles)
+{
+    if (meshlets.empty())
+        return;
+
+    size_t vertices = 0, triangles = 0, cones = 0;
+    unsigned max_v = 0, max_t = 0;
+    for (auto& m : meshlets)
+    {
+        vertices += m.nbr_vertices;
+        triangles += m.size / 3;
+        max_v = std::max(max_v, m.nbr_vertices);
+        max_t = std::max(max_t, m.size / 3);
+        if (m.cone_cutoff <= 1) cones++;
+    }
+
+    float n = (float)meshlets.size();
+    printf("meshlets: %d, avg %.1f vertices (max %u/%u, fill %.0f%%), avg %.1f triangles (max %u/%u, fill %.0f%%), usable normal cones %.0f%%\n",
+           (int)meshlets.size(),
+           vertices / n, max_v, max_vertices, 100 * vertices / (n * max_vertices),
+           triangles / n, max_t, max_triangles, 100 * triangles / (n * max_triangles),
+           100 * cones / n);
+}
@@ -0,0 +1,73 @@
+//
+//  meshlet.h
+//
+//  Meshlets: small clusters of consecutive triangles within a drawcall, each with a bounding
+//  sphere and a normal cone, so geometry can be culled on the CPU below drawcall granularity.
+//
+
+#pragma once
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <vector>
+#include "vec/vec.h"
+#include "vec/mat.h"
+#include "drawcall.h"
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+using linalg::vec3f;
+using linalg::vec4f;
+using linalg::mat4f;
+
+struct meshlet_t
+{
+    unsigned start, size;       // range within the index array, in indices
+    unsigned nbr_vertices;      // distinct vertices referenced
+
+    vec3f center;               // bounding sphere
+    float radius;
+
+    vec3f cone_axis;            // all face normals are within asin(cone_cutoff) of 90 degrees off the axis
+    float cone_cutoff;          // sine of the normal cone half-angle, > 1 if the cone cannot be used for culling
+};
+
+//
+// Split the triangle list indices[start, start+size) into meshlets of at most max_vertices
+// vertices and max_triangles triangles, keeping triangle order (so vertex cache order is kept).
+// Meshlets are appended to the output.
+//
+void build_meshlets(const unsigned* indices,
+                    size_t start,
+                    size_t size,
+                    const vertex_t* vertices,
+                    std::vector<meshlet_t>& meshlets,
+                    unsigned max_vertices = MESHLET_MAX_VERTICES,
+                    unsigned max_triangles = MESHLET_MAX_TRIANGLES);
+
+//
+// view frustum as six inward-facing planes (n.p + d >= 0 inside), from a clip-from-model matrix
+//
+struct frustum_t
+{
+    vec4f planes[6];
+
+    static frustum_t from_matrix(const mat4f& M);
+
+    bool intersects_sphere(const vec3f& center, float radius) const;
+};
+
+//
+// True if every triangle of the meshlet faces away from a camera at camera_pos (model space)
+//
+bool meshlet_backfacing(const meshlet_t& meshlet, const vec3f& camera_pos);
+
+//
+// Print meshlet count, vertex & triangle fill and how many normal cones are usable
+//
+void print_meshlet_stats(const std::vector<meshlet_t>& meshlets,
+                         unsigned max_vertices = MESHLET_MAX_VERTICES,
+                         unsigned max_triangles = MESHLET_MAX_TRIANGLES);
+
+#endif
@@ -0,0 +1,496 @@
+//
+//  meshopt.cpp
+//
+
+#include <cstdio>
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include "meshopt.h"
+
+vertex_cache_stats_t compute_vertex_cache_stats(const unsigned* indices,
+                                                size_t nbr_indices,
+                                                size_t nbr_vertices,
+                                                unsigned cache_size)
+{
+    vertex_cache_stats_t stats;
+    if (nbr_indices < 3)
+        return stats;
+
+    // a vertex is in the FIFO if fewer than cache_size vertices were transformed after it
+    std::vector<unsigned> cache_time(nbr_vertices, 0);
+    std::vector<char> referenced(nbr_vertices, 0);
+    unsigned time = cache_size + 1;
+    size_t misses = 0, nbr_referenced = 0;
+
+    for (size_t i = 0; i < nbr_indices; i++)
+    {
+        unsigned v = indices[i];
+        if (!referenced[v])
+        {
+            referenced[v] = 1;
+            nbr_referenced++;
+        }
+        if (time - cache_time[v] > cache_size)
+        {
+            cache_time[v] = time++;
+            misses++;
+        }
+    }
+
+    stats.acmr = (float)misses / (nbr_indices / 3);
+    stats.atvr = (float)misses / nbr_referenced;
+    return stats;
+}
+
+//
+// Tipsify: fan around a vertex, emitting all its remaining triangles, then move on to the
+// neighbouring vertex that is still in the cache and has few triangles left (so it can be
+// completed before it is evicted). At dead ends, fall back to recently used vertices and
+// finally to the next vertex in input order.
+//
+void optimize_vertex_cache(unsigned* indices,
+                           size_t nbr_indices,
+                           size_t nbr_vertices,
+                           unsigned cache_size)
+{
+    const size_t nbr_tris = nbr_indices / 3;
+    const unsigned none = ~0u;
+    if (nbr_tris < 2)
+        return;
+
+    // triangles left to emit per vertex
+    std::vector<unsigned> live(nbr_vertices, 0);
+    for (size_t i = 0; i < nbr_tris*3; i++)
+        live[indices[i]]++;
+
+    // vertex -> triangle adjacency, compressed rows
+    std::vector<unsigned> adj_ofs(nbr_vertices+1, 0);
+    for (size_t v = 0; v < nbr_vertices; v++)
+        adj_ofs[v+1] = adj_ofs[v] + live[v];
+
+    std::vector<unsigned> adj(nbr_tris*3);
+    {
+        std::vector<unsigned> fill(adj_ofs.begin(), adj_ofs.end()-1);
+        for (size_t t = 0; t < nbr_tris; t++)
+            for (int j = 0; j < 3; j++)
+                adj[fill[indices[3*t+j]]++] = (unsigned)t;
+    }
+
+    std::vector<unsigned> cache_time(nbr_vertices, 0);
+    std::vector<char> emitted(nbr_tris, 0);
+    std::vector<unsigned> dead_end, candidates, result;
+    result.reserve(nbr_tris*3);
+
+    unsigned time = cache_size + 1;
+    size_t cursor = 0;
+
+    while (cursor < nbr_vertices && !live[cursor]) cursor++;
+    unsigned fan = cursor < nbr_vertices ? (unsigned)cursor : none;
+
+    while (fan != none)
+    {
+        // emit the remaining triangles around the fanning vertex
+        candidates.clear();
+        for (unsigned k = adj_ofs[fan]; k < adj_ofs[fan+1]; k++)
+        {
+            unsigned t = adj[k];
+            if (emitted[t])
+                continue;
+
+            for (int j = 0; j < 3; j++)
+            {
+                unsigned v = indices[3*t+j];
+                result.push_back(v);
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cache_time[v] > cache_size)
+                    cache_time[v] = time++;
+            }
+            emitted[t] = 1;
+        }
+
+        // next fanning vertex: the oldest candidate still in the cache after its remaining triangles
+        fan = none;
+        int best_priority = -1;
+        for (unsigned v : candidates)
+        {
+            if (!live[v])
+                continue;
+
+            int priority = 0;
+            if (time - cache_time[v] + 2*live[v] <= cache_size)
+                priority = (int)(time - cache_time[v]);
+            if (priority > best_priority)
+            {
+                best_priority = priority;
+                fan = v;
+            }
+        }
+
+        // dead end: recently used vertices first, then input order
+        while (fan == none && !dead_end.empty())
+        {
+            unsigned v = dead_end.back();
+            dead_end.pop_back();
+            if (live[v])
+                fan = v;
+        }
+        while (fan == none && cursor < nbr_vertices)
+        {
+            if (live[cursor])
+                fan = (unsigned)cursor;
+            else
+                cursor++;
+        }
+    }
+
+    std::copy(result.begin(), result.end(), indices);
+}
+
+//
+// cluster of consecutive triangles [start, end) and its sort key
+//
+struct overdraw_cluster_t
+{
+    size_t start, end;
+    size_t misses;      // from a cold cache
+    float sort_key;
+};
+
+void optimize_overdraw(unsigned* indices,
+                       size_t nbr_indices,
+                       const std::vector<vertex_t>& vertices,
+                       float threshold,
+                       unsigned cache_size)
+{
+    const size_t nbr_tris = nbr_indices / 3;
+    if (nbr_tris < 2)
+        return;
+
+    std::vector<unsigned> cache_time(vertices.size(), 0);
+    unsigned time = cache_size + 1;
+
+    // cache misses of a triangle, updating the simulated FIFO
+    auto tri_misses = [&](size_t t) -> unsigned
+    {
+        unsigned misses = 0;
+        for (int j = 0; j < 3; j++)
+        {
+            unsigned v = indices[3*t+j];
+            if (time - cache_time[v] > cache_size)
+            {
+                cache_time[v] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    };
+
+    // hard boundaries: triangles that miss on all vertices, the cache effectively restarts there.
+    // misses[t]: misses of the first t triangles in the input order.
+    std::vector<size_t> hard, misses(nbr_tris+1, 0);
+    for (size_t t = 0; t < nbr_tris; t++)
+    {
+        unsigned m = tri_misses(t);
+        misses[t+1] = misses[t] + m;
+        if (m == 3)
+            hard.push_back(t);
+    }
+    hard.push_back(nbr_tris);
+
+    // cache misses of the triangles [start, end) from a cold cache
+    auto cold_misses = [&](size_t start, size_t end) -> size_t
+    {
+        time += cache_size + 1;
+        size_t m = 0;
+        for (size_t t = start; t < end; t++)
+            m += tri_misses(t);
+        return m;
+    };
+
+    // soft boundaries: cut a hard cluster as soon as the misses of all clusters so far, each from
+    // a cold cache, are within threshold times those of the same triangles in the input order, so
+    // the ACMR of the whole list stays within threshold. The part after the last cut of a hard
+    // cluster can tip the total over, then its cuts are undone from the back.
+    std::vector<overdraw_cluster_t> clusters;
+    size_t spent = 0;
+    for (size_t h = 0; h+1 < hard.size(); h++)
+    {
+        size_t start = hard[h], end = hard[h+1], first = clusters.size();
+
+        size_t cluster_start = start, cluster_misses = 0;
+        time += cache_size + 1;
+        for (size_t t = start; t < end; t++)
+        {
+            cluster_misses += tri_misses(t);
+            if (t+1 < end && spent + cluster_misses <= threshold * misses[t+1])
+            {
+                clusters.push_back({ cluster_start, t+1, cluster_misses, 0 });
+                cluster_start = t+1;
+                spent += cluster_misses;
+                cluster_misses = 0;
+                time += cache_size + 1;
+            }
+        }
+        clusters.push_back({ cluster_start, end, cluster_misses, 0 });
+        spent += cluster_misses;
+
+        while (clusters.size() - first > 1 && spent > threshold * misses[end])
+        {
+            overdraw_cluster_t last = clusters.back();
+            clusters.pop_back();
+            overdraw_cluster_t& merged = clusters.back();
+            spent -= merged.misses + last.misses;
+            merged.end = last.end;
+            merged.misses = cold_misses(merged.start, merged.end);
+            spent += merged.misses;
+        }
+    }
+
+    // area-weighted centroids & normals
+    vec3f centroid(0, 0, 0);
+    float area = 0;
+    std::vector<vec3f> cluster_centroids(clusters.size()), cluster_normals(clusters.size());
+
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        vec3f cc(0, 0, 0), cn(0, 0, 0);
+        float ca = 0;
+        for (size_t t = clusters[c].start; t < clusters[c].end; t++)
+        {
+            const vec3f &p0 = vertices[indices[3*t]].Pos, &p1 = vertices[indices[3*t+1]].Pos, &p2 = vertices[indices[3*t+2]].Pos;
+            vec3f n = (p1-p0)%(p2-p0);
+            float a = n.norm2();
+            cc += (p0+p1+p2) * (a / 3);
+            cn += n;
+            ca += a;
+        }
+        centroid += cc;
+        area += ca;
+        cluster_centroids[c] = ca > 0 ? cc * (1 / ca) : vertices[indices[3*clusters[c].start]].Pos;
+        cluster_normals[c] = linalg::normalize(cn);
+    }
+    if (area > 0)
+        centroid = centroid * (1 / area);
+
+    for (size_t c = 0; c < clusters.size(); c++)
+        clusters[c].sort_key = linalg::dot(cluster_centroids[c] - centroid, cluster_normals[c]);
+
+    // outward-facing clusters first
+    std::stable_sort(clusters.begin(), clusters.end(),
+                     [](const overdraw_cluster_t& a, const overdraw_cluster_t& b) { return a.sort_key > b.sort_key; });
+
+    std::vector<unsigned> result;
+    result.reserve(nbr_tris*3);
+    for (auto& cluster : clusters)
+        result.insert(result.end(), indices + 3*cluster.start, indices + 3*cluster.end);
+
+    // a hard cluster that is not cut may still exceed the threshold from a cold cache, as may the
+    // FIFO in the new order: keep the cache order if the reordered list exceeds it
+    vertex_cache_stats_t stats = compute_vertex_cache_stats(result.data(), result.size(), vertices.size(), cache_size);
+    if (stats.acmr > threshold * misses[nbr_tris] / nbr_tris)
+        return;
+    std::copy(result.begin(), result.end(), indices);
+}
+
+float estimate_overdraw(const unsigned* indices,
+                        size_t nbr_indices,
+                        const std::vector<vertex_t>& vertices,
+                        unsigned resolution)
+{
+    const size_t nbr_tris = nbr_indices / 3;
+    if (!nbr_tris)
+        return 0;
+
+    // bounds of the referenced vertices
+    vec3f lo = vertices[indices[0]].Pos, hi = lo;
+    for (size_t i = 0; i < nbr_indices; i++)
+    {
+        const vec3f& p = vertices[indices[i]].Pos;
+        lo = vec3f(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+        hi = vec3f(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+    }
+    vec3f center = (lo + hi) * 0.5f;
+    float radius = std::max((hi - lo).norm2() * 0.5f, 1e-6f);
+
+    static const float d = 0.57735027f;
+    const vec3f view_dirs[] = {
+        vec3f(1,0,0), vec3f(-1,0,0), vec3f(0,1,0), vec3f(0,-1,0), vec3f(0,0,1), vec3f(0,0,-1),
+        vec3f(d,d,d), vec3f(d,d,-d), vec3f(d,-d,d), vec3f(d,-d,-d),
+        vec3f(-d,d,d), vec3f(-d,d,-d), vec3f(-d,-d,d), vec3f(-d,-d,-d) };
+
+    std::vector<float> depth(resolution * resolution);
+    std::vector<vec3f> projected(vertices.size());
+    double overdraw_sum = 0;
+
+    for (const vec3f& dir : view_dirs)
+    {
+        // view basis, looking along dir; the bounding sphere maps to the viewport
+        vec3f up = fabsf(dir.y) < 0.9f ? vec3f(0,1,0) : vec3f(1,0,0);
+        vec3f right = linalg::normalize(dir % up);
+        up = right % dir;
+
+        float scale = resolution / (2 * radius);
+        for (size_t i = 0; i < nbr_indices; i++)
+        {
+            unsigned v = indices[i];
+            vec3f p = vertices[v].Pos - center;
+            projected[v] = vec3f((linalg::dot(p, right) + radius) * scale,
+                                 (linalg::dot(p, up) + radius) * scale,
+                                 linalg::dot(p, dir));
+        }
+
+        std::fill(depth.begin(), depth.end(), FLT_MAX);
+        size_t fragments = 0;
+
+        for (size_t t = 0; t < nbr_tris; t++)
+        {
+            vec3f a = projected[indices[3*t]], b = projected[indices[3*t+1]], c = projected[indices[3*t+2]];
+
+            // back-face & degenerate culling, counter-clockwise is front-facing
+            float area2 = (b.x-a.x)*(c.y-a.y) - (b.y-a.y)*(c.x-a.x);
+            if (area2 <= 0)
+                continue;
+            float inv_area2 = 1 / area2;
+
+            int x0 = std::max(0, (int)floorf(std::min(a.x, std::min(b.x, c.x))));
+            int x1 = std::min((int)resolution-1, (int)ceilf(std::max(a.x, std::max(b.x, c.x))));
+            int y0 = std::max(0, (int)floorf(std::min(a.y, std::min(b.y, c.y))));
+            int y1 = std::min((int)resolution-1, (int)ceilf(std::max(a.y, std::max(b.y, c.y))));
+
+            for (int y = y0; y <= y1; y++)
+                for (int x = x0; x <= x1; x++)
+                {
+                    // barycentrics at the pixel center
+                    float px = x + 0.5f, py = y + 0.5f;
+                    float w0 = (c.x-b.x)*(py-b.y) - (c.y-b.y)*(px-b.x);
+                    float w1 = (a.x-c.x)*(py-c.y) - (a.y-c.y)*(px-c.x);
+                    float w2 = (b.x-a.x)*(py-a.y) - (b.y-a.y)*(px-a.x);
+                    if (w0 < 0 || w1 < 0 || w2 < 0)
+                        continue;
+
+                    float z = (w0*a.z + w1*b.z + w2*c.z) * inv_area2;
+                    float& dz = depth[y*resolution + x];
+                    if (z < dz)
+                    {
+                        dz = z;
+                        fragments++;
+                    }
+                }
+        }
+
+        size_t covered = 0;
+        for (float z : depth)
+            if (z != FLT_MAX) covered++;
+        overdraw_sum += covered ? (double)fragments / covered : 1.0;
+    }
+
+    return (float)(overdraw_sum / (sizeof(view_dirs) / sizeof(view_dirs[0])));
+}
+
+void optimize_vertex_fetch(std::vector<vertex_t>& vertices, std::vector<drawcall_t>& drawcalls)
+{
+    const unsigned unused = ~0u;
+    std::vector<unsigned> remap(vertices.size(), unused);
+    unsigned next = 0;
+
+    auto map = [&](unsigned& vi)
+    {
+        if (remap[vi] == unused)
+            remap[vi] = next++;
+        vi = remap[vi];
+    };
+
+    for (auto& dc : drawcalls)
+    {
+        for (auto& tri : dc.tris)
+            for (int i = 0; i < 3; i++) map(tri.vi[i]);
+        for (auto& quad : dc.quads)
+            for (int i = 0; i < 4; i++) map(quad.vi[i]);
+    }
+
+    // unreferenced vertices go last
+    for (auto& r : remap)
+        if (r == unused) r = next++;
+
+    std::vector<vertex_t> reordered(vertices.size());
+    for (size_t v = 0; v < vertices.size(); v++)
+        reordered[remap[v]] = vertices[v];
+    vertices.swap(reordered);
+}
+
+// triangle indices of all drawcalls, in drawcall order
+static std::vector<unsigned> flatten_triangles(const std::vector<drawcall_t>& drawcalls)
+{
+    std::vector<unsigned> indices;
+    for (auto& dc : drawcalls)
+        for (auto& tri : dc.tris)
+            indices.insert(indices.end(), tri.vi, tri.vi + 3);
+    return indices;
+}
+
+void optimize_triangle_order(const std::vector<vertex_t>& vertices, std::vector<drawcall_t>& drawcalls)
+{
+    // optimize each drawcall on compact local vertex ids, so the work per drawcall
+    // is proportional to its own size rather than to the whole vertex array
+    const unsigned unused = ~0u;
+    std::vector<unsigned> local_id(vertices.size(), unused), global_id, indices;
+#ifdef MESH_OPTIMIZE_OVERDRAW
+    std::vector<vertex_t> local_vertices;
+#endif
+
+    for (auto& dc : drawcalls)
+    {
+        indices.clear();
+        global_id.clear();
+        for (auto& tri : dc.tris)
+            for (int i = 0; i < 3; i++)
+            {
+                unsigned v = tri.vi[i];
+                if (local_id[v] == unused)
+                {
+                    local_id[v] = (unsigned)global_id.size();
+                    global_id.push_back(v);
+                }
+                indices.push_back(local_id[v]);
+            }
+
+        optimize_vertex_cache(indices.data(), indices.size(), global_id.size());
+
+#ifdef MESH_OPTIMIZE_OVERDRAW
+        // on the drawcall's own vertices too, so its cache simulation is sized by them
+        local_vertices.resize(global_id.size());
+        for (size_t v = 0; v < global_id.size(); v++)
+            local_vertices[v] = vertices[global_id[v]];
+        optimize_overdraw(indices.data(), indices.size(), local_vertices);
+#endif
+
+        for (size_t t = 0; t < dc.tris.size(); t++)
+            for (int i = 0; i < 3; i++)
+                dc.tris[t].vi[i] = global_id[indices[3*t+i]];
+
+        for (unsigned v : global_id)
+            local_id[v] = unused;
+    }
+}
+
+void optimize_mesh(mesh_t& mesh)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<unsigned> all_indices = flatten_triangles(mesh.drawcalls);
+    vertex_cache_stats_t before = compute_vertex_cache_stats(all_indices.data(), all_indices.size(), mesh.vertices.size());
+
+    optimize_triangle_order(mesh.vertices, mesh.drawcalls);
+    optimize_vertex_fetch(mesh.vertices, mesh.drawcalls);
+
+    all_indices = flatten_triangles(mesh.drawcalls);
+    vertex_cache_stats_t after = compute_vertex_cache_stats(all_indices.data(), all_indices.size(), mesh.vertices.size());
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    printf("vertex cache (FIFO %d): ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (%.1f ms)\n",
+           MESH_VERTEX_CACHE_SIZE, before.acmr, after.acmr, before.atvr, after.atvr, ms);
+}
@@ -0,0 +1,93 @@
+//
+//  meshopt.h
+//
+//  Mesh optimization stages run on welded meshes before upload: triangle order for the
+//  post-transform vertex cache, vertex order for fetch locality, and the statistics to
+//  measure them without a GPU.
+//
+
+#pragma once
+#ifndef MESHOPT_H
+#define MESHOPT_H
+
+#include <vector>
+#include "mesh.h"
+
+#define MESH_OPTIMIZE_VERTEX_CACHE      // reorder triangles & vertices in OBJModel_t (otherwise file order)
+#define MESH_VERTEX_CACHE_SIZE 16       // FIFO size targeted by the optimizer and used by the statistics
+#define MESH_OPTIMIZE_OVERDRAW          // sort triangle clusters front-to-back after the cache pass
+#define MESH_OVERDRAW_THRESHOLD 1.05f   // ACMR growth allowed in exchange for less overdraw
+
+//
+// post-transform cache statistics for a triangle list
+//
+// acmr: average cache miss ratio, transformed vertices per triangle (0.5 - 3, lower is better)
+// atvr: average transform to vertex ratio, transformed vertices per referenced vertex (1 is optimal)
+//
+struct vertex_cache_stats_t
+{
+    float acmr = 0, atvr = 0;
+};
+
+//
+// Simulate a FIFO post-transform cache over a triangle list
+//
+vertex_cache_stats_t compute_vertex_cache_stats(const unsigned* indices,
+                                                size_t nbr_indices,
+                                                size_t nbr_vertices,
+                                                unsigned cache_size = MESH_VERTEX_CACHE_SIZE);
+
+//
+// Reorder the triangles of a triangle list for vertex cache locality (Tipsify, Sander et al. 2007)
+//
+void optimize_vertex_cache(unsigned* indices,
+                           size_t nbr_indices,
+                           size_t nbr_vertices,
+                           unsigned cache_size = MESH_VERTEX_CACHE_SIZE);
+
+//
+// Reorder a cache-optimized triangle list for less overdraw (Sander et al. 2007)
+//
+// The list is cut into clusters wherever the vertex cache restarts (hard boundaries), and further
+// wherever the clusters so far, each simulated from a cold cache, stay within threshold times the
+// misses of the input order (soft boundaries), so the ACMR of the whole list grows by at most
+// threshold. Clusters are then sorted by how far out they face from the centroid of the list,
+// dot(cluster centroid - centroid, cluster normal), so outer surfaces tend to be drawn before what
+// they occlude from any view. Triangle order within a cluster is kept. If the sorted list still
+// exceeds the threshold, the input order is kept.
+//
+void optimize_overdraw(unsigned* indices,
+                       size_t nbr_indices,
+                       const std::vector<vertex_t>& vertices,
+                       float threshold = MESH_OVERDRAW_THRESHOLD,
+                       unsigned cache_size = MESH_VERTEX_CACHE_SIZE);
+
+//
+// Estimate overdraw of a triangle list by rasterizing depth only, with back-face culling and
+// early depth test, from orthographic views along the 3 axes (both ways) and the 8 diagonals.
+// Returns fragments passing the depth test per covered pixel, averaged over the views
+// (1 is optimal). Intended for measuring, too slow for the load path on large meshes.
+//
+float estimate_overdraw(const unsigned* indices,
+                        size_t nbr_indices,
+                        const std::vector<vertex_t>& vertices,
+                        unsigned resolution = 256);
+
+//
+// Reorder vertices by first use, in drawcall order, and remap all faces
+//
+void optimize_vertex_fetch(std::vector<vertex_t>& vertices, std::vector<drawcall_t>& drawcalls);
+
+//
+// Run the cache and overdraw (if MESH_OPTIMIZE_OVERDRAW) optimizations on the triangles of each
+// drawcall. Vertices are not reordered.
+//
+void optimize_triangle_order(const std::vector<vertex_t>& vertices, std::vector<drawcall_t>& drawcalls);
+
+//
+// Run the cache, overdraw (if MESH_OPTIMIZE_OVERDRAW) and fetch optimizations on a mesh,
+// triangles are reordered within each drawcall. Prints ACMR/ATVR before and after.
+//
+void optimize_mesh(mesh_t& mesh);
+
+#endif
@@ -0,0 +1,519 @@
+//
+//  meshsimplify.cpp
+//
+
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+#include "meshsimplify.h"
+#include "meshopt.h"
+
+static const unsigned none = ~0u, multiple = ~1u;
+
+// border edges weigh this much more than faces, so outlines are kept
+static const float border_weight = 10.0f;
+
+// collapses may not turn a triangle normal by more than acos(min_normal_dot)
+static const float min_normal_dot = 0.25f;
+
+mesh_simplifier_t::mesh_simplifier_t(const mesh_t& mesh) : mesh(mesh), extent(1)
+{
+    const size_t nbr_vertices = mesh.vertices.size();
+
+    for (size_t d = 0; d < mesh.drawcalls.size(); d++)
+        for (auto& tri : mesh.drawcalls[d].tris)
+        {
+            indices.insert(indices.end(), tri.vi, tri.vi + 3);
+            tri_drawcall.push_back((int)d);
+        }
+
+    // positions relative to the bounds, so errors are relative to the mesh size
+    positions.resize(nbr_vertices);
+    if (nbr_vertices)
+    {
+        vec3f lo = mesh.vertices[0].Pos, hi = lo;
+        for (auto& v : mesh.vertices)
+        {
+            lo = vec3f(std::min(lo.x, v.Pos.x), std::min(lo.y, v.Pos.y), std::min(lo.z, v.Pos.z));
+            hi = vec3f(std::max(hi.x, v.Pos.x), std::max(hi.y, v.Pos.y), std::max(hi.z, v.Pos.z));
+        }
+        extent = std::max(hi.x - lo.x, std::max(hi.y - lo.y, hi.z - lo.z));
+        if (extent <= 0)
+            extent = 1;
+        for (size_t i = 0; i < nbr_vertices; i++)
+            positions[i] = (mesh.vertices[i].Pos - lo) * (1 / extent);
+    }
+
+    // vertices at the same position (split by uv or normal seams) form a circular wedge list
+    std::vector<unsigned> order(nbr_vertices);
+    std::iota(order.begin(), order.end(), 0);
+    auto pos_less = [&](unsigned a, unsigned b) -> bool
+    {
+        const vec3f &pa = mesh.vertices[a].Pos, &pb = mesh.vertices[b].Pos;
+        if (pa.x != pb.x) return pa.x < pb.x;
+        if (pa.y != pb.y) return pa.y < pb.y;
+        return pa.z < pb.z;
+    };
+    std::stable_sort(order.begin(), order.end(), pos_less);
+
+    remap.resize(nbr_vertices);
+    wedge.resize(nbr_vertices);
+    for (size_t i = 0; i < nbr_vertices; )
+    {
+        size_t j = i + 1;
+        while (j < nbr_vertices && !pos_less(order[i], order[j]))
+            j++;
+        for (size_t k = i; k < j; k++)
+        {
+            remap[order[k]] = order[i];
+            wedge[order[k]] = order[k + 1 < j ? k + 1 : i];
+        }
+        i = j;
+    }
+
+    std::vector<unsigned> border_edges;
+    classify_vertices(border_edges);
+    init_quadrics(border_edges);
+}
+
+void mesh_simplifier_t::classify_vertices(std::vector<unsigned>& border_edges)
+{
+    const size_t nbr_vertices = mesh.vertices.size();
+    const size_t nbr_tris = indices.size() / 3;
+
+    // outgoing half-edges per vertex
+    std::vector<unsigned> edge_ofs(nbr_vertices + 1, 0), edges(indices.size());
+    for (unsigned v : indices)
+        edge_ofs[v + 1]++;
+    for (size_t i = 0; i < nbr_vertices; i++)
+        edge_ofs[i + 1] += edge_ofs[i];
+    {
+        std::vector<unsigned> fill(edge_ofs.begin(), edge_ofs.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            edges[fill[indices[i]]++] = indices[i - i % 3 + (i + 1) % 3];
+    }
+    auto has_edge = [&](unsigned a, unsigned b) -> bool
+    {
+        const unsigned *first = edges.data() + edge_ofs[a], *last = edges.data() + edge_ofs[a + 1];
+        return std::find(first, last, b) != last;
+    };
+
+    // open edges, between vertices rather than positions, so seams are open too
+    open_in.assign(nbr_vertices, none);
+    open_out.assign(nbr_vertices, none);
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned a = indices[i], b = indices[i - i % 3 + (i + 1) % 3];
+        if (has_edge(b, a))
+            continue;
+
+        open_out[a] = (open_out[a] == none || open_out[a] == b) ? b : multiple;
+        open_in[b] = (open_in[b] == none || open_in[b] == a) ? a : multiple;
+
+        // open between positions too: a true border
+        bool reverse = false;
+        unsigned wb = b;
+        do
+        {
+            unsigned wa = a;
+            do
+            {
+                reverse = reverse || has_edge(wb, wa);
+                wa = wedge[wa];
+            } while (wa != a);
+            wb = wedge[wb];
+        } while (wb != b);
+        if (!reverse)
+            border_edges.push_back((unsigned)i);
+    }
+
+    // positions used by several drawcalls are on material boundaries
+    std::vector<int> position_drawcall(nbr_vertices, -1);
+    std::vector<char> material_boundary(nbr_vertices, 0);
+    for (size_t t = 0; t < nbr_tris; t++)
+        for (int i = 0; i < 3; i++)
+        {
+            unsigned r = remap[indices[3*t + i]];
+            if (position_drawcall[r] == -1)
+                position_drawcall[r] = tri_drawcall[t];
+            else if (position_drawcall[r] != tri_drawcall[t])
+                material_boundary[r] = 1;
+        }
+
+    auto single = [](unsigned v) { return v != none && v != multiple; };
+
+    kind.assign(nbr_vertices, KIND_LOCKED);
+    for (size_t v = 0; v < nbr_vertices; v++)
+    {
+        if (material_boundary[remap[v]])
+            continue;
+
+        if (wedge[v] == v)
+        {
+            if (open_in[v] == none && open_out[v] == none)
+                kind[v] = KIND_MANIFOLD;
+            else if (single(open_in[v]) && single(open_out[v]))
+                kind[v] = KIND_BORDER;
+        }
+        else if (wedge[wedge[v]] == v)
+        {
+            // two vertices whose open edges mirror each other between positions
+            unsigned w = wedge[v];
+            if (single(open_in[v]) && single(open_out[v]) && single(open_in[w]) && single(open_out[w]) &&
+                remap[open_out[v]] == remap[open_in[w]] && remap[open_in[v]] == remap[open_out[w]])
+                kind[v] = KIND_SEAM;
+        }
+    }
+}
+
+static void add_plane(double* q, const vec3f& n, double d, double w)
+{
+    q[0] += w * n.x * n.x; q[1] += w * n.y * n.y; q[2] += w * n.z * n.z;
+    q[3] += w * n.x * n.y; q[4] += w * n.x * n.z; q[5] += w * n.y * n.z;
+    q[6] += w * n.x * d;   q[7] += w * n.y * d;   q[8] += w * n.z * d;
+    q[9] += w * d * d;
+    q[10] += w;
+}
+
+void mesh_simplifier_t::init_quadrics(const std::vector<unsigned>& border_edges)
+{
+    static_assert(sizeof(quadric_t) == 11 * sizeof(double), "quadrics are accumulated as double arrays");
+    quadrics.assign(mesh.vertices.size(), quadric_t());
+
+    // face planes, weighted by area
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        const vec3f &p0 = positions[indices[i]], &p1 = positions[indices[i+1]], &p2 = positions[indices[i+2]];
+        vec3f n = (p1 - p0) % (p2 - p0);
+        float l = n.norm2();
+        if (l == 0)
+            continue;
+        n = n * (1 / l);
+
+        for (int j = 0; j < 3; j++)
+            add_plane(&quadrics[remap[indices[i+j]]].a2, n, -linalg::dot(n, p0), 0.5f * l);
+    }
+
+    // planes through border edges, perpendicular to their face
+    for (unsigned i : border_edges)
+    {
+        size_t t = i - i % 3;
+        const vec3f &p0 = positions[indices[i]], &p1 = positions[indices[t + (i + 1) % 3]], &p2 = positions[indices[t + (i + 2) % 3]];
+        vec3f e = p1 - p0;
+        vec3f n = e % ((p1 - p0) % (p2 - p0));
+        float l = n.norm2();
+        if (l == 0)
+            continue;
+        n = n * (1 / l);
+
+        float w = border_weight * linalg::dot(e, e);
+        add_plane(&quadrics[remap[indices[i]]].a2, n, -linalg::dot(n, p0), w);
+        add_plane(&quadrics[remap[indices[t + (i + 1) % 3]]].a2, n, -linalg::dot(n, p0), w);
+    }
+}
+
+bool mesh_simplifier_t::can_collapse(unsigned i0, unsigned i1) const
+{
+    static const bool allowed[4][4] =
+    {
+        // to: manifold, border, seam, locked
+        { true,  true,  true,  true },      // manifold
+        { false, true,  false, true },      // border
+        { false, false, true,  true },      // seam
+        { false, false, false, false },     // locked
+    };
+
+    if (!allowed[kind[i0]][kind[i1]] || remap[i0] == remap[i1])
+        return false;
+
+    // borders and seams only collapse along themselves
+    if (kind[i0] == KIND_BORDER || kind[i0] == KIND_SEAM)
+        return open_out[i0] == i1 || open_in[i0] == i1;
+
+    return true;
+}
+
+float mesh_simplifier_t::collapse_error(unsigned i0, unsigned i1) const
+{
+    const double *q0 = &quadrics[remap[i0]].a2, *q1 = &quadrics[remap[i1]].a2;
+    double q[11];
+    for (int i = 0; i < 11; i++)
+        q[i] = q0[i] + q1[i];
+
+    const vec3f& p = positions[i1];
+    double e = q[0]*p.x*p.x + q[1]*p.y*p.y + q[2]*p.z*p.z
+        + 2 * (q[3]*p.x*p.y + q[4]*p.x*p.z + q[5]*p.y*p.z)
+        + 2 * (q[6]*p.x + q[7]*p.y + q[8]*p.z)
+        + q[9];
+
+    return q[10] > 0 ? (float)(fabs(e) / q[10]) : 0;
+}
+
+float mesh_simplifier_t::simplify(size_t target_triangles, float max_error)
+{
+    const size_t nbr_vertices = mesh.vertices.size();
+    const float error_limit = max_error < FLT_MAX ? (max_error / extent) * (max_error / extent) : FLT_MAX;
+
+    struct collapse_t
+    {
+        unsigned i0, i1;
+        float error;
+    };
+    std::vector<collapse_t> collapses, sorted;
+    std::vector<unsigned> buckets(65536 + 1);
+    auto sort_key = [](float error) -> unsigned
+    {
+        unsigned bits;
+        memcpy(&bits, &error, sizeof(bits));
+        return bits >> 16;
+    };
+    std::vector<unsigned> tri_ofs(nbr_vertices + 1), tris, collapse_remap(nbr_vertices);
+    enum { POS_UNCHANGED, POS_MERGED, POS_REMOVED };
+    std::vector<char> pos_state(nbr_vertices), changed;
+
+    //
+    // Passes of independent collapses: collapses are sorted by error and applied cheapest first.
+    // Each one marks the triangles it changes for the rest of the pass, a later collapse moving any
+    // of them is left to the next pass so its flip check stays valid. More vertices may collapse
+    // onto the same position in a pass, with errors updated for its grown quadric. Triangles are
+    // rebuilt between passes.
+    //
+    while (nbr_triangles() > target_triangles)
+    {
+        // cheapest direction of every edge, interior edges are seen from both sides so take them once
+        collapses.clear();
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            unsigned a = indices[i], b = indices[i - i % 3 + (i + 1) % 3];
+            if (kind[a] == KIND_MANIFOLD && a > b)
+                continue;
+
+            bool ab = can_collapse(a, b), ba = can_collapse(b, a);
+            if (!ab && !ba)
+                continue;
+
+            float eab = ab ? collapse_error(a, b) : FLT_MAX, eba = ba ? collapse_error(b, a) : FLT_MAX;
+            collapses.push_back(eab <= eba ? collapse_t{ a, b, eab } : collapse_t{ b, a, eba });
+        }
+        if (collapses.empty())
+            break;
+
+        // counting sort on the upper bits of the (non-negative) errors, ordered to about 1%
+        std::fill(buckets.begin(), buckets.end(), 0);
+        for (auto& c : collapses)
+            buckets[sort_key(c.error) + 1]++;
+        for (size_t i = 1; i < buckets.size(); i++)
+            buckets[i] += buckets[i - 1];
+        sorted.resize(collapses.size());
+        for (auto& c : collapses)
+            sorted[buckets[sort_key(c.error)]++] = c;
+
+        // collapse up to about the error the goal needs (at least the cheapest few percent), cheaper
+        // edges that are locked this pass are left to the next one rather than collapsing costlier
+        // ones in their place
+        const size_t goal = nbr_triangles() - target_triangles;
+        const float pass_limit = 1.5f * sorted[std::min(sorted.size() - 1, std::max(goal / 2, sorted.size() / 32))].error;
+
+        // triangles around every position
+        std::fill(tri_ofs.begin(), tri_ofs.end(), 0);
+        for (unsigned v : indices)
+            tri_ofs[remap[v] + 1]++;
+        for (size_t i = 0; i < nbr_vertices; i++)
+            tri_ofs[i + 1] += tri_ofs[i];
+        tris.resize(indices.size());
+        {
+            std::vector<unsigned> fill(tri_ofs.begin(), tri_ofs.end() - 1);
+            for (size_t i = 0; i < indices.size(); i++)
+                tris[fill[remap[indices[i]]]++] = (unsigned)(i / 3);
+        }
+
+        std::iota(collapse_remap.begin(), collapse_remap.end(), 0);
+        std::fill(pos_state.begin(), pos_state.end(), POS_UNCHANGED);
+        changed.assign(nbr_triangles(), 0);
+
+        // false if the collapse flips or folds triangles around i0, or touches triangles changed in this pass
+        auto keeps_triangles = [&](unsigned i0, unsigned i1, size_t& degenerate) -> bool
+        {
+            unsigned r0 = remap[i0], r1 = remap[i1];
+            for (unsigned k = tri_ofs[r0]; k < tri_ofs[r0 + 1]; k++)
+                if (changed[tris[k]])
+                    return false;
+
+            degenerate = 0;
+            for (unsigned k = tri_ofs[r0]; k < tri_ofs[r0 + 1]; k++)
+            {
+                const unsigned* tri = &indices[3 * tris[k]];
+                vec3f p[3];
+                bool has_r1 = false;
+                int corner = 0;
+                for (int j = 0; j < 3; j++)
+                {
+                    p[j] = positions[tri[j]];
+                    has_r1 = has_r1 || remap[tri[j]] == r1;
+                    if (remap[tri[j]] == r0)
+                        corner = j;
+                }
+                if (has_r1)
+                {
+                    degenerate++;
+                    continue;
+                }
+
+                vec3f n0 = (p[1] - p[0]) % (p[2] - p[0]);
+                p[corner] = positions[i1];
+                vec3f n1 = (p[1] - p[0]) % (p[2] - p[0]);
+                if (linalg::dot(n0, n1) < min_normal_dot * n0.norm2() * n1.norm2())
+                    return false;
+            }
+            return true;
+        };
+
+        size_t removed = 0, nbr_collapsed = 0;
+
+        // collapses whose error changed (reversed, or onto a grown quadric) may not exceed the pass
+        // limit, or the error they were sorted by if that is higher (the first collapse of a pass)
+        auto usable = [&](collapse_t& c, float limit, size_t& degenerate) -> bool
+        {
+            unsigned r0 = remap[c.i0], r1 = remap[c.i1];
+            if (pos_state[r0] != POS_UNCHANGED || pos_state[r1] == POS_REMOVED)
+                return false;
+            if (pos_state[r1] == POS_MERGED)
+                c.error = collapse_error(c.i0, c.i1);
+            return c.error <= limit && keeps_triangles(c.i0, c.i1, degenerate);
+        };
+
+        for (auto c : sorted)
+        {
+            if (c.error > error_limit || (c.error > pass_limit && nbr_collapsed) || removed >= goal)
+                break;
+
+            const float limit = std::min(error_limit, std::max(pass_limit, c.error));
+            size_t degenerate;
+            if (!usable(c, limit, degenerate))
+            {
+                // the other way around may not fold (typical for flat regions)
+                if (!can_collapse(c.i1, c.i0))
+                    continue;
+                c = collapse_t{ c.i1, c.i0, collapse_error(c.i1, c.i0) };
+                if (!usable(c, limit, degenerate))
+                    continue;
+            }
+            unsigned r0 = remap[c.i0], r1 = remap[c.i1];
+
+            collapse_remap[c.i0] = c.i1;
+            if (kind[c.i0] == KIND_SEAM)
+            {
+                // the other side of the seam moves along with it
+                unsigned s0 = wedge[c.i0];
+                collapse_remap[s0] = open_out[c.i0] == c.i1 ? open_in[s0] : open_out[s0];
+            }
+
+            const double* q0 = &quadrics[r0].a2;
+            double* q1 = &quadrics[r1].a2;
+            for (int i = 0; i < 11; i++)
+                q1[i] += q0[i];
+
+            pos_state[r0] = POS_REMOVED;
+            pos_state[r1] = POS_MERGED;
+            for (unsigned k = tri_ofs[r0]; k < tri_ofs[r0 + 1]; k++)
+                changed[tris[k]] = 1;
+
+            max_collapse_error = std::max(max_collapse_error, c.error);
+            removed += degenerate;
+            nbr_collapsed++;
+        }
+        if (!nbr_collapsed)
+            break;
+
+        // apply the collapses and drop triangles that became degenerate
+        size_t kept = 0;
+        for (size_t t = 0; t < nbr_triangles(); t++)
+        {
+            unsigned a = collapse_remap[indices[3*t]], b = collapse_remap[indices[3*t+1]], c = collapse_remap[indices[3*t+2]];
+            if (remap[a] == remap[b] || remap[b] == remap[c] || remap[c] == remap[a])
+                continue;
+
+            indices[3*kept] = a;
+            indices[3*kept+1] = b;
+            indices[3*kept+2] = c;
+            tri_drawcall[kept] = tri_drawcall[t];
+            kept++;
+        }
+        indices.resize(3 * kept);
+        tri_drawcall.resize(kept);
+    }
+
+    return error();
+}
+
+float mesh_simplifier_t::error() const
+{
+    return sqrtf(max_collapse_error) * extent;
+}
+
+void mesh_simplifier_t::get_drawcalls(std::vector<drawcall_t>& drawcalls) const
+{
+    drawcalls.resize(mesh.drawcalls.size());
+    for (size_t d = 0; d < drawcalls.size(); d++)
+    {
+        drawcalls[d].group_name = mesh.drawcalls[d].group_name;
+        drawcalls[d].mtl_index = mesh.drawcalls[d].mtl_index;
+        drawcalls[d].tris.clear();
+        drawcalls[d].quads.clear();
+    }
+
+    for (size_t t = 0; t < nbr_triangles(); t++)
+    {
+        triangle_t tri = { { indices[3*t], indices[3*t+1], indices[3*t+2] } };
+        drawcalls[tri_drawcall[t]].tris.push_back(tri);
+    }
+}
+
+void build_lod_chain(const mesh_t& mesh,
+                     std::vector<mesh_lod_t>& lods,
+                     unsigned nbr_lods,
+                     float reduction,
+                     float max_error)
+{
+    lods.clear();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    mesh_simplifier_t simplifier(mesh);
+    const size_t nbr_tris = simplifier.nbr_triangles();
+    const float error_limit = max_error * simplifier.mesh_extent();
+    double ms = 0;
+
+    size_t target = nbr_tris;
+    for (unsigned l = 1; l < nbr_lods; l++)
+    {
+        size_t prev = simplifier.nbr_triangles();
+        target = (size_t)(target * reduction);
+        float error = simplifier.simplify(target, error_limit);
+
+        // not worth a LOD unless it gets at least halfway to its target
+        if (!simplifier.nbr_triangles() || simplifier.nbr_triangles() > (prev + target) / 2)
+            break;
+
+        ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        mesh_lod_t lod;
+        simplifier.get_drawcalls(lod.drawcalls);
+        lod.nbr_triangles = simplifier.nbr_triangles();
+        lod.error = error;
+
+        auto order_start = std::chrono::high_resolution_clock::now();
+        optimize_triangle_order(mesh.vertices, lod.drawcalls);
+        start += std::chrono::high_resolution_clock::now() - order_start;
+
+        printf("LOD %d: %d triangles, error %g (%.3f%% of extent)\n",
+               l, (int)lod.nbr_triangles, lod.error, 100 * lod.error / simplifier.mesh_extent());
+        lods.push_back(std::move(lod));
+    }
+
+    if (lods.size())
+        printf("simplified %d -> %d triangles in %.1f ms (%.2f M triangles/s)\n",
+               (int)nbr_tris, (int)lods.back().nbr_triangles, ms, nbr_tris / (ms * 1000));
+}
@@ -0,0 +1,114 @@
+//
+//  meshsimplify.h
+//
+//  Mesh simplification by edge collapse with quadric error metrics (Garland & Heckbert 1997),
+//  used to build LOD chains of welded meshes. Collapses move a vertex onto a neighbour, so the
+//  simplified triangles index the vertex array of the original mesh and share its vertex buffer.
+//
+
+#pragma once
+#ifndef MESHSIMPLIFY_H
+#define MESHSIMPLIFY_H
+
+#include <vector>
+#include <cfloat>
+#include "mesh.h"
+
+#define MESH_LOD_CHAIN                  // build a LOD chain in OBJModel_t and select a LOD per frame
+#define MESH_LOD_LEVELS 4               // LODs per model, including the full mesh
+#define MESH_LOD_REDUCTION 0.5f         // triangle count of a LOD relative to the previous one
+#define MESH_LOD_MAX_ERROR 0.02f        // largest LOD error, relative to the mesh extent
+#define MESH_LOD_PIXEL_ERROR 1.0f       // LOD selection: largest projected error allowed, in pixels
+
+//
+// Simplifies the triangles of all drawcalls of a mesh together, so borders between drawcalls
+// stay watertight. Vertices are classified by their topology and only collapse along edges
+// that keep the mesh appearance:
+//
+// manifold: interior vertex, collapses onto any neighbour
+// border: on an open edge, collapses along the border only
+// seam: on a uv/normal seam (two vertices at one position), collapses along the seam, both sides at once
+// locked: seam junctions, non-manifold vertices and vertices shared by several drawcalls (material boundaries)
+//
+// Border edges get extra quadrics so the outline is kept. Collapses that would flip a triangle are
+// rejected. Quads are not simplified (meshes are expected to be triangulated).
+//
+class mesh_simplifier_t
+{
+public:
+
+    mesh_simplifier_t(const mesh_t& mesh);
+
+    //
+    // Collapse edges, cheapest first, until at most target_triangles remain or the next collapse would
+    // exceed max_error (model units). Can be called repeatedly with decreasing targets to get a chain of
+    // results. Returns the error of the current result.
+    //
+    float simplify(size_t target_triangles, float max_error = FLT_MAX);
+
+    size_t nbr_triangles() const { return indices.size() / 3; }
+
+    // largest side of the mesh bounds, model units
+    float mesh_extent() const { return extent; }
+
+    // error of the current result: largest distance to the original surface as estimated by the quadrics
+    float error() const;
+
+    //
+    // current result as drawcalls, with names and materials of the mesh drawcalls
+    //
+    void get_drawcalls(std::vector<drawcall_t>& drawcalls) const;
+
+private:
+
+    enum vertex_kind_t { KIND_MANIFOLD, KIND_BORDER, KIND_SEAM, KIND_LOCKED };
+
+    // plane quadric, in double as errors are tiny differences of its terms on dense meshes
+    struct quadric_t
+    {
+        double a2, b2, c2, ab, ac, bc, ad, bd, cd, d2, w;
+    };
+
+    const mesh_t& mesh;
+
+    std::vector<unsigned> indices;          // current triangles
+    std::vector<int> tri_drawcall;          // drawcall of every current triangle
+    std::vector<vec3f> positions;           // vertex positions normalized to the unit cube
+    float extent;                           // scale back to model units
+
+    std::vector<unsigned> remap;            // first vertex at the same position
+    std::vector<unsigned> wedge;            // next vertex at the same position (circular)
+    std::vector<unsigned char> kind;
+    std::vector<unsigned> open_in, open_out;    // vertex along the single open edge into/out of a vertex
+    std::vector<quadric_t> quadrics;        // per position (indexed by remap)
+    float max_collapse_error = 0;           // squared, normalized units
+
+    void classify_vertices(std::vector<unsigned>& border_edges);
+    void init_quadrics(const std::vector<unsigned>& border_edges);
+    bool can_collapse(unsigned i0, unsigned i1) const;
+    float collapse_error(unsigned i0, unsigned i1) const;
+};
+
+//
+// one level of a LOD chain
+//
+struct mesh_lod_t
+{
+    std::vector<drawcall_t> drawcalls;      // triangles index the vertices of the simplified mesh
+    size_t nbr_triangles = 0;
+    float error = 0;                        // model units
+};
+
+//
+// Build LODs 1 .. nbr_lods-1 of a mesh (LOD 0 being the mesh itself), each with reduction times the
+// triangles of the previous one. The chain ends early when a LOD would exceed max_error (relative to
+// the mesh extent) or the mesh cannot be reduced any further. Triangles of every LOD are reordered
+// for the vertex cache. Prints triangle counts, errors and throughput.
+//
+void build_lod_chain(const mesh_t& mesh,
+                     std::vector<mesh_lod_t>& lods,
+                     unsigned nbr_lods = MESH_LOD_LEVELS,
+                     float reduction = MESH_LOD_REDUCTION,
+                     float max_error = MESH_LOD_MAX_ERROR);
+
+#endif
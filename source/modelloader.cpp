@@ -0,0 +1,116 @@
+//
+//  modelloader.cpp
+//
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "modelloader.h"
+
+model_loader_t::model_loader_t(unsigned nbr_workers)
+{
+	unsigned nbr_hw_threads = std::max(1u, std::thread::hardware_concurrency());
+	if (!nbr_workers)
+		nbr_workers = nbr_hw_threads;
+
+	// a single model uses all hardware threads, several share them
+	pipeline_threads = std::max(1u, nbr_hw_threads / nbr_workers);
+
+	for (unsigned k = 0; k < nbr_workers; k++)
+		workers.push_back(std::thread(&model_loader_t::worker, this));
+}
+
+model_request_ptr model_loader_t::load(const std::string& objfile)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// forget requests nobody holds any more
+	for (auto it = requests.begin(); it != requests.end(); )
+	{
+		if (it->second.expired())
+			it = requests.erase(it);
+		else
+			++it;
+	}
+
+	// share a request that is queued, loading or loaded, retry one that failed
+	auto it = requests.find(objfile);
+	if (it != requests.end())
+	{
+		auto request = it->second.lock();
+		if (request && request->state != MODEL_FAILED)
+			return request;
+	}
+
+	auto request = std::make_shared<model_request_t>(objfile);
+	requests[objfile] = request;
+	queue.push_back(request);
+	queue_cv.notify_one();
+	return request;
+}
+
+size_t model_loader_t::pending()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return queue.size() + nbr_busy;
+}
+
+void model_loader_t::wait_idle()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle_cv.wait(lock, [&] { return queue.empty() && !nbr_busy; });
+}
+
+void model_loader_t::worker()
+{
+	for (;;)
+	{
+		model_request_ptr request;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			queue_cv.wait(lock, [&] { return stop || !queue.empty(); });
+			if (stop)
+				return;
+			request = queue.front();
+			queue.pop_front();
+			nbr_busy++;
+		}
+
+		request->state = MODEL_LOADING;
+		try
+		{
+			load_model_data(request->objfile, request->data, pipeline_threads, [&](float done) { request->progress = done; });
+			request->state = MODEL_LOADED;
+		}
+		catch (const std::exception& e)
+		{
+			request->data.release();
+			request->error = e.what();
+			request->state = MODEL_FAILED;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		nbr_busy--;
+		if (queue.empty() && !nbr_busy)
+			idle_cv.notify_all();
+	}
+}
+
+model_loader_t::~model_loader_t()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+		for (auto& request : queue)
+		{
+			request->error = "cancelled";
+			request->state = MODEL_FAILED;
+		}
+		queue.clear();
+	}
+	queue_cv.notify_all();
+	idle_cv.notify_all();
+
+	for (auto& w : workers)
+		w.join();
+}
@@ -0,0 +1,93 @@
+//
+//  modelloader.h
+//
+//  Background model loading: OBJ models are loaded from their mesh cache, or parsed, welded and
+//  cooked (meshcook.h), on worker threads. The main thread polls the returned requests and creates
+//  the device resources of a model once its data is ready (OBJModel_t(const model_data_t&, ...)),
+//  drawing a placeholder until then. Headless and platform-independent.
+//
+
+#pragma once
+#ifndef MODELLOADER_H
+#define MODELLOADER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include "meshcook.h"
+
+enum model_state_t
+{
+	MODEL_QUEUED = 0,
+	MODEL_LOADING,
+	MODEL_LOADED,	// data is ready for upload
+	MODEL_FAILED,	// error tells why
+};
+
+//
+// A model being loaded. data and error may only be touched once state is MODEL_LOADED or
+// MODEL_FAILED; state and progress can be read at any time.
+//
+struct model_request_t
+{
+	std::string objfile;
+	std::atomic<int> state;			// model_state_t
+	std::atomic<float> progress;	// 0 - 1
+	std::string error;
+	model_data_t data;
+
+	model_request_t(const std::string& objfile) : objfile(objfile), state(MODEL_QUEUED), progress(0.0f) { }
+
+	bool ready() const { return state == MODEL_LOADED; }
+	bool done() const { return state >= MODEL_LOADED; }
+};
+
+typedef std::shared_ptr<model_request_t> model_request_ptr;
+
+class model_loader_t
+{
+	std::vector<std::thread> workers;
+	std::deque<model_request_ptr> queue;
+	std::map<std::string, std::weak_ptr<model_request_t> > requests;	// by objfile, so a model is loaded once
+	std::mutex mutex;
+	std::condition_variable queue_cv, idle_cv;
+	unsigned nbr_busy = 0;
+	unsigned pipeline_threads = 0;
+	bool stop = false;
+
+	void worker();
+
+public:
+
+	//
+	// nbr_workers models are loaded in parallel (0 = one per hardware thread), the hardware threads
+	// are shared among them for the parsing and tangent passes
+	//
+	model_loader_t(unsigned nbr_workers = 0);
+
+	//
+	// Queue a model, or return the request of the same objfile if it is still around and has not
+	// failed (a failed model is queued again)
+	//
+	model_request_ptr load(const std::string& objfile);
+
+	// number of requests queued or loading
+	size_t pending();
+
+	// block until the queue is empty and all workers are idle
+	void wait_idle();
+
+	//
+	// Requests still in the queue are failed, models being loaded are finished
+	//
+	~model_loader_t();
+};
+
+#endif
@@ -11,6 +11,9 @@
 
 #include <string>
 #include <vector>
+#include <cstdlib>
+#include <climits>
+#include <cstring>
 
 inline std::string& rtrim(std::string& str)
 {
@@ -73,4 +76,167 @@ static bool find_filename_from_suffixes(const std::string &str, const std::vecto
 	return false;
 }
 
+//
+// single-pass tokenizing helpers
+//
+// These operate on a character range [p, end) that need not be null-terminated, and advance p past
+// whatever they consume. The number parsers follow the from_chars convention: on failure, p is left untouched.
+//
+
+inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+inline const char* skip_blanks(const char* p, const char* end)
+{
+    while (p < end && is_blank(*p)) p++;
+    return p;
+}
+
+inline const char* skip_nonblanks(const char* p, const char* end)
+{
+    while (p < end && !is_blank(*p)) p++;
+    return p;
+}
+
+//
+// extract the next line [line, line_end) from [p, end) and advance p past its newline
+//
+inline bool next_line(const char*& p, const char* end, const char*& line, const char*& line_end)
+{
+    if (p >= end)
+        return false;
+    
+    const char* eol = (const char*)memchr(p, '\n', end - p);
+    line = p;
+    line_end = eol ? eol : end;
+    p = eol ? eol+1 : end;
+    return true;
+}
+
+//
+// compare a token [tok, tok+len) against a null-terminated keyword
+//
+inline bool token_equals(const char* tok, size_t len, const char* keyword)
+{
+    return strlen(keyword) == len && !memcmp(tok, keyword, len);
+}
+
+//
+// parse a signed decimal integer, saturated to [-INT_MAX, INT_MAX] (all digits are consumed)
+//
+inline bool parse_int(const char*& p, const char* end, int& res)
+{
+    const char* s = p;
+    bool neg = false;
+    if (s < end && (*s == '-' || *s == '+'))
+        neg = (*s++ == '-');
+    
+    if (s == end || (unsigned)(*s - '0') > 9)
+        return false;
+    
+    long long n = 0;
+    while (s < end && (unsigned)(*s - '0') <= 9)
+    {
+        n = n*10 + (*s++ - '0');
+        if (n > INT_MAX)
+            n = INT_MAX;
+    }
+    
+    res = neg ? -(int)n : (int)n;
+    p = s;
+    return true;
+}
+
+//
+// parse a decimal float, e.g. -1.25e-3
+//
+// Mantissas that fit in 24 bits with a power-of-ten exponent within [-10, 10] are both exact
+// in single precision, so one multiplication or division gives the correctly rounded result
+// (the same value strtof returns). Anything else (long mantissas, inf/nan, hex) goes via strtof.
+//
+inline bool parse_float(const char*& p, const char* end, float& res)
+{
+    static const float pow10[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+    
+    const char* s = p;
+    bool neg = false;
+    if (s < end && (*s == '-' || *s == '+'))
+        neg = (*s++ == '-');
+    
+    unsigned long long mant = 0;
+    int exp10 = 0, sig_digits = 0;
+    bool any_digits = false;
+    
+    while (s < end && (unsigned)(*s - '0') <= 9)
+    {
+        if (mant || *s != '0') sig_digits++;
+        if (sig_digits <= 19) mant = mant*10 + (*s - '0'); else exp10++;
+        any_digits = true;
+        s++;
+    }
+    if (s < end && *s == '.')
+    {
+        s++;
+        while (s < end && (unsigned)(*s - '0') <= 9)
+        {
+            if (mant || *s != '0') sig_digits++;
+            if (sig_digits <= 19) { mant = mant*10 + (*s - '0'); exp10--; }
+            any_digits = true;
+            s++;
+        }
+    }
+    if (any_digits && s < end && (*s == 'e' || *s == 'E'))
+    {
+        const char* e = s+1;
+        int exp = 0;
+        if (parse_int(e, end, exp))
+        {
+            // far beyond the float range either way, and exp10 cannot overflow
+            exp10 += exp < -100000 ? -100000 : (exp > 100000 ? 100000 : exp);
+            s = e;
+        }
+    }
+    
+    if (any_digits && sig_digits <= 19 && mant <= (1ull << 24) && exp10 >= -10 && exp10 <= 10)
+    {
+        float f = (float)mant;
+        f = exp10 < 0 ? f / pow10[-exp10] : f * pow10[exp10];
+        res = neg ? -f : f;
+        p = s;
+        return true;
+    }
+    
+    // slow path: hand the token to strtof
+    char buf[64];
+    size_t len = skip_nonblanks(p, end) - p;
+    if (!len || len >= sizeof(buf))
+        return false;
+    memcpy(buf, p, len);
+    buf[len] = '\0';
+    
+    char* buf_end;
+    float f = strtof(buf, &buf_end);
+    if (buf_end == buf)
+        return false;
+    
+    res = f;
+    p += buf_end - buf;
+    return true;
+}
+
+//
+// parse up to max blank-separated floats, returns the number parsed
+//
+inline int parse_floats(const char*& p, const char* end, float* res, int max)
+{
+    int n = 0;
+    for (; n < max; n++)
+    {
+        const char* s = skip_blanks(p, end);
+        if (!parse_float(s, end, res[n]))
+            break;
+        p = s;
+    }
+    return n;
+}
+
 #endif /* parseutil_h */
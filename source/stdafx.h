@@ -5,6 +5,7 @@
 #include <D3D11.h>
 #include <d3dCompiler.h>
 #include <dinput.h>
+#include <wincodec.h>
 
 #include <string>
 #include <fstream>
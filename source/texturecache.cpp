@@ -0,0 +1,236 @@
+//
+//  texturecache.cpp
+//
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "texturecache.h"
+#include "texturemips.h"
+#include "texturecompress.h"
+#include "assetpack.h"
+
+texture_cache_t::texture_cache_t(const texture_decoder_t& decoder, size_t budget) : decoder(decoder), budget(budget)
+{
+
+}
+
+// key of a path in the path table, textures with other flags are other entries
+static std::string texture_key(const std::string& path, unsigned flags)
+{
+	return vfs_normalize_path(path) + "#" + std::to_string(flags);
+}
+
+//
+// the cooked <path>.dds of a texture, if it was cooked from this content of the source and for this
+// use: BC1/BC3 for color maps (TEXTURE_SRGB), BC5 for normal maps (a map used both ways is only
+// cooked for one of them, the other decodes the source)
+//
+static bool read_cooked(const std::string& path, unsigned flags, unsigned long long source_hash, texture_t& texture)
+{
+	mapped_file_t file;
+	unsigned long long cooked_hash;
+	bool cooked = vfs_open(path + TEXTURE_DDS_SUFFIX, file) &&
+		read_dds(file.data, file.size, texture.image, texture.mips, cooked_hash) && cooked_hash == source_hash;
+	if (cooked)
+	{
+		unsigned format = texture.image.format;
+		cooked = (flags & TEXTURE_SRGB) ? (format == TEXTURE_BC1 || format == TEXTURE_BC3) : format == TEXTURE_BC5;
+	}
+	if (!cooked)
+	{
+		texture.image = texture_image_t();
+		texture.mips.clear();
+		return false;
+	}
+	return true;
+}
+
+texture_t* texture_cache_t::acquire(const std::string& path, unsigned flags)
+{
+	std::string key = texture_key(path, flags);
+
+	auto reference = [&](texture_t* texture) -> texture_t*
+	{
+		texture->refs++;
+		texture->last_use = ++use_clock;
+		return texture;
+	};
+
+	// known path
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto p = paths.find(key);
+		if (p != paths.end())
+		{
+			counters.hits++;
+			return reference(textures[p->second]);
+		}
+	}
+
+	mapped_file_t file;
+	if (!vfs_open(path, file) || !file.size)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		counters.failures++;
+		return nullptr;
+	}
+	unsigned long long source_hash = hash_bytes(file.data, file.size);
+	unsigned long long hash = hash_bytes(&flags, sizeof(flags), source_hash);
+
+	// same content under another path
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto t = textures.find(hash);
+		if (t != textures.end())
+		{
+			paths[key] = hash;
+			counters.hits++;
+			counters.content_hits++;
+			return reference(t->second);
+		}
+	}
+
+	// decode outside the lock, so other textures can be decoded meanwhile
+	texture_t* texture = new texture_t();
+	if (!(flags & TEXTURE_COOKED) || !read_cooked(path, flags, source_hash, *texture))
+	{
+		if (!decoder(file.data, file.size, texture->image))
+		{
+			delete texture;
+			std::lock_guard<std::mutex> lock(mutex);
+			counters.failures++;
+			return nullptr;
+		}
+		if (flags & TEXTURE_MIPS)
+			build_mips(texture->image, (flags & TEXTURE_SRGB) != 0, texture->mips);
+	}
+	else if (!(flags & TEXTURE_MIPS))
+		texture->mips.clear();
+	texture->hash = hash;
+	texture->flags = flags;
+
+	texture->bytes = texture->image.pixels.size();
+	for (auto& level : texture->mips)
+		texture->bytes += level.pixels.size();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	counters.misses++;
+	counters.decoded_bytes += texture->bytes;
+
+	// another thread may have decoded the same content in the meantime
+	auto t = textures.find(hash);
+	if (t != textures.end())
+	{
+		delete texture;
+		texture = t->second;
+	}
+	else
+	{
+		textures[hash] = texture;
+		counters.resident_bytes += texture->bytes;
+	}
+	paths[key] = hash;
+	reference(texture);
+
+	evict(budget);
+	return texture;
+}
+
+void texture_cache_t::acquire_all(std::vector<texture_request_t>& requests, unsigned nbr_threads)
+{
+	if (!nbr_threads)
+		nbr_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	// the first request of a path decodes, in parallel with the others; repeats are hits afterwards
+	std::vector<size_t> firsts, repeats;
+	std::unordered_map<std::string, size_t> seen;
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		requests[i].texture = nullptr;
+		if (seen.insert({ texture_key(requests[i].path, requests[i].flags), i }).second)
+			firsts.push_back(i);
+		else
+			repeats.push_back(i);
+	}
+
+	std::atomic<size_t> next(0);
+	auto worker = [&]()
+	{
+		for (size_t k; (k = next++) < firsts.size(); )
+		{
+			texture_request_t& r = requests[firsts[k]];
+			r.texture = acquire(r.path, r.flags);
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (unsigned k = 1; k < std::min<size_t>(nbr_threads, firsts.size()); k++)
+		workers.push_back(std::thread(worker));
+	worker();
+	for (auto& w : workers)
+		w.join();
+
+	for (size_t i : repeats)
+		requests[i].texture = acquire(requests[i].path, requests[i].flags);
+}
+
+void texture_cache_t::release(texture_t* texture)
+{
+	if (!texture)
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	texture->refs--;
+	evict(budget);
+}
+
+void texture_cache_t::evict(size_t max_bytes)
+{
+	if (counters.resident_bytes <= max_bytes)
+		return;
+
+	// unreferenced textures, least recently used first
+	std::vector<texture_t*> unused;
+	for (auto& t : textures)
+		if (t.second->refs <= 0)
+			unused.push_back(t.second);
+	std::sort(unused.begin(), unused.end(), [](const texture_t* a, const texture_t* b) { return a->last_use < b->last_use; });
+
+	for (size_t i = 0; i < unused.size() && counters.resident_bytes > max_bytes; i++)
+	{
+		texture_t* texture = unused[i];
+		for (auto p = paths.begin(); p != paths.end(); )
+			p = (p->second == texture->hash) ? paths.erase(p) : std::next(p);
+		textures.erase(texture->hash);
+
+		if (on_evict)
+			on_evict(*texture);
+		counters.resident_bytes -= texture->bytes;
+		counters.evictions++;
+		delete texture;
+	}
+}
+
+void texture_cache_t::trim(size_t max_bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	evict(max_bytes);
+}
+
+texture_cache_stats_t texture_cache_t::stats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return counters;
+}
+
+texture_cache_t::~texture_cache_t()
+{
+	for (auto& t : textures)
+	{
+		if (on_evict)
+			on_evict(*t.second);
+		delete t.second;
+	}
+}
@@ -0,0 +1,142 @@
+//
+//  texturecache.h
+//
+//  Process-wide cache of decoded textures. Textures are looked up by normalized path, and by the
+//  hash of their content the first time a path is seen, so a map shared by several materials or
+//  models - or the same image under another name - is decoded once. Entries are reference counted;
+//  unreferenced ones stay cached until the decoded size of the cache exceeds its budget, and are
+//  then evicted least recently used first.
+//
+//  Decoding (file content -> RGBA8 image, and the mip chain if asked for) and device upload are
+//  separate: the decoder is passed in, and the device object of an entry is created by the renderer
+//  and freed through on_evict. Batches of textures are decoded in parallel. Headless and
+//  platform-independent.
+//
+
+#pragma once
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <cstdint>
+
+#define TEXTURE_CACHE_BUDGET (256u << 20)	// decoded bytes kept for unreferenced textures
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTURE_SSE2		// SSE2 paths in the texture pipeline
+#endif
+
+enum texture_format_t
+{
+	TEXTURE_RGBA8 = 0,
+	TEXTURE_BC1,		// block-compressed formats, see texturecompress.h
+	TEXTURE_BC3,
+	TEXTURE_BC5,
+};
+
+//
+// decoded image, RGBA8 with tightly packed rows, or rows of 4x4 blocks in a BC format
+//
+struct texture_image_t
+{
+	unsigned width = 0, height = 0;
+	unsigned format = TEXTURE_RGBA8;	// texture_format_t
+	std::vector<uint8_t> pixels;
+};
+
+// decode file content to an RGBA8 image, false if the format is not supported or the data is corrupt
+typedef std::function<bool(const void* data, size_t size, texture_image_t& image)> texture_decoder_t;
+
+enum texture_flags_t
+{
+	TEXTURE_MIPS = 1,	// generate the mip chain on the CPU (texturemips.h)
+	TEXTURE_SRGB = 2,	// color map, RGB is sRGB-encoded and mips are filtered in linear space
+	TEXTURE_COOKED = 4,	// use the block-compressed <file>.dds written by the cooker, if it is up to date & cooked for this use
+};
+
+struct texture_t
+{
+	unsigned long long hash = 0;	// hash_bytes() of the file content, combined with the flags
+	unsigned flags = 0;
+	texture_image_t image;			// level 0, may be freed by the uploader once device_data is set
+	std::vector<texture_image_t> mips;	// levels 1.. with TEXTURE_MIPS, likewise
+	size_t bytes = 0;				// decoded size of all levels, counted against the budget
+	void* device_data = nullptr;	// e.g. an ID3D11ShaderResourceView*, set by the uploader
+
+	int refs = 0;
+	unsigned long long last_use = 0;
+};
+
+//
+// a texture of a batch, see acquire_all
+//
+struct texture_request_t
+{
+	std::string path;
+	unsigned flags;
+	texture_t* texture;		// nullptr if it failed to load
+};
+
+struct texture_cache_stats_t
+{
+	size_t hits = 0;			// acquires served from the cache
+	size_t content_hits = 0;	// ... of which a new path with content already cached
+	size_t misses = 0;			// acquires that decoded
+	size_t failures = 0;		// missing or undecodable files
+	size_t evictions = 0;
+	size_t decoded_bytes = 0;	// total decoded, mips included
+	size_t resident_bytes = 0;	// decoded size of the cached textures
+};
+
+class texture_cache_t
+{
+	texture_decoder_t decoder;
+	size_t budget;
+
+	std::unordered_map<unsigned long long, texture_t*> textures;	// by content hash
+	std::unordered_map<std::string, unsigned long long> paths;		// normalized path & flags -> hash
+	texture_cache_stats_t counters;
+	unsigned long long use_clock = 0;
+	std::mutex mutex;
+
+	void evict(size_t max_bytes);
+
+public:
+
+	// called for each texture leaving the cache, to free its device_data
+	std::function<void(texture_t&)> on_evict;
+
+	texture_cache_t(const texture_decoder_t& decoder, size_t budget = TEXTURE_CACHE_BUDGET);
+
+	//
+	// Reference a texture, decoding it through the vfs (assetpack.h) if it is not cached. Returns
+	// nullptr if the file is missing or cannot be decoded. Safe to call from several threads.
+	// The same image with other flags is a separate entry.
+	//
+	texture_t* acquire(const std::string& path, unsigned flags = 0);
+
+	//
+	// Acquire a batch of textures, decoding the ones not cached on nbr_threads threads (0 = one
+	// per hardware thread)
+	//
+	void acquire_all(std::vector<texture_request_t>& requests, unsigned nbr_threads = 0);
+
+	// drop a reference taken by acquire
+	void release(texture_t* texture);
+
+	//
+	// Evict unreferenced textures until the cache is within max_bytes (0 = all of them)
+	//
+	void trim(size_t max_bytes = 0);
+
+	texture_cache_stats_t stats();
+
+	// evicts everything, referenced or not
+	~texture_cache_t();
+};
+
+#endif
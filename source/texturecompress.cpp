@@ -0,0 +1,713 @@
+//
+//  texturecompress.cpp
+//
+
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+#include "texturecompress.h"
+#include "texturemips.h"
+#include "imagedecode.h"
+#include "file_rw.h"
+
+#ifdef TEXTURE_SSE2
+#include <emmintrin.h>
+#endif
+
+#define DDS_SOURCE_TAG 0x58455445	// 'ETEX', marks the source hash in the reserved header words
+
+size_t texture_block_bytes(unsigned format)
+{
+	switch (format)
+	{
+	case TEXTURE_BC1: return 8;
+	case TEXTURE_BC3: return 16;
+	case TEXTURE_BC5: return 16;
+	default: return 0;
+	}
+}
+
+size_t texture_image_bytes(unsigned format, unsigned width, unsigned height)
+{
+	if (format == TEXTURE_RGBA8)
+		return (size_t)width * height * 4;
+	return (size_t)std::max(1u, (width + 3) / 4) * std::max(1u, (height + 3) / 4) * texture_block_bytes(format);
+}
+
+//
+// Nearest palette entry of each of the 16 pixels of a block, over nbr_channels channels
+// (channel-major pixel values). Returns the summed squared error.
+//
+static float match_palette(const float* const* channels, int nbr_channels, const float (*palette)[4], int palette_size, uint8_t* indices)
+{
+#ifdef TEXTURE_SSE2
+	__m128 total = _mm_setzero_ps();
+	for (int g = 0; g < 16; g += 4)
+	{
+		__m128 best = _mm_set1_ps(FLT_MAX);
+		__m128i best_index = _mm_setzero_si128();
+		for (int p = 0; p < palette_size; p++)
+		{
+			__m128 d = _mm_setzero_ps();
+			for (int c = 0; c < nbr_channels; c++)
+			{
+				__m128 diff = _mm_sub_ps(_mm_loadu_ps(channels[c] + g), _mm_set1_ps(palette[p][c]));
+				d = _mm_add_ps(d, _mm_mul_ps(diff, diff));
+			}
+			__m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, best));
+			best = _mm_min_ps(d, best);
+			best_index = _mm_or_si128(_mm_andnot_si128(closer, best_index), _mm_and_si128(closer, _mm_set1_epi32(p)));
+		}
+		int idx[4];
+		_mm_storeu_si128((__m128i*)idx, best_index);
+		for (int i = 0; i < 4; i++)
+			indices[g + i] = (uint8_t)idx[i];
+		total = _mm_add_ps(total, best);
+	}
+	float t[4];
+	_mm_storeu_ps(t, total);
+	return t[0] + t[1] + t[2] + t[3];
+#else
+	float total = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		float best = FLT_MAX;
+		for (int p = 0; p < palette_size; p++)
+		{
+			float d = 0;
+			for (int c = 0; c < nbr_channels; c++)
+				d += (channels[c][i] - palette[p][c]) * (channels[c][i] - palette[p][c]);
+			if (d < best)
+			{
+				best = d;
+				indices[i] = (uint8_t)p;
+			}
+		}
+		total += best;
+	}
+	return total;
+#endif
+}
+
+//
+// Least-squares endpoints e0, e1 for given indices, where index i blends e0 by weights[i] and e1 by
+// 1 - weights[i]. False if the indices do not determine two endpoints.
+//
+static bool fit_endpoints(const float* const* channels, int nbr_channels, const uint8_t* indices, const float* weights, float* e0, float* e1)
+{
+	float aa = 0, ab = 0, bb = 0, ax[4] = { 0 }, bx[4] = { 0 };
+	for (int i = 0; i < 16; i++)
+	{
+		float a = weights[indices[i]], b = 1 - a;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (int c = 0; c < nbr_channels; c++)
+		{
+			ax[c] += a * channels[c][i];
+			bx[c] += b * channels[c][i];
+		}
+	}
+	float det = aa * bb - ab * ab;
+	if (std::fabs(det) < 1e-6f)
+		return false;
+
+	for (int c = 0; c < nbr_channels; c++)
+	{
+		e0[c] = (ax[c] * bb - bx[c] * ab) / det;
+		e1[c] = (bx[c] * aa - ax[c] * ab) / det;
+	}
+	return true;
+}
+
+static uint16_t pack_565(const float* c)
+{
+	int r = (int)(std::min(std::max(c[0], 0.0f), 255.0f) * 31 / 255 + 0.5f);
+	int g = (int)(std::min(std::max(c[1], 0.0f), 255.0f) * 63 / 255 + 0.5f);
+	int b = (int)(std::min(std::max(c[2], 0.0f), 255.0f) * 31 / 255 + 0.5f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void unpack_565(uint16_t v, int* c)
+{
+	int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+	c[0] = (r << 3) | (r >> 2);
+	c[1] = (g << 2) | (g >> 4);
+	c[2] = (b << 3) | (b >> 2);
+}
+
+//
+// Endpoints (5-bit, and 6-bit for green) whose 2/3 : 1/3 blend is closest to each 8-bit value, so
+// flat blocks are not limited to the 565 colors
+//
+struct single_color_table_t
+{
+	uint8_t endpoints[2][256][2];
+
+	single_color_table_t()
+	{
+		for (int t = 0; t < 2; t++)
+		{
+			int bits = t ? 6 : 5, n = 1 << bits;
+			for (int v = 0; v < 256; v++)
+			{
+				float best = FLT_MAX;
+				for (int a = 0; a < n; a++)
+					for (int b = 0; b < n; b++)
+					{
+						int ea = (a << (8 - bits)) | (a >> (2 * bits - 8)), eb = (b << (8 - bits)) | (b >> (2 * bits - 8));
+						float e = std::fabs((2 * ea + eb) / 3.0f - v);
+						if (e < best)
+						{
+							best = e;
+							endpoints[t][v][0] = (uint8_t)a;
+							endpoints[t][v][1] = (uint8_t)b;
+						}
+					}
+			}
+		}
+	}
+};
+static const single_color_table_t single_color;
+
+//
+// BC1 color block, 4-color mode (c0 > c1)
+//
+static void compress_color(const float* const* channels, uint8_t* block)
+{
+	static const float weights[4] = { 1.0f, 0.0f, 2 / 3.0f, 1 / 3.0f };
+
+	bool flat = true;
+	for (int c = 0; c < 3; c++)
+		for (int i = 1; i < 16; i++)
+			flat &= channels[c][i] == channels[c][0];
+	if (flat)
+	{
+		int r = (int)channels[0][0], g = (int)channels[1][0], b = (int)channels[2][0];
+		uint16_t c0 = (uint16_t)((single_color.endpoints[0][r][0] << 11) | (single_color.endpoints[1][g][0] << 5) | single_color.endpoints[0][b][0]);
+		uint16_t c1 = (uint16_t)((single_color.endpoints[0][r][1] << 11) | (single_color.endpoints[1][g][1] << 5) | single_color.endpoints[0][b][1]);
+		uint32_t bits = c0 > c1 ? 0xaaaaaaaa : (c0 < c1 ? 0xffffffff : 0);	// all index 2, or 3 once swapped
+		if (c0 < c1)
+			std::swap(c0, c1);
+		block[0] = (uint8_t)c0;
+		block[1] = (uint8_t)(c0 >> 8);
+		block[2] = (uint8_t)c1;
+		block[3] = (uint8_t)(c1 >> 8);
+		memcpy(block + 4, &bits, 4);
+		return;
+	}
+
+	// principal axis of the colors, by power iteration on their covariance
+	float mean[3] = { 0 }, lo[3], hi[3];
+	for (int c = 0; c < 3; c++)
+	{
+		lo[c] = hi[c] = channels[c][0];
+		for (int i = 0; i < 16; i++)
+		{
+			mean[c] += channels[c][i];
+			lo[c] = std::min(lo[c], channels[c][i]);
+			hi[c] = std::max(hi[c], channels[c][i]);
+		}
+		mean[c] /= 16;
+	}
+	float cov[3][3] = { { 0 } };
+	for (int i = 0; i < 16; i++)
+		for (int a = 0; a < 3; a++)
+			for (int b = 0; b < 3; b++)
+				cov[a][b] += (channels[a][i] - mean[a]) * (channels[b][i] - mean[b]);
+
+	float axis[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+	for (int it = 0; it < 8; it++)
+	{
+		float v[3];
+		for (int a = 0; a < 3; a++)
+			v[a] = cov[a][0] * axis[0] + cov[a][1] * axis[1] + cov[a][2] * axis[2];
+		float m = std::max(std::fabs(v[0]), std::max(std::fabs(v[1]), std::fabs(v[2])));
+		if (m < 1e-6f)
+			break;
+		for (int a = 0; a < 3; a++)
+			axis[a] = v[a] / m;
+	}
+
+	// endpoints at the extremes of the colors projected on the axis
+	float len2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+	float tmin = 0, tmax = 0;
+	if (len2 > 1e-12f)
+	{
+		tmin = FLT_MAX;
+		tmax = -FLT_MAX;
+		for (int i = 0; i < 16; i++)
+		{
+			float t = ((channels[0][i] - mean[0]) * axis[0] + (channels[1][i] - mean[1]) * axis[1] + (channels[2][i] - mean[2]) * axis[2]) / len2;
+			tmin = std::min(tmin, t);
+			tmax = std::max(tmax, t);
+		}
+	}
+	float e0[3], e1[3];
+	for (int c = 0; c < 3; c++)
+	{
+		e0[c] = mean[c] + axis[c] * tmax;
+		e1[c] = mean[c] + axis[c] * tmin;
+	}
+
+	// quantize, match, then refit the endpoints to the indices found
+	uint16_t best_c0 = 0, best_c1 = 0;
+	uint8_t best_indices[16] = { 0 }, indices[16];
+	float best_error = FLT_MAX;
+	for (int pass = 0; pass < 3; pass++)
+	{
+		uint16_t c0 = pack_565(e0), c1 = pack_565(e1);
+		int q0[3], q1[3];
+		unpack_565(c0, q0);
+		unpack_565(c1, q1);
+
+		float palette[4][4];
+		for (int c = 0; c < 3; c++)
+		{
+			palette[0][c] = (float)q0[c];
+			palette[1][c] = (float)q1[c];
+			palette[2][c] = (2 * q0[c] + q1[c]) / 3.0f;
+			palette[3][c] = (q0[c] + 2 * q1[c]) / 3.0f;
+		}
+		float error = match_palette(channels, 3, palette, 4, indices);
+		if (error < best_error)
+		{
+			best_error = error;
+			best_c0 = c0;
+			best_c1 = c1;
+			memcpy(best_indices, indices, 16);
+		}
+		if (!fit_endpoints(channels, 3, indices, weights, e0, e1))
+			break;
+	}
+
+	// 4-color mode needs c0 > c1: swap the endpoints, or use c0 alone if they are equal
+	if (best_c0 < best_c1)
+	{
+		static const uint8_t swapped[4] = { 1, 0, 3, 2 };
+		std::swap(best_c0, best_c1);
+		for (int i = 0; i < 16; i++)
+			best_indices[i] = swapped[best_indices[i]];
+	}
+	else if (best_c0 == best_c1)
+		memset(best_indices, 0, 16);
+
+	block[0] = (uint8_t)best_c0;
+	block[1] = (uint8_t)(best_c0 >> 8);
+	block[2] = (uint8_t)best_c1;
+	block[3] = (uint8_t)(best_c1 >> 8);
+	uint32_t bits = 0;
+	for (int i = 0; i < 16; i++)
+		bits |= (uint32_t)best_indices[i] << (i * 2);
+	memcpy(block + 4, &bits, 4);
+}
+
+//
+// BC4 single-channel block, 8-value mode (v0 > v1)
+//
+static void compress_channel(const float* values, uint8_t* block)
+{
+	static const float weights[8] = { 1.0f, 0.0f, 6 / 7.0f, 5 / 7.0f, 4 / 7.0f, 3 / 7.0f, 2 / 7.0f, 1 / 7.0f };
+
+	float lo = values[0], hi = values[0];
+	for (int i = 1; i < 16; i++)
+	{
+		lo = std::min(lo, values[i]);
+		hi = std::max(hi, values[i]);
+	}
+
+	uint8_t best_v0 = (uint8_t)(hi + 0.5f), best_v1 = (uint8_t)(lo + 0.5f);
+	uint8_t best_indices[16] = { 0 }, indices[16];
+	float e0 = hi, e1 = lo;
+	float best_error = FLT_MAX;
+
+	for (int pass = 0; pass < 3 && best_v0 != best_v1; pass++)
+	{
+		int v0 = (int)(std::min(std::max(e0, 0.0f), 255.0f) + 0.5f), v1 = (int)(std::min(std::max(e1, 0.0f), 255.0f) + 0.5f);
+		if (v0 < v1)
+			std::swap(v0, v1);
+		if (v0 == v1)
+			break;
+
+		float palette[8][4];
+		for (int p = 0; p < 8; p++)
+			palette[p][0] = weights[p] * v0 + (1 - weights[p]) * v1;
+		float error = match_palette(&values, 1, palette, 8, indices);
+		if (error < best_error)
+		{
+			best_error = error;
+			best_v0 = (uint8_t)v0;
+			best_v1 = (uint8_t)v1;
+			memcpy(best_indices, indices, 16);
+		}
+		if (!fit_endpoints(&values, 1, indices, weights, &e0, &e1))
+			break;
+	}
+	if (best_v0 == best_v1)
+		memset(best_indices, 0, 16);
+
+	block[0] = best_v0;
+	block[1] = best_v1;
+	uint64_t bits = 0;
+	for (int i = 0; i < 16; i++)
+		bits |= (uint64_t)best_indices[i] << (i * 3);
+	for (int i = 0; i < 6; i++)
+		block[2 + i] = (uint8_t)(bits >> (i * 8));
+}
+
+void compress_block(unsigned format, const uint8_t* rgba, uint8_t* block)
+{
+	float px[4][16];
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < 4; c++)
+			px[c][i] = rgba[i * 4 + c];
+	const float* channels[4] = { px[0], px[1], px[2], px[3] };
+
+	switch (format)
+	{
+	case TEXTURE_BC1:
+		compress_color(channels, block);
+		break;
+	case TEXTURE_BC3:
+		compress_channel(px[3], block);
+		compress_color(channels, block + 8);
+		break;
+	case TEXTURE_BC5:
+		compress_channel(px[0], block);
+		compress_channel(px[1], block + 8);
+		break;
+	}
+}
+
+static void decompress_color(const uint8_t* block, bool four_color, uint8_t* rgba)
+{
+	uint16_t c0 = block[0] | (block[1] << 8), c1 = block[2] | (block[3] << 8);
+	int palette[4][4];
+	unpack_565(c0, palette[0]);
+	unpack_565(c1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+	for (int c = 0; c < 3; c++)
+	{
+		if (four_color || c0 > c1)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	if (!four_color && c0 <= c1)
+		palette[3][3] = 0;
+
+	uint32_t bits;
+	memcpy(&bits, block + 4, 4);
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < 4; c++)
+			rgba[i * 4 + c] = (uint8_t)palette[(bits >> (i * 2)) & 3][c];
+}
+
+static void decompress_channel(const uint8_t* block, uint8_t* values, int stride)
+{
+	int v0 = block[0], v1 = block[1], palette[8] = { v0, v1 };
+	for (int p = 2; p < 8; p++)
+	{
+		if (v0 > v1)
+			palette[p] = ((8 - p) * v0 + (p - 1) * v1 + 3) / 7;
+		else
+			palette[p] = p < 6 ? ((6 - p) * v0 + (p - 1) * v1 + 2) / 5 : (p == 6 ? 0 : 255);
+	}
+
+	uint64_t bits = 0;
+	for (int i = 0; i < 6; i++)
+		bits |= (uint64_t)block[2 + i] << (i * 8);
+	for (int i = 0; i < 16; i++)
+		values[i * stride] = (uint8_t)palette[(bits >> (i * 3)) & 7];
+}
+
+void decompress_block(unsigned format, const uint8_t* block, uint8_t* rgba)
+{
+	switch (format)
+	{
+	case TEXTURE_BC1:
+		decompress_color(block, false, rgba);
+		break;
+	case TEXTURE_BC3:
+		decompress_color(block + 8, true, rgba);
+		decompress_channel(block, rgba + 3, 4);
+		break;
+	case TEXTURE_BC5:
+		for (int i = 0; i < 16; i++)
+		{
+			rgba[i * 4 + 2] = 0;
+			rgba[i * 4 + 3] = 255;
+		}
+		decompress_channel(block, rgba, 4);
+		decompress_channel(block + 8, rgba + 1, 4);
+		break;
+	}
+}
+
+// run fn(0..n-1) on up to nbr_threads threads
+template<class F>
+static void parallel_rows(unsigned n, unsigned nbr_threads, const F& fn)
+{
+	if (!nbr_threads)
+		nbr_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	std::atomic<unsigned> next(0);
+	auto worker = [&]()
+	{
+		for (unsigned i; (i = next++) < n; )
+			fn(i);
+	};
+
+	std::vector<std::thread> workers;
+	for (unsigned k = 1; k < std::min(nbr_threads, n); k++)
+		workers.push_back(std::thread(worker));
+	worker();
+	for (auto& w : workers)
+		w.join();
+}
+
+void compress_image(const texture_image_t& image, unsigned format, texture_image_t& compressed, unsigned nbr_threads)
+{
+	unsigned w = image.width, h = image.height;
+	unsigned bw = std::max(1u, (w + 3) / 4), bh = std::max(1u, (h + 3) / 4);
+	size_t block_bytes = texture_block_bytes(format);
+
+	compressed.width = w;
+	compressed.height = h;
+	compressed.format = format;
+	compressed.pixels.resize(bw * bh * block_bytes);
+	if (!w || !h)
+		return;
+
+	parallel_rows(bh, nbr_threads, [&](unsigned by)
+	{
+		uint8_t rgba[64];
+		for (unsigned bx = 0; bx < bw; bx++)
+		{
+			for (unsigned y = 0; y < 4; y++)
+			{
+				unsigned sy = std::min(by * 4 + y, h - 1);
+				for (unsigned x = 0; x < 4; x++)
+				{
+					unsigned sx = std::min(bx * 4 + x, w - 1);
+					memcpy(rgba + (y * 4 + x) * 4, &image.pixels[((size_t)sy * w + sx) * 4], 4);
+				}
+			}
+			compress_block(format, rgba, &compressed.pixels[((size_t)by * bw + bx) * block_bytes]);
+		}
+	});
+}
+
+void decompress_image(const texture_image_t& compressed, texture_image_t& image)
+{
+	unsigned w = compressed.width, h = compressed.height;
+	unsigned bw = std::max(1u, (w + 3) / 4), bh = std::max(1u, (h + 3) / 4);
+	size_t block_bytes = texture_block_bytes(compressed.format);
+
+	image.width = w;
+	image.height = h;
+	image.format = TEXTURE_RGBA8;
+	image.pixels.resize((size_t)w * h * 4);
+
+	uint8_t rgba[64];
+	for (unsigned by = 0; by < bh; by++)
+	{
+		for (unsigned bx = 0; bx < bw; bx++)
+		{
+			decompress_block(compressed.format, &compressed.pixels[((size_t)by * bw + bx) * block_bytes], rgba);
+			for (unsigned y = 0; y < 4 && by * 4 + y < h; y++)
+				for (unsigned x = 0; x < 4 && bx * 4 + x < w; x++)
+					memcpy(&image.pixels[((size_t)(by * 4 + y) * w + bx * 4 + x) * 4], rgba + (y * 4 + x) * 4, 4);
+		}
+	}
+}
+
+double image_psnr(const texture_image_t& a, const texture_image_t& b, int nbr_channels)
+{
+	if (a.width != b.width || a.height != b.height || a.pixels.size() != b.pixels.size() || a.pixels.empty())
+		return 0;
+
+	double sum = 0;
+	for (size_t i = 0; i < a.pixels.size(); i += 4)
+		for (int c = 0; c < nbr_channels; c++)
+		{
+			double d = (double)a.pixels[i + c] - b.pixels[i + c];
+			sum += d * d;
+		}
+	double mse = sum / ((a.pixels.size() / 4) * nbr_channels);
+	return mse > 0 ? 10 * std::log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+//
+// DDS
+//
+// header as 32 dwords: magic, then DDS_HEADER. Little-endian, like all targets of this code.
+//
+enum
+{
+	DDS_SIZE = 1, DDS_FLAGS, DDS_HEIGHT, DDS_WIDTH, DDS_LINEAR_SIZE, DDS_DEPTH, DDS_MIP_COUNT,
+	DDS_RESERVED1,
+	DDS_PF_SIZE = 19, DDS_PF_FLAGS, DDS_PF_FOURCC,
+	DDS_CAPS = 27,
+	DDS_HEADER_DWORDS = 32
+};
+
+static uint32_t fourcc(const char* s)
+{
+	return (uint32_t)s[0] | ((uint32_t)s[1] << 8) | ((uint32_t)s[2] << 16) | ((uint32_t)s[3] << 24);
+}
+
+bool write_dds(const std::string& ddsfile, const std::vector<const texture_image_t*>& levels, unsigned long long source_hash)
+{
+	if (levels.empty())
+		return false;
+	const texture_image_t& base = *levels[0];
+
+	uint32_t header[DDS_HEADER_DWORDS] = { 0 };
+	header[0] = fourcc("DDS ");
+	header[DDS_SIZE] = 124;
+	header[DDS_FLAGS] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;	// caps, height, width, pixel format, mip count, linear size
+	header[DDS_HEIGHT] = base.height;
+	header[DDS_WIDTH] = base.width;
+	header[DDS_LINEAR_SIZE] = (uint32_t)texture_image_bytes(base.format, base.width, base.height);
+	header[DDS_MIP_COUNT] = (uint32_t)levels.size();
+	header[DDS_RESERVED1] = DDS_SOURCE_TAG;
+	header[DDS_RESERVED1 + 1] = (uint32_t)source_hash;
+	header[DDS_RESERVED1 + 2] = (uint32_t)(source_hash >> 32);
+	header[DDS_PF_SIZE] = 32;
+	header[DDS_PF_FLAGS] = 0x4;		// fourcc
+	header[DDS_PF_FOURCC] = fourcc(base.format == TEXTURE_BC1 ? "DXT1" : (base.format == TEXTURE_BC3 ? "DXT5" : "ATI2"));
+	header[DDS_CAPS] = 0x1000 | (levels.size() > 1 ? 0x400008 : 0);	// texture, mipmap & complex
+
+	if (!texture_block_bytes(base.format))
+		return false;
+
+	// write to a temporary and rename, so a reader never sees a partial file
+	std::string tmpfile = ddsfile + ".tmp";
+	FILE* f = fopen(tmpfile.c_str(), "wb");
+	if (!f)
+		return false;
+	bool ok = fwrite(header, sizeof(header), 1, f) == 1;
+	for (auto level : levels)
+		ok &= level->format == base.format &&
+			level->pixels.size() == texture_image_bytes(level->format, level->width, level->height) &&
+			fwrite(level->pixels.data(), level->pixels.size(), 1, f) == 1;
+	ok &= !fclose(f);
+
+	remove(ddsfile.c_str());
+	if (!ok || rename(tmpfile.c_str(), ddsfile.c_str()))
+	{
+		remove(tmpfile.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool read_dds(const void* data, size_t size, texture_image_t& image, std::vector<texture_image_t>& mips, unsigned long long& source_hash)
+{
+	uint32_t header[DDS_HEADER_DWORDS];
+	if (size < sizeof(header))
+		return false;
+	memcpy(header, data, sizeof(header));
+	if (header[0] != fourcc("DDS ") || header[DDS_SIZE] != 124 || !(header[DDS_PF_FLAGS] & 0x4))
+		return false;
+
+	unsigned format;
+	uint32_t cc = header[DDS_PF_FOURCC];
+	if (cc == fourcc("DXT1"))
+		format = TEXTURE_BC1;
+	else if (cc == fourcc("DXT5"))
+		format = TEXTURE_BC3;
+	else if (cc == fourcc("ATI2") || cc == fourcc("BC5U"))
+		format = TEXTURE_BC5;
+	else
+		return false;
+
+	source_hash = 0;
+	if (header[DDS_RESERVED1] == DDS_SOURCE_TAG)
+		source_hash = header[DDS_RESERVED1 + 1] | ((unsigned long long)header[DDS_RESERVED1 + 2] << 32);
+
+	unsigned w = header[DDS_WIDTH], h = header[DDS_HEIGHT];
+	unsigned nbr_levels = std::max(1u, header[DDS_MIP_COUNT]);
+	if (!w || !h || w > (1u << 15) || h > (1u << 15) || nbr_levels > 16)
+		return false;
+
+	const uint8_t* p = (const uint8_t*)data + sizeof(header);
+	const uint8_t* end = (const uint8_t*)data + size;
+	mips.clear();
+	for (unsigned i = 0; i < nbr_levels; i++)
+	{
+		texture_image_t& level = i ? (mips.push_back(texture_image_t()), mips.back()) : image;
+		level.width = std::max(1u, w >> i);
+		level.height = std::max(1u, h >> i);
+		level.format = format;
+		size_t bytes = texture_image_bytes(format, level.width, level.height);
+		if ((size_t)(end - p) < bytes)
+			return false;
+		level.pixels.assign(p, p + bytes);
+		p += bytes;
+	}
+	return true;
+}
+
+bool cook_texture(const std::string& file, bool normal_map, texture_cook_stats_t& stats, unsigned nbr_threads)
+{
+	mapped_file_t data;
+	texture_image_t image;
+	if (!data.map(file.c_str()) || !decode_image(data.data, data.size, image) || image.width % 4 || image.height % 4)
+		return false;
+	unsigned long long source_hash = hash_bytes(data.data, data.size);
+
+	unsigned format = TEXTURE_BC5;
+	if (!normal_map)
+	{
+		format = TEXTURE_BC1;
+		for (size_t i = 3; i < image.pixels.size(); i += 4)
+			if (image.pixels[i] != 255)
+			{
+				format = TEXTURE_BC3;
+				break;
+			}
+	}
+
+	std::vector<texture_image_t> mips;
+	build_mips(image, !normal_map, mips);
+
+	auto t0 = std::chrono::high_resolution_clock::now();
+	std::vector<texture_image_t> compressed(mips.size() + 1);
+	std::vector<const texture_image_t*> levels;
+	for (size_t i = 0; i < compressed.size(); i++)
+	{
+		compress_image(i ? mips[i - 1] : image, format, compressed[i], nbr_threads);
+		levels.push_back(&compressed[i]);
+	}
+	auto t1 = std::chrono::high_resolution_clock::now();
+
+	texture_image_t decompressed;
+	decompress_image(compressed[0], decompressed);
+
+	stats.format = format;
+	stats.width = image.width;
+	stats.height = image.height;
+	stats.psnr = image_psnr(image, decompressed, normal_map ? 2 : (format == TEXTURE_BC3 ? 4 : 3));
+	stats.ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+	stats.raw_bytes = image.pixels.size();
+	stats.compressed_bytes = 0;
+	for (auto& level : compressed)
+		stats.compressed_bytes += level.pixels.size();
+	for (auto& level : mips)
+		stats.raw_bytes += level.pixels.size();
+
+	return write_dds(file + TEXTURE_DDS_SUFFIX, levels, source_hash);
+}
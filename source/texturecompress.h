@@ -0,0 +1,80 @@
+//
+//  texturecompress.h
+//
+//  Block compression of textures: BC1 (DXT1) and BC3 (DXT5) for color maps, BC5 (ATI2) for
+//  tangent-space normal maps (X & Y, Z is reconstructed in the shader). Endpoints are fitted along
+//  the principal axis of each block and refined by least squares; palette matching is SSE2
+//  (TEXTURE_SSE2) and images are compressed in parallel over rows of blocks.
+//
+//  The cooker writes compressed textures with their mip chains as <file>.dds, a plain DDS (FourCC
+//  header) that DDSTextureLoader reads as well, tagged with the hash of the source file so stale
+//  ones are ignored. Headless and platform-independent.
+//
+
+#pragma once
+#ifndef TEXTURECOMPRESS_H
+#define TEXTURECOMPRESS_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "texturecache.h"
+
+#define TEXTURE_DDS_SUFFIX ".dds"
+
+// bytes per 4x4 block, 0 for TEXTURE_RGBA8
+size_t texture_block_bytes(unsigned format);
+
+// size of an image of the format
+size_t texture_image_bytes(unsigned format, unsigned width, unsigned height);
+
+//
+// Compress a 4x4 block of RGBA8 pixels (64 bytes, row by row). BC1 ignores alpha; BC5 stores
+// red & green.
+//
+void compress_block(unsigned format, const uint8_t* rgba, uint8_t* block);
+void decompress_block(unsigned format, const uint8_t* block, uint8_t* rgba);
+
+//
+// Compress an RGBA8 image to a BC format, on nbr_threads threads (0 = one per hardware thread).
+// Edge blocks of sizes that are not a multiple of 4 repeat the last row & column.
+//
+void compress_image(const texture_image_t& image, unsigned format, texture_image_t& compressed, unsigned nbr_threads = 0);
+
+// back to RGBA8, for measuring quality
+void decompress_image(const texture_image_t& compressed, texture_image_t& image);
+
+//
+// Peak signal-to-noise ratio (dB) between two RGBA8 images of the same size, over the first
+// nbr_channels channels
+//
+double image_psnr(const texture_image_t& a, const texture_image_t& b, int nbr_channels = 3);
+
+//
+// DDS files of block-compressed textures: levels are the base level and its mips
+//
+bool write_dds(const std::string& ddsfile, const std::vector<const texture_image_t*>& levels, unsigned long long source_hash);
+
+//
+// Read a DDS written by write_dds (or any DXT1/DXT5/ATI2 DDS, whose source_hash is then 0)
+//
+bool read_dds(const void* data, size_t size, texture_image_t& image, std::vector<texture_image_t>& mips, unsigned long long& source_hash);
+
+struct texture_cook_stats_t
+{
+	unsigned format = TEXTURE_RGBA8;
+	unsigned width = 0, height = 0;
+	double psnr = 0;			// of the base level
+	double ms = 0;				// compression time, all levels
+	size_t raw_bytes = 0, compressed_bytes = 0;
+};
+
+//
+// Compress a color map (BC1, BC3 if it has alpha) or a normal map (BC5) with its mip chain to
+// <file>.dds. Fails if the file cannot be decoded, or if its size is not a multiple of 4 (which
+// D3D11 requires of block-compressed textures).
+//
+bool cook_texture(const std::string& file, bool normal_map, texture_cook_stats_t& stats, unsigned nbr_threads = 0);
+
+#endif
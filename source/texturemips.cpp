@@ -0,0 +1,133 @@
+//
+//  texturemips.cpp
+//
+
+#include <cmath>
+#include <algorithm>
+
+#include "texturemips.h"
+
+#ifdef TEXTURE_SSE2
+#include <emmintrin.h>
+#endif
+
+#define SRGB_TABLE_BITS 12	// linear values are quantized to this many bits for the sRGB encoding table
+
+namespace {
+
+struct mip_tables_t
+{
+	float to_linear[2][256];						// 8-bit value to linear float, [0] plain, [1] sRGB-encoded
+	uint8_t to_srgb[(1 << SRGB_TABLE_BITS) + 1];	// quantized linear float to sRGB-encoded 8-bit
+
+	mip_tables_t()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			float c = i / 255.0f;
+			to_linear[0][i] = c;
+			to_linear[1][i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i <= (1 << SRGB_TABLE_BITS); i++)
+		{
+			float l = (float)i / (1 << SRGB_TABLE_BITS);
+			float s = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1 / 2.4f) - 0.055f;
+			to_srgb[i] = (uint8_t)std::min(255.0f, s * 255.0f + 0.5f);
+		}
+	}
+};
+
+// built before main, so levels can be generated from several threads
+const mip_tables_t mip_tables;
+
+}
+
+//
+// float RGBA to RGBA8, sRGB-encoding the RGB channels if srgb
+//
+static void encode_level(const float* src, size_t nbr_pixels, bool srgb, uint8_t* dst)
+{
+	const float rgb_scale = srgb ? (float)(1 << SRGB_TABLE_BITS) : 255.0f;
+
+#ifdef TEXTURE_SSE2
+	const __m128 scale = _mm_setr_ps(rgb_scale, rgb_scale, rgb_scale, 255.0f);
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f);
+	for (size_t i = 0; i < nbr_pixels; i++, src += 4, dst += 4)
+	{
+		__m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src), zero), one);
+		__m128i q = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
+		int idx[4];
+		_mm_storeu_si128((__m128i*)idx, q);
+		for (int c = 0; c < 3; c++)
+			dst[c] = srgb ? mip_tables.to_srgb[idx[c]] : (uint8_t)idx[c];
+		dst[3] = (uint8_t)idx[3];
+	}
+#else
+	for (size_t i = 0; i < nbr_pixels; i++, src += 4, dst += 4)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			float v = std::min(std::max(src[c], 0.0f), 1.0f);
+			int q = (int)(v * (c < 3 ? rgb_scale : 255.0f) + 0.5f);
+			dst[c] = (c < 3 && srgb) ? mip_tables.to_srgb[q] : (uint8_t)q;
+		}
+	}
+#endif
+}
+
+//
+// 2x2 box filter of a float RGBA level to the next
+//
+static void downsample_level(const float* src, unsigned w, unsigned h, float* dst, unsigned dw, unsigned dh)
+{
+	for (unsigned y = 0; y < dh; y++)
+	{
+		const float* r0 = src + (size_t)std::min(2 * y, h - 1) * w * 4;
+		const float* r1 = src + (size_t)std::min(2 * y + 1, h - 1) * w * 4;
+		float* d = dst + (size_t)y * dw * 4;
+
+		for (unsigned x = 0; x < dw; x++, d += 4)
+		{
+			unsigned x0 = std::min(2 * x, w - 1) * 4, x1 = std::min(2 * x + 1, w - 1) * 4;
+#ifdef TEXTURE_SSE2
+			__m128 s = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(r0 + x0), _mm_loadu_ps(r0 + x1)),
+								  _mm_add_ps(_mm_loadu_ps(r1 + x0), _mm_loadu_ps(r1 + x1)));
+			_mm_storeu_ps(d, _mm_mul_ps(s, _mm_set1_ps(0.25f)));
+#else
+			for (int c = 0; c < 4; c++)
+				d[c] = (r0[x0 + c] + r0[x1 + c] + r1[x0 + c] + r1[x1 + c]) * 0.25f;
+#endif
+		}
+	}
+}
+
+void build_mips(const texture_image_t& image, bool srgb, std::vector<texture_image_t>& mips)
+{
+	mips.clear();
+	unsigned w = image.width, h = image.height;
+	if (!w || !h || image.pixels.size() < (size_t)w * h * 4)
+		return;
+
+	// the base level in linear float, each level is filtered from the unquantized one before it
+	std::vector<float> src((size_t)w * h * 4), dst;
+	for (size_t i = 0; i < src.size(); i++)
+		src[i] = mip_tables.to_linear[srgb && (i & 3) != 3][image.pixels[i]];
+
+	while (w > 1 || h > 1)
+	{
+		unsigned dw = std::max(1u, w / 2), dh = std::max(1u, h / 2);
+		dst.resize((size_t)dw * dh * 4);
+		downsample_level(src.data(), w, h, dst.data(), dw, dh);
+
+		texture_image_t level;
+		level.width = dw;
+		level.height = dh;
+		level.pixels.resize((size_t)dw * dh * 4);
+		encode_level(dst.data(), (size_t)dw * dh, srgb, level.pixels.data());
+		mips.push_back(std::move(level));
+
+		src.swap(dst);
+		w = dw;
+		h = dh;
+	}
+}
@@ -0,0 +1,25 @@
+//
+//  texturemips.h
+//
+//  CPU mip chain generation for RGBA8 images. Levels are box-filtered from the previous one in
+//  float, in linear space for sRGB-encoded color maps, so mips keep the brightness of the base level
+//  instead of darkening as 8-bit gamma values are averaged. SSE2 where available (TEXTURE_SSE2).
+//  Headless and platform-independent; the levels are plain RGBA8 images ready for upload.
+//
+
+#pragma once
+#ifndef TEXTUREMIPS_H
+#define TEXTUREMIPS_H
+
+#include <vector>
+
+#include "texturecache.h"
+
+//
+// Levels 1.. of the mip chain of an image, down to 1x1. Each level halves the size (rounding
+// down, at least 1). With srgb the RGB channels are sRGB-encoded and filtered in linear space,
+// alpha is always linear.
+//
+void build_mips(const texture_image_t& image, bool srgb, std::vector<texture_image_t>& mips);
+
+#endif
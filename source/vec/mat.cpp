@@ -40,11 +40,108 @@ namespace linalg
     // explicit template specialisation for <float>
     template vec3<float> mat3<float>::operator*(const vec3<float> &v) const;
     
+#ifdef LINALG_HAS_CONSTEXPR
+    //
+    // compile-time checks of the constexpr constructors & builders
+    //
+    static_assert(mat2f_identity.m11 == 1 && mat2f_identity.m12 == 0 && mat2f_zero.m22 == 0, "mat2 constants");
+    static_assert(mat3f(2, 3, 4).determinant() == 24 && (mat3f(2.0f) * mat3f_identity).m33 == 2, "mat3 determinant & product");
+    static_assert(mat4f_identity.m11 == 1 && mat4f_identity.m21 == 0 && mat4f::identity().m44 == 1, "mat4 identity");
+    static_assert(mat4f::translation(1, 2, 3).m24 == 2 && mat4f::scaling(2, 3, 4).m33 == 4, "mat4 translation & scaling");
+    static_assert(mat4f(mat4f::scaling(5).get_3x3()).m22 == 5, "mat4 3x3 part");
+    
+    // translate(1,2,3) * scale(2), composed at compile time, applied to (1,1,1)
+    static_assert(mat4_mul_generic(mat4_mul_generic(mat4f::translation(1, 2, 3), mat4f::scaling(2.0f)), vec4f(1, 1, 1, 1)).xyz() == vec3f(3, 4, 5), "mat4 composition");
+    
+    // near 1 & far 3 map to depth -1 & 1 (GL clip space) after the divide by w = -z
+    static_assert(mat4f::GL_symmetric_projection(1, 1, 1, 3).m33 == -2 && mat4f::GL_symmetric_projection(1, 1, 1, 3).m34 == -3 &&
+                  mat4f::GL_symmetric_projection(1, 1, 1, 3).m43 == -1, "mat4 symmetric projection");
+    static_assert(mat4f::GL_asymmetric_projection(-1, 3, -1, 1, 1, 3).m13 == 0.5f && mat4f::GL_asymmetric_projection(-1, 3, -1, 1, 1, 3).m11 == 0.5f, "mat4 asymmetric projection");
+#endif
+    
     template <class T>
     vec4<T> mat4<T>::operator *(const vec4<T> &v) const
     {
-        return col[0]*v.x + col[1]*v.y + col[2]*v.z + col[3]*v.w;
+        return mat4_mul_generic(*this, v);
     }
-    // explicit template specialisation for <float>
+    
+#ifndef LINALG_SSE
+    // explicit template specialisation for <float>, SIMD version in mat.h otherwise
     template vec4<float> mat4<float>::operator *(const vec4<float> &v) const;
+#else
+    //
+    // General inverse in SSE by 2x2 blocks: with M = | A B |, each block a 2x2 matrix held in one
+    //                                              | C D |
+    // register, M^-1 = 1/|M| | X# Y# | where # is the adjugate and
+    //                        | Z# W# |
+    //
+    //   X# = |D|A - B(D#C),  Y# = |B|C - D(A#B)#,  Z# = |C|B - A(D#C)#,  W# = |A|D - C(A#B)
+    //   |M| = |A||D| + |B||C| - tr((A#B)(D#C))
+    //
+    // Blocks are taken from columns, which inverts the transpose, and the transpose of that is
+    // stored as columns again, so no transposes are needed.
+    //
+    template<int x, int y, int z, int w>
+    static inline __m128 shuffle(__m128 a, __m128 b)
+    {
+        return _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x));
+    }
+    
+    // 2x2 products of blocks stored as (m11 m12 m21 m22): AB, A#B, AB#
+    static inline __m128 mat2_mul(__m128 a, __m128 b)
+    {
+        return _mm_add_ps(_mm_mul_ps(a, shuffle<0, 3, 0, 3>(b, b)), _mm_mul_ps(shuffle<1, 0, 3, 2>(a, a), shuffle<2, 1, 2, 1>(b, b)));
+    }
+    
+    static inline __m128 mat2_adj_mul(__m128 a, __m128 b)
+    {
+        return _mm_sub_ps(_mm_mul_ps(shuffle<3, 3, 0, 0>(a, a), b), _mm_mul_ps(shuffle<1, 1, 2, 2>(a, a), shuffle<2, 3, 0, 1>(b, b)));
+    }
+    
+    static inline __m128 mat2_mul_adj(__m128 a, __m128 b)
+    {
+        return _mm_sub_ps(_mm_mul_ps(a, shuffle<3, 0, 3, 0>(b, b)), _mm_mul_ps(shuffle<1, 0, 3, 2>(a, a), shuffle<2, 1, 2, 1>(b, b)));
+    }
+    
+    template<>
+    mat4<float> mat4<float>::inverse() const
+    {
+        __m128 c0 = _mm_loadu_ps(array), c1 = _mm_loadu_ps(array + 4), c2 = _mm_loadu_ps(array + 8), c3 = _mm_loadu_ps(array + 12);
+        
+        __m128 A = _mm_movelh_ps(c0, c1), B = _mm_movehl_ps(c1, c0);
+        __m128 C = _mm_movelh_ps(c2, c3), D = _mm_movehl_ps(c3, c2);
+        
+        // |A| |B| |C| |D|
+        __m128 det_sub = _mm_sub_ps(_mm_mul_ps(shuffle<0, 2, 0, 2>(c0, c2), shuffle<1, 3, 1, 3>(c1, c3)),
+                                    _mm_mul_ps(shuffle<1, 3, 1, 3>(c0, c2), shuffle<0, 2, 0, 2>(c1, c3)));
+        __m128 det_A = shuffle<0, 0, 0, 0>(det_sub, det_sub), det_B = shuffle<1, 1, 1, 1>(det_sub, det_sub);
+        __m128 det_C = shuffle<2, 2, 2, 2>(det_sub, det_sub), det_D = shuffle<3, 3, 3, 3>(det_sub, det_sub);
+        
+        __m128 D_C = mat2_adj_mul(D, C), A_B = mat2_adj_mul(A, B);
+        __m128 X_ = _mm_sub_ps(_mm_mul_ps(det_D, A), mat2_mul(B, D_C));
+        __m128 W_ = _mm_sub_ps(_mm_mul_ps(det_A, D), mat2_mul(C, A_B));
+        __m128 Y_ = _mm_sub_ps(_mm_mul_ps(det_B, C), mat2_mul_adj(D, A_B));
+        __m128 Z_ = _mm_sub_ps(_mm_mul_ps(det_C, B), mat2_mul_adj(A, D_C));
+        
+        __m128 tr = _mm_mul_ps(A_B, shuffle<0, 2, 1, 3>(D_C, D_C));
+        tr = _mm_add_ps(tr, shuffle<2, 3, 0, 1>(tr, tr));
+        tr = _mm_add_ps(tr, shuffle<1, 0, 3, 2>(tr, tr));
+        __m128 det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(det_A, det_D), _mm_mul_ps(det_B, det_C)), tr);
+        assert(std::abs(_mm_cvtss_f32(det)) > 1e-8);
+        
+        // the adjugate signs, and 1/|M|
+        __m128 idet = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det);
+        X_ = _mm_mul_ps(X_, idet);
+        Y_ = _mm_mul_ps(Y_, idet);
+        Z_ = _mm_mul_ps(Z_, idet);
+        W_ = _mm_mul_ps(W_, idet);
+        
+        mat4<float> M;
+        _mm_storeu_ps(M.array, shuffle<3, 1, 3, 1>(X_, Y_));
+        _mm_storeu_ps(M.array + 4, shuffle<2, 0, 2, 0>(X_, Y_));
+        _mm_storeu_ps(M.array + 8, shuffle<3, 1, 3, 1>(Z_, W_));
+        _mm_storeu_ps(M.array + 12, shuffle<2, 0, 2, 0>(Z_, W_));
+        return M;
+    }
+#endif
 }
\ No newline at end of file
@@ -16,6 +16,22 @@
 #include "math.h"
 #include "vec.h"
 
+//
+// SIMD specializations of mat4<float> products, chosen at compile time: SSE on x64 and /arch:SSE
+// and up, AVX for mat4 * mat4 with /arch:AVX (-mavx). Same column-major layout, and the same
+// order of operations as the generic code, so results are identical. LINALG_NO_SIMD forces
+// the generic templates.
+//
+#if !defined(LINALG_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define LINALG_SSE
+#if defined(__AVX__)
+#define LINALG_AVX
+#include <immintrin.h>
+#else
+#include <xmmintrin.h>
+#endif
+#endif
+
 namespace linalg
 {
     
@@ -43,7 +59,7 @@ namespace linalg
         //
         // constructor: from elements
         //
-        mat2(const T& m11, const T& m12, const T& m21, const T& m22) : m11(m11), m12(m12), m21(m21), m22(m22)
+        LINALG_CONSTEXPR mat2(const T& m11, const T& m12, const T& m21, const T& m22) : m11(m11), m21(m21), m12(m12), m22(m22)
         {
             
         }
@@ -62,10 +78,8 @@ namespace linalg
         //
         // constructor: scaling matrix
         //
-        mat2(const T& scale_x, const T& scale_y)
+        LINALG_CONSTEXPR mat2(const T& scale_x, const T& scale_y) : m11(scale_x), m21(0.0), m12(0.0), m22(scale_y)
         {
-            m11 = scale_x;	m12 = 0.0;
-            m21 = 0.0;		m22 = scale_y;
         }
         
         mat2<T> invert() const
@@ -80,7 +94,7 @@ namespace linalg
             return mat2<T>(-m11, -m12, -m21, -m22);
         }
         
-        mat2<T> operator * (const T& s) const
+        LINALG_CONSTEXPR mat2<T> operator * (const T& s) const
         {
             return mat2<T>(m11*s, m12*s, m21*s, m22*s);
         }
@@ -105,28 +119,27 @@ namespace linalg
         
         mat3() { }
         
-        mat3(const T& m11, const T& m12, const T& m13,
-             const T& m21, const T& m22, const T& m23,
-             const T& m31, const T& m32, const T& m33) :
-        m11(m11), m12(m12), m13(m13),
-        m21(m21), m22(m22), m23(m23),
-        m31(m31), m32(m32), m33(m33)
+        LINALG_CONSTEXPR mat3(const T& m11, const T& m12, const T& m13,
+                              const T& m21, const T& m22, const T& m23,
+                              const T& m31, const T& m32, const T& m33) :
+        m11(m11), m21(m21), m31(m31),
+        m12(m12), m22(m22), m32(m32),
+        m13(m13), m23(m23), m33(m33)
         {}
         
 		//
         // constructor: equal diagonal elements
         //
-        mat3(const T& d) : mat3(d,d,d) { }
+        LINALG_CONSTEXPR mat3(const T& d) : mat3(d,d,d) { }
         
 		//
         // constructor: diagonal elements (scaling matrix)
         //
-        mat3(const T& d0, const T& d1, const T& d2)
+        LINALG_CONSTEXPR mat3(const T& d0, const T& d1, const T& d2) :
+        m11(d0), m21(0.0), m31(0.0),
+        m12(0.0), m22(d1), m32(0.0),
+        m13(0.0), m23(0.0), m33(d2)
         {
-            m11 = d0;
-            m22 = d1;
-            m33 = d2;
-            m12 = m13 = m21 = m23 = m31 = m32 = 0.0;
         }
         
         //
@@ -210,7 +223,7 @@ namespace linalg
             col[2] = m.col[2];
         }
         
-        T determinant() const
+        LINALG_CONSTEXPR T determinant() const
         {
             return m11*m22*m33 + m12*m23*m31 + m13*m21*m32 - m11*m23*m32 - m12*m21*m33 - m13*m22*m31;
         }
@@ -220,21 +233,21 @@ namespace linalg
         //
         void normalize();
         
-        mat3<T> operator * (const T& s) const
+        LINALG_CONSTEXPR mat3<T> operator * (const T& s) const
         {
             return mat3<T>(m11*s, m12*s, m13*s,
                            m21*s, m22*s, m23*s,
                            m31*s, m32*s, m33*s);
         }
         
-        mat3<T> operator +(const mat3<T>& m) const
+        LINALG_CONSTEXPR mat3<T> operator +(const mat3<T>& m) const
         {
             return mat3<T>(m11+m.m11, m12+m.m12, m13+m.m13,
                            m21+m.m21, m22+m.m22, m23+m.m23,
                            m31+m.m31, m32+m.m32, m33+m.m33);
         }
         
-        mat3<T> operator -(const mat3<T>& m) const
+        LINALG_CONSTEXPR mat3<T> operator -(const mat3<T>& m) const
         {
             return mat3(m11-m.m11, m12-m.m12, m13-m.m13,
                         m21-m.m21, m22-m.m22, m23-m.m23,
@@ -259,7 +272,7 @@ namespace linalg
             return *this;
         }
         
-        mat3<T> operator *(const mat3<T>& m) const
+        LINALG_CONSTEXPR mat3<T> operator *(const mat3<T>& m) const
         {
             return mat3<T>(m11*m.m11+m12*m.m21+m13*m.m31, m11*m.m12+m12*m.m22+m13*m.m32, m11*m.m13+m12*m.m23+m13*m.m33,
                            m21*m.m11+m22*m.m21+m23*m.m31, m21*m.m12+m22*m.m22+m23*m.m32, m21*m.m13+m22*m.m23+m23*m.m33,
@@ -306,42 +319,42 @@ namespace linalg
         
         mat4() { }
         
-        mat4(T d) : mat4(d,d,d,d) { }
+        LINALG_CONSTEXPR mat4(T d) : mat4(d,d,d,d) { }
         
-        mat4(const T& d0, const T& d1, const T& d2, const T& d3)
+        LINALG_CONSTEXPR mat4(const T& d0, const T& d1, const T& d2, const T& d3) :
+        m11(d0),  m21(0.0), m31(0.0), m41(0.0),
+        m12(0.0), m22(d1),  m32(0.0), m42(0.0),
+        m13(0.0), m23(0.0), m33(d2),  m43(0.0),
+        m14(0.0), m24(0.0), m34(0.0), m44(d3)
         {
-            m11 = d0;  m12 = 0.0; m13 = 0.0; m14 = 0.0;
-            m21 = 0.0; m22 = d1;  m23 = 0.0; m24 = 0.0;
-            m31 = 0.0; m32 = 0.0; m33 = d2;  m34 = 0.0;
-            m41 = 0.0; m42 = 0.0; m43 = 0.0; m44 = d3;
         }
         
-        mat4(const mat3<T> &m)
+        LINALG_CONSTEXPR mat4(const mat3<T> &m) :
+        m11(m.m11), m21(m.m21), m31(m.m31), m41(0.0),
+        m12(m.m12), m22(m.m22), m32(m.m32), m42(0.0),
+        m13(m.m13), m23(m.m23), m33(m.m33), m43(0.0),
+        m14(0.0),   m24(0.0),   m34(0.0),   m44(1.0)
         {
-            m11 = m.m11; m12 = m.m12; m13 = m.m13; m14 = 0.0;
-            m21 = m.m21; m22 = m.m22; m23 = m.m23; m24 = 0.0;
-            m31 = m.m31; m32 = m.m32; m33 = m.m33; m34 = 0.0;
-            m41 = 0.0;   m42 = 0.0;   m43 = 0.0;   m44 = 1.0;
         }
         
         /**
          * row-major per-element constructor
          */
-        mat4(const T& _m11, const T& _m12, const T& _m13, const T& _m14,
-             const T& _m21, const T& _m22, const T& _m23, const T& _m24,
-             const T& _m31, const T& _m32, const T& _m33, const T& _m34,
-             const T& _m41, const T& _m42, const T& _m43, const T& _m44)
-        { 
-			m11 = _m11; m12 = _m12; m13 = _m13; m14 = _m14;
-			m21 = _m21; m22 = _m22; m23 = _m23; m24 = _m24;
-			m31 = _m31; m32 = _m32; m33 = _m33; m34 = _m34;
-			m41 = _m41; m42 = _m42; m43 = _m43; m44 = _m44;
+        LINALG_CONSTEXPR mat4(const T& _m11, const T& _m12, const T& _m13, const T& _m14,
+                              const T& _m21, const T& _m22, const T& _m23, const T& _m24,
+                              const T& _m31, const T& _m32, const T& _m33, const T& _m34,
+                              const T& _m41, const T& _m42, const T& _m43, const T& _m44) :
+        m11(_m11), m21(_m21), m31(_m31), m41(_m41),
+        m12(_m12), m22(_m22), m32(_m32), m42(_m42),
+        m13(_m13), m23(_m23), m33(_m33), m43(_m43),
+        m14(_m14), m24(_m24), m34(_m34), m44(_m44)
+        {
 		}
         
 		//
 		// get the upper-left submatrix
 		//
-        mat3<T> get_3x3() const
+        LINALG_CONSTEXPR mat3<T> get_3x3() const
         {
             return mat3<T>(m11, m12, m13, m21, m22, m23, m31, m32, m33);
         }
@@ -356,30 +369,48 @@ namespace linalg
             std::swap(m43, m34);
         }
         
+        // general inverse, SIMD for mat4<float> with LINALG_SSE (mat.cpp)
         mat4<T> inverse() const
         {
-            T det = determinant();
-            assert(abs(det) > 1e-8);
-            T idet = 1.0/det;
+            return mat4_inverse_generic(*this);
+        }
+        
+        //
+        // inverse of an affine transform, i.e. with a last row of 0 0 0 1: the upper 3x3 is
+        // inverted by its cofactors and the translation taken back through it
+        //
+        mat4<T> affine_inverse() const
+        {
+            T c11 = m22 * m33 - m23 * m32, c21 = m23 * m31 - m21 * m33, c31 = m21 * m32 - m22 * m31;
+            T det = m11 * c11 + m12 * c21 + m13 * c31;
+            assert(std::abs(det) > 1e-8);
+            T idet = T(1)/det;
             
-            mat4<T> M = mat4<T>(m23 * m34 * m42 - m24 * m33 * m42 + m24 * m32 * m43 - m22 * m34 * m43 - m23 * m32 * m44 + m22 * m33 * m44,
-                                m14 * m33 * m42 - m13 * m34 * m42 - m14 * m32 * m43 + m12 * m34 * m43 + m13 * m32 * m44 - m12 * m33 * m44,
-                                m13 * m24 * m42 - m14 * m23 * m42 + m14 * m22 * m43 - m12 * m24 * m43 - m13 * m22 * m44 + m12 * m23 * m44,
-                                m14 * m23 * m32 - m13 * m24 * m32 - m14 * m22 * m33 + m12 * m24 * m33 + m13 * m22 * m34 - m12 * m23 * m34,
-                                m24 * m33 * m41 - m23 * m34 * m41 - m24 * m31 * m43 + m21 * m34 * m43 + m23 * m31 * m44 - m21 * m33 * m44,
-                                m13 * m34 * m41 - m14 * m33 * m41 + m14 * m31 * m43 - m11 * m34 * m43 - m13 * m31 * m44 + m11 * m33 * m44,
-                                m14 * m23 * m41 - m13 * m24 * m41 - m14 * m21 * m43 + m11 * m24 * m43 + m13 * m21 * m44 - m11 * m23 * m44,
-                                m13 * m24 * m31 - m14 * m23 * m31 + m14 * m21 * m33 - m11 * m24 * m33 - m13 * m21 * m34 + m11 * m23 * m34,
-                                m22 * m34 * m41 - m24 * m32 * m41 + m24 * m31 * m42 - m21 * m34 * m42 - m22 * m31 * m44 + m21 * m32 * m44,
-                                m14 * m32 * m41 - m12 * m34 * m41 - m14 * m31 * m42 + m11 * m34 * m42 + m12 * m31 * m44 - m11 * m32 * m44,
-                                m12 * m24 * m41 - m14 * m22 * m41 + m14 * m21 * m42 - m11 * m24 * m42 - m12 * m21 * m44 + m11 * m22 * m44,
-                                m14 * m22 * m31 - m12 * m24 * m31 - m14 * m21 * m32 + m11 * m24 * m32 + m12 * m21 * m34 - m11 * m22 * m34,
-                                m23 * m32 * m41 - m22 * m33 * m41 - m23 * m31 * m42 + m21 * m33 * m42 + m22 * m31 * m43 - m21 * m32 * m43,
-                                m12 * m33 * m41 - m13 * m32 * m41 + m13 * m31 * m42 - m11 * m33 * m42 - m12 * m31 * m43 + m11 * m32 * m43,
-                                m13 * m22 * m41 - m12 * m23 * m41 - m13 * m21 * m42 + m11 * m23 * m42 + m12 * m21 * m43 - m11 * m22 * m43,
-                                m12 * m23 * m31 - m13 * m22 * m31 + m13 * m21 * m32 - m11 * m23 * m32 - m12 * m21 * m33 + m11 * m22 * m33);
+            mat4<T> M;
+            M.m11 = c11 * idet; M.m12 = (m13 * m32 - m12 * m33) * idet; M.m13 = (m12 * m23 - m13 * m22) * idet;
+            M.m21 = c21 * idet; M.m22 = (m11 * m33 - m13 * m31) * idet; M.m23 = (m13 * m21 - m11 * m23) * idet;
+            M.m31 = c31 * idet; M.m32 = (m12 * m31 - m11 * m32) * idet; M.m33 = (m11 * m22 - m12 * m21) * idet;
+            M.m14 = -(M.m11 * m14 + M.m12 * m24 + M.m13 * m34);
+            M.m24 = -(M.m21 * m14 + M.m22 * m24 + M.m23 * m34);
+            M.m34 = -(M.m31 * m14 + M.m32 * m24 + M.m33 * m34);
+            M.m41 = 0.0; M.m42 = 0.0; M.m43 = 0.0; M.m44 = 1.0;
             
-            return M*idet;
+            return M;
+        }
+        
+        //
+        // inverse of a rigid transform, a rotation (orthonormal upper 3x3) and a translation:
+        // the transposed rotation and the translation taken back through it
+        //
+        mat4<T> orthonormal_inverse() const
+        {
+            mat4<T> M;
+            M.m11 = m11; M.m12 = m21; M.m13 = m31; M.m14 = -(m11 * m14 + m21 * m24 + m31 * m34);
+            M.m21 = m12; M.m22 = m22; M.m23 = m32; M.m24 = -(m12 * m14 + m22 * m24 + m32 * m34);
+            M.m31 = m13; M.m32 = m23; M.m33 = m33; M.m34 = -(m13 * m14 + m23 * m24 + m33 * m34);
+            M.m41 = 0.0; M.m42 = 0.0; M.m43 = 0.0; M.m44 = 1.0;
+            
+            return M;
         }
         
         T determinant() const
@@ -448,56 +479,45 @@ namespace linalg
         
         mat4<T> operator *(const mat4<T>& m) const
         {
-            return mat4<T>(m11 * m.m11 + m12 * m.m21 + m13 * m.m31 + m14 * m.m41,
-                           m11 * m.m12 + m12 * m.m22 + m13 * m.m32 + m14 * m.m42,
-                           m11 * m.m13 + m12 * m.m23 + m13 * m.m33 + m14 * m.m43,
-                           m11 * m.m14 + m12 * m.m24 + m13 * m.m34 + m14 * m.m44,
-                           
-                           m21 * m.m11 + m22 * m.m21 + m23 * m.m31 + m24 * m.m41,
-                           m21 * m.m12 + m22 * m.m22 + m23 * m.m32 + m24 * m.m42,
-                           m21 * m.m13 + m22 * m.m23 + m23 * m.m33 + m24 * m.m43,
-                           m21 * m.m14 + m22 * m.m24 + m23 * m.m34 + m24 * m.m44,
-                           
-                           m31 * m.m11 + m32 * m.m21 + m33 * m.m31 + m34 * m.m41,
-                           m31 * m.m12 + m32 * m.m22 + m33 * m.m32 + m34 * m.m42,
-                           m31 * m.m13 + m32 * m.m23 + m33 * m.m33 + m34 * m.m43,
-                           m31 * m.m14 + m32 * m.m24 + m33 * m.m34 + m34 * m.m44,
-                           
-                           m41 * m.m11 + m42 * m.m21 + m43 * m.m31 + m44 * m.m41,
-                           m41 * m.m12 + m42 * m.m22 + m43 * m.m32 + m44 * m.m42,
-                           m41 * m.m13 + m42 * m.m23 + m43 * m.m33 + m44 * m.m43,
-                           m41 * m.m14 + m42 * m.m24 + m43 * m.m34 + m44 * m.m44);
+            return mat4_mul_generic(*this, m);
         }
         
+        // defined in mat.cpp, or inline below for mat4<float> with LINALG_SSE
         vec4<T> operator *(const vec4<T> &v) const;
         
-        static mat4<T> translation(const vec3<T>& p)
+        //
+        // identity, translation, scaling & the GL projections are constexpr (LINALG_CONSTEXPR), and
+        // mat4_mul_generic composes them at compile time; the rotations need cos & sin
+        //
+        static LINALG_CONSTEXPR mat4<T> identity()
+        {
+            return mat4<T>(1.0);
+        }
+        
+        static LINALG_CONSTEXPR mat4<T> translation(const vec3<T>& p)
         {
             return translation(p.x, p.y, p.z);
         }
         
-        static mat4<T> translation(const T& x, const T& y, const T& z)
+        static LINALG_CONSTEXPR mat4<T> translation(const T& x, const T& y, const T& z)
         {
-            mat4<T> M;
-            M.m11 = 1.0; M.m12 = 0.0; M.m13 = 0; M.m14 = x;
-            M.m21 = 0.0; M.m22 = 1.0; M.m23 = 0; M.m24 = y;
-            M.m31 = 0.0; M.m32 = 0.0; M.m33 = 1; M.m34 = z;
-            M.m41 = 0.0; M.m42 = 0.0; M.m43 = 0; M.m44 = 1.0;
-            
-            return M;
+            return mat4<T>(1.0, 0.0, 0, x,
+                           0.0, 1.0, 0, y,
+                           0.0, 0.0, 1, z,
+                           0.0, 0.0, 0, 1.0);
         }
         
-        static mat4<T> scaling(const T& s)
+        static LINALG_CONSTEXPR mat4<T> scaling(const T& s)
         {
             return scaling({s,s,s});
         }
         
-        static mat4<T> scaling(float sx, float sy, float sz)
+        static LINALG_CONSTEXPR mat4<T> scaling(float sx, float sy, float sz)
         {
             return mat4<T>(sx, sy, sz, 1.0);
         }
         
-        static mat4<T> scaling(const vec3<T> &sv)
+        static LINALG_CONSTEXPR mat4<T> scaling(const vec3<T> &sv)
         {
             return mat4<T>(sv.x, sv.y, sv.z, 1.0);
         }
@@ -571,17 +591,12 @@ namespace linalg
         // 
         // frustum planes not necessarily symmetric in the y=0 and x=0 planes of the view frame
         //
-        static mat4<T> GL_asymmetric_projection(const T& l, const T& r, const T& b, const T& t, const T& n, const T& f)
+        static LINALG_CONSTEXPR mat4<T> GL_asymmetric_projection(const T& l, const T& r, const T& b, const T& t, const T& n, const T& f)
         {
-            T n2 = 2.0f*n;
-            T rl = r - l;
-            T tb = t - b;
-            T fn = f - n;
-            
-            return mat4<T>(n2/rl,   0.0f,   (r+l)/rl,   0.0f,
-                           0.0f,    n2/tb,  (t+b)/tb,   0.0f,
-                           0.0f,    0.0f,   (-f- n)/fn, (-n2*f)/fn,
-                           0.0f,    0.0f,   -1.0f,      0.0f);
+            return mat4<T>(2.0f*n/(r-l), 0.0f,         (r+l)/(r-l),    0.0f,
+                           0.0f,         2.0f*n/(t-b), (t+b)/(t-b),    0.0f,
+                           0.0f,         0.0f,         (-f- n)/(f-n),  -2.0f*n*f/(f-n),
+                           0.0f,         0.0f,         -1.0f,          0.0f);
         }
         
         //
@@ -589,15 +604,12 @@ namespace linalg
         // 
         // frustum planes are symmetric in the y=0 and x=0 planes of the view frame
         //
-        static mat4<T> GL_symmetric_projection(const T& r, const T& t, const T& n, const T& f)
+        static LINALG_CONSTEXPR mat4<T> GL_symmetric_projection(const T& r, const T& t, const T& n, const T& f)
         {
-            T n2 = 2.0f*n;
-            T fn = f - n;
-
-            return mat4<T>(n/r,   0.0f, 0.0f,       0.0f,
-                           0.0f,  n/t,  0.0f,       0.0f,
-                           0.0f,  0.0f, (-f- n)/fn, (-n2*f)/fn,
-                           0.0f,  0.0f, -1.0f,      0.0f);
+            return mat4<T>(n/r,   0.0f, 0.0f,          0.0f,
+                           0.0f,  n/t,  0.0f,          0.0f,
+                           0.0f,  0.0f, (-f- n)/(f-n), -2.0f*n*f/(f-n),
+                           0.0f,  0.0f, -1.0f,         0.0f);
         }
         
         //
@@ -640,6 +652,122 @@ namespace linalg
         return out;
     }
 
+    //
+    // generic 4x4 products, which mat4<T>::operator* uses except where mat4<float> has a
+    // SIMD specialization (below); constexpr, for products of constant matrices
+    //
+    template<class T>
+    inline LINALG_CONSTEXPR mat4<T> mat4_mul_generic(const mat4<T>& a, const mat4<T>& b)
+    {
+        return mat4<T>(a.m11 * b.m11 + a.m12 * b.m21 + a.m13 * b.m31 + a.m14 * b.m41,
+                       a.m11 * b.m12 + a.m12 * b.m22 + a.m13 * b.m32 + a.m14 * b.m42,
+                       a.m11 * b.m13 + a.m12 * b.m23 + a.m13 * b.m33 + a.m14 * b.m43,
+                       a.m11 * b.m14 + a.m12 * b.m24 + a.m13 * b.m34 + a.m14 * b.m44,
+                       
+                       a.m21 * b.m11 + a.m22 * b.m21 + a.m23 * b.m31 + a.m24 * b.m41,
+                       a.m21 * b.m12 + a.m22 * b.m22 + a.m23 * b.m32 + a.m24 * b.m42,
+                       a.m21 * b.m13 + a.m22 * b.m23 + a.m23 * b.m33 + a.m24 * b.m43,
+                       a.m21 * b.m14 + a.m22 * b.m24 + a.m23 * b.m34 + a.m24 * b.m44,
+                       
+                       a.m31 * b.m11 + a.m32 * b.m21 + a.m33 * b.m31 + a.m34 * b.m41,
+                       a.m31 * b.m12 + a.m32 * b.m22 + a.m33 * b.m32 + a.m34 * b.m42,
+                       a.m31 * b.m13 + a.m32 * b.m23 + a.m33 * b.m33 + a.m34 * b.m43,
+                       a.m31 * b.m14 + a.m32 * b.m24 + a.m33 * b.m34 + a.m34 * b.m44,
+                       
+                       a.m41 * b.m11 + a.m42 * b.m21 + a.m43 * b.m31 + a.m44 * b.m41,
+                       a.m41 * b.m12 + a.m42 * b.m22 + a.m43 * b.m32 + a.m44 * b.m42,
+                       a.m41 * b.m13 + a.m42 * b.m23 + a.m43 * b.m33 + a.m44 * b.m43,
+                       a.m41 * b.m14 + a.m42 * b.m24 + a.m43 * b.m34 + a.m44 * b.m44);
+    }
+    
+    template<class T>
+    inline LINALG_CONSTEXPR vec4<T> mat4_mul_generic(const mat4<T>& a, const vec4<T>& v)
+    {
+        return vec4<T>(a.m11*v.x + a.m12*v.y + a.m13*v.z + a.m14*v.w,
+                       a.m21*v.x + a.m22*v.y + a.m23*v.z + a.m24*v.w,
+                       a.m31*v.x + a.m32*v.y + a.m33*v.z + a.m34*v.w,
+                       a.m41*v.x + a.m42*v.y + a.m43*v.z + a.m44*v.w);
+    }
+    
+    //
+    // generic inverse by the full cofactor expansion, used by mat4<T>::inverse except for
+    // mat4<float> with LINALG_SSE
+    //
+    template<class T>
+    inline mat4<T> mat4_inverse_generic(const mat4<T>& a)
+    {
+        T det = a.determinant();
+        assert(abs(det) > 1e-8);
+        T idet = 1.0/det;
+        
+        mat4<T> M = mat4<T>(a.m23 * a.m34 * a.m42 - a.m24 * a.m33 * a.m42 + a.m24 * a.m32 * a.m43 - a.m22 * a.m34 * a.m43 - a.m23 * a.m32 * a.m44 + a.m22 * a.m33 * a.m44,
+                            a.m14 * a.m33 * a.m42 - a.m13 * a.m34 * a.m42 - a.m14 * a.m32 * a.m43 + a.m12 * a.m34 * a.m43 + a.m13 * a.m32 * a.m44 - a.m12 * a.m33 * a.m44,
+                            a.m13 * a.m24 * a.m42 - a.m14 * a.m23 * a.m42 + a.m14 * a.m22 * a.m43 - a.m12 * a.m24 * a.m43 - a.m13 * a.m22 * a.m44 + a.m12 * a.m23 * a.m44,
+                            a.m14 * a.m23 * a.m32 - a.m13 * a.m24 * a.m32 - a.m14 * a.m22 * a.m33 + a.m12 * a.m24 * a.m33 + a.m13 * a.m22 * a.m34 - a.m12 * a.m23 * a.m34,
+                            a.m24 * a.m33 * a.m41 - a.m23 * a.m34 * a.m41 - a.m24 * a.m31 * a.m43 + a.m21 * a.m34 * a.m43 + a.m23 * a.m31 * a.m44 - a.m21 * a.m33 * a.m44,
+                            a.m13 * a.m34 * a.m41 - a.m14 * a.m33 * a.m41 + a.m14 * a.m31 * a.m43 - a.m11 * a.m34 * a.m43 - a.m13 * a.m31 * a.m44 + a.m11 * a.m33 * a.m44,
+                            a.m14 * a.m23 * a.m41 - a.m13 * a.m24 * a.m41 - a.m14 * a.m21 * a.m43 + a.m11 * a.m24 * a.m43 + a.m13 * a.m21 * a.m44 - a.m11 * a.m23 * a.m44,
+                            a.m13 * a.m24 * a.m31 - a.m14 * a.m23 * a.m31 + a.m14 * a.m21 * a.m33 - a.m11 * a.m24 * a.m33 - a.m13 * a.m21 * a.m34 + a.m11 * a.m23 * a.m34,
+                            a.m22 * a.m34 * a.m41 - a.m24 * a.m32 * a.m41 + a.m24 * a.m31 * a.m42 - a.m21 * a.m34 * a.m42 - a.m22 * a.m31 * a.m44 + a.m21 * a.m32 * a.m44,
+                            a.m14 * a.m32 * a.m41 - a.m12 * a.m34 * a.m41 - a.m14 * a.m31 * a.m42 + a.m11 * a.m34 * a.m42 + a.m12 * a.m31 * a.m44 - a.m11 * a.m32 * a.m44,
+                            a.m12 * a.m24 * a.m41 - a.m14 * a.m22 * a.m41 + a.m14 * a.m21 * a.m42 - a.m11 * a.m24 * a.m42 - a.m12 * a.m21 * a.m44 + a.m11 * a.m22 * a.m44,
+                            a.m14 * a.m22 * a.m31 - a.m12 * a.m24 * a.m31 - a.m14 * a.m21 * a.m32 + a.m11 * a.m24 * a.m32 + a.m12 * a.m21 * a.m34 - a.m11 * a.m22 * a.m34,
+                            a.m23 * a.m32 * a.m41 - a.m22 * a.m33 * a.m41 - a.m23 * a.m31 * a.m42 + a.m21 * a.m33 * a.m42 + a.m22 * a.m31 * a.m43 - a.m21 * a.m32 * a.m43,
+                            a.m12 * a.m33 * a.m41 - a.m13 * a.m32 * a.m41 + a.m13 * a.m31 * a.m42 - a.m11 * a.m33 * a.m42 - a.m12 * a.m31 * a.m43 + a.m11 * a.m32 * a.m43,
+                            a.m13 * a.m22 * a.m41 - a.m12 * a.m23 * a.m41 - a.m13 * a.m21 * a.m42 + a.m11 * a.m23 * a.m42 + a.m12 * a.m21 * a.m43 - a.m11 * a.m22 * a.m43,
+                            a.m12 * a.m23 * a.m31 - a.m13 * a.m22 * a.m31 + a.m13 * a.m21 * a.m32 - a.m11 * a.m23 * a.m32 - a.m12 * a.m21 * a.m33 + a.m11 * a.m22 * a.m33);
+        
+        return M*idet;
+    }
+    
+#ifdef LINALG_SSE
+    template<> mat4<float> mat4<float>::inverse() const;
+    
+    //
+    // SIMD products: column j of A*B is A.col[0]*B[0][j] + ... + A.col[3]*B[3][j], summed in the
+    // order of the generic code. Columns are loaded unaligned, mat4f has no alignment requirement.
+    //
+    inline __m128 mat4_mul_columns(const float* a, __m128 v)
+    {
+        __m128 r = _mm_mul_ps(_mm_loadu_ps(a), _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(a + 4), _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(a + 8), _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+        return _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(a + 12), _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+    }
+    
+    template<>
+    inline vec4<float> mat4<float>::operator *(const vec4<float>& v) const
+    {
+        vec4<float> r;
+        _mm_storeu_ps(r.vec, mat4_mul_columns(array, _mm_loadu_ps(v.vec)));
+        return r;
+    }
+    
+    template<>
+    inline mat4<float> mat4<float>::operator *(const mat4<float>& m) const
+    {
+        mat4<float> r;
+#ifdef LINALG_AVX
+        // two columns of the result at a time
+        const __m256 a0 = _mm256_broadcast_ps((const __m128*)array), a1 = _mm256_broadcast_ps((const __m128*)(array + 4));
+        const __m256 a2 = _mm256_broadcast_ps((const __m128*)(array + 8)), a3 = _mm256_broadcast_ps((const __m128*)(array + 12));
+        for (int j = 0; j < 4; j += 2)
+        {
+            __m256 b = _mm256_loadu_ps(m.array + j * 4);
+            __m256 c = _mm256_mul_ps(a0, _mm256_shuffle_ps(b, b, _MM_SHUFFLE(0, 0, 0, 0)));
+            c = _mm256_add_ps(c, _mm256_mul_ps(a1, _mm256_shuffle_ps(b, b, _MM_SHUFFLE(1, 1, 1, 1))));
+            c = _mm256_add_ps(c, _mm256_mul_ps(a2, _mm256_shuffle_ps(b, b, _MM_SHUFFLE(2, 2, 2, 2))));
+            c = _mm256_add_ps(c, _mm256_mul_ps(a3, _mm256_shuffle_ps(b, b, _MM_SHUFFLE(3, 3, 3, 3))));
+            _mm256_storeu_ps(r.array + j * 4, c);
+        }
+#else
+        for (int j = 0; j < 4; j++)
+            _mm_storeu_ps(r.array + j * 4, mat4_mul_columns(array, _mm_loadu_ps(m.array + j * 4)));
+#endif
+        return r;
+    }
+#endif
+    
     template<class T>
     inline mat4<T> transpose(const mat4<T>& m)
     {
@@ -655,12 +783,12 @@ namespace linalg
     //
     // compile-time instances
     //
-    const mat2f mat2f_zero = mat2f(0.0f);
-    const mat3f mat3f_zero = mat3f(0.0f);
-    const mat4f mat4f_zero = mat4f(0.0f);
-    const mat2f mat2f_identity = mat2f(1.0f);
-    const mat3f mat3f_identity = mat3f(1.0f);
-    const mat4f mat4f_identity = mat4f(1.0f);
+    LINALG_CONSTEXPR const mat2f mat2f_zero = mat2f(0.0f, 0.0f);
+    LINALG_CONSTEXPR const mat3f mat3f_zero = mat3f(0.0f);
+    LINALG_CONSTEXPR const mat4f mat4f_zero = mat4f(0.0f);
+    LINALG_CONSTEXPR const mat2f mat2f_identity = mat2f(1.0f, 1.0f);
+    LINALG_CONSTEXPR const mat3f mat3f_identity = mat3f(1.0f);
+    LINALG_CONSTEXPR const mat4f mat4f_identity = mat4f(1.0f);
 }
 
 #endif /* MAT_H */
@@ -0,0 +1,147 @@
+//
+//	quat.cpp
+//
+
+#include "quat.h"
+
+namespace linalg
+{
+    static_assert(sizeof(quatf) == 4 * sizeof(float), "quatf arrays are read as packed floats");
+    static_assert(sizeof(mat4f) == 16 * sizeof(float), "mat4f arrays are written as packed floats");
+
+#ifdef LINALG_SSE
+    //
+    // four quaternions in SoA registers
+    //
+    struct sse_quat_t
+    {
+        __m128 x, y, z, w;
+
+        void load(const quatf* q)
+        {
+            x = _mm_loadu_ps(q[0].q);
+            y = _mm_loadu_ps(q[1].q);
+            z = _mm_loadu_ps(q[2].q);
+            w = _mm_loadu_ps(q[3].q);
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+        }
+
+        void store(quatf* q) const
+        {
+            __m128 a = x, b = y, c = z, d = w;
+            _MM_TRANSPOSE4_PS(a, b, c, d);
+            _mm_storeu_ps(q[0].q, a);
+            _mm_storeu_ps(q[1].q, b);
+            _mm_storeu_ps(q[2].q, c);
+            _mm_storeu_ps(q[3].q, d);
+        }
+    };
+
+    static inline __m128 sse_dot(const sse_quat_t& a, const sse_quat_t& b)
+    {
+        return _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z)), _mm_mul_ps(a.w, b.w));
+    }
+
+    // a x b + c y d + ..., left to right as in quat<T>::operator*
+    static inline __m128 sse_sum4(__m128 a0, __m128 b0, __m128 a1, __m128 b1, __m128 a2, __m128 b2, __m128 a3, __m128 b3, bool add1, bool add2, bool add3)
+    {
+        __m128 r = _mm_mul_ps(a0, b0);
+        r = add1 ? _mm_add_ps(r, _mm_mul_ps(a1, b1)) : _mm_sub_ps(r, _mm_mul_ps(a1, b1));
+        r = add2 ? _mm_add_ps(r, _mm_mul_ps(a2, b2)) : _mm_sub_ps(r, _mm_mul_ps(a2, b2));
+        return add3 ? _mm_add_ps(r, _mm_mul_ps(a3, b3)) : _mm_sub_ps(r, _mm_mul_ps(a3, b3));
+    }
+
+    static inline void sse_mul(const sse_quat_t& a, const sse_quat_t& b, sse_quat_t& r)
+    {
+        r.x = sse_sum4(a.w, b.x, a.x, b.w, a.y, b.z, a.z, b.y, true, true, false);
+        r.y = sse_sum4(a.w, b.y, a.x, b.z, a.y, b.w, a.z, b.x, false, true, true);
+        r.z = sse_sum4(a.w, b.z, a.x, b.y, a.y, b.x, a.z, b.w, true, false, true);
+        r.w = sse_sum4(a.w, b.w, a.x, b.x, a.y, b.y, a.z, b.z, false, false, false);
+    }
+#endif
+
+    void quat_mul(const quatf* a, const quatf* b, quatf* out, size_t n)
+    {
+        size_t i = 0;
+#ifdef LINALG_SSE
+        for (; i + 4 <= n; i += 4)
+        {
+            sse_quat_t qa, qb, r;
+            qa.load(a + i);
+            qb.load(b + i);
+            sse_mul(qa, qb, r);
+            r.store(out + i);
+        }
+#endif
+        for (; i < n; i++)
+            out[i] = a[i] * b[i];
+    }
+
+    void quat_nlerp(const quatf* a, const quatf* b, float t, quatf* out, size_t n)
+    {
+        size_t i = 0;
+#ifdef LINALG_SSE
+        const __m128 t0 = _mm_set1_ps(1.0f - t), t1 = _mm_set1_ps(t), sign = _mm_set1_ps(-0.0f);
+        for (; i + 4 <= n; i += 4)
+        {
+            sse_quat_t qa, qb, r;
+            qa.load(a + i);
+            qb.load(b + i);
+
+            // -t where the quaternions are on opposite hemispheres, for the shorter arc
+            __m128 s = _mm_xor_ps(t1, _mm_and_ps(_mm_cmplt_ps(sse_dot(qa, qb), _mm_setzero_ps()), sign));
+            r.x = _mm_add_ps(_mm_mul_ps(qa.x, t0), _mm_mul_ps(qb.x, s));
+            r.y = _mm_add_ps(_mm_mul_ps(qa.y, t0), _mm_mul_ps(qb.y, s));
+            r.z = _mm_add_ps(_mm_mul_ps(qa.z, t0), _mm_mul_ps(qb.z, s));
+            r.w = _mm_add_ps(_mm_mul_ps(qa.w, t0), _mm_mul_ps(qb.w, s));
+
+            // normalize, the identity where the length is (near) zero
+            __m128 norm2 = sse_dot(r, r), valid = _mm_cmpge_ps(norm2, _mm_set1_ps(1.0e-8f));
+            __m128 is = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(norm2)), valid);
+            r.x = _mm_mul_ps(r.x, is);
+            r.y = _mm_mul_ps(r.y, is);
+            r.z = _mm_mul_ps(r.z, is);
+            r.w = _mm_or_ps(_mm_mul_ps(r.w, is), _mm_andnot_ps(valid, _mm_set1_ps(1.0f)));
+            r.store(out + i);
+        }
+#endif
+        for (; i < n; i++)
+            out[i] = nlerp(a[i], b[i], t);
+    }
+
+    void quat_to_mat4(const quatf* q, mat4f* out, size_t n)
+    {
+        size_t i = 0;
+#ifdef LINALG_SSE
+        const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), zero = _mm_setzero_ps();
+        for (; i + 4 <= n; i += 4)
+        {
+            sse_quat_t r;
+            r.load(q + i);
+
+            __m128 xx = _mm_mul_ps(r.x, r.x), yy = _mm_mul_ps(r.y, r.y), zz = _mm_mul_ps(r.z, r.z);
+            __m128 xy = _mm_mul_ps(r.x, r.y), xz = _mm_mul_ps(r.x, r.z), yz = _mm_mul_ps(r.y, r.z);
+            __m128 wx = _mm_mul_ps(r.w, r.x), wy = _mm_mul_ps(r.w, r.y), wz = _mm_mul_ps(r.w, r.z);
+
+            // the columns of the four matrices, transposed back to one matrix per element
+            __m128 c[3][4] =
+            {
+                { _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), _mm_mul_ps(two, _mm_add_ps(xy, wz)), _mm_mul_ps(two, _mm_sub_ps(xz, wy)), zero },
+                { _mm_mul_ps(two, _mm_sub_ps(xy, wz)), _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), _mm_mul_ps(two, _mm_add_ps(yz, wx)), zero },
+                { _mm_mul_ps(two, _mm_add_ps(xz, wy)), _mm_mul_ps(two, _mm_sub_ps(yz, wx)), _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), zero }
+            };
+            for (int j = 0; j < 3; j++)
+            {
+                _MM_TRANSPOSE4_PS(c[j][0], c[j][1], c[j][2], c[j][3]);
+                for (int k = 0; k < 4; k++)
+                    _mm_storeu_ps(out[i + k].array + j * 4, c[j][k]);
+            }
+            const __m128 w_col = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+            for (int k = 0; k < 4; k++)
+                _mm_storeu_ps(out[i + k].array + 12, w_col);
+        }
+#endif
+        for (; i < n; i++)
+            out[i] = q[i].to_mat4();
+    }
+}
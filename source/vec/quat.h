@@ -0,0 +1,387 @@
+//
+//	quat.h
+//	quaternions & dual quaternions
+//
+//  Unit quaternions for rotations and unit dual quaternions for rigid transforms (rotation then
+//  translation), in 4 and 8 floats instead of the 16 of a mat4. Same conventions as mat.h:
+//  quat<T>::rotation(theta, axis).to_mat4() is mat4<T>::rotation(theta, axis), and a * b rotates
+//  by b first, then by a. Batched operations over arrays of quatf, SSE where available
+//  (LINALG_SSE), are in quat.cpp.
+//
+
+#pragma once
+#ifndef QUAT_H
+#define QUAT_H
+
+#include <cstddef>
+#include "vec.h"
+#include "mat.h"
+
+namespace linalg
+{
+    //
+    // quaternion w + x i + y j + z k, stored x y z w
+    //
+    template<class T> class quat
+    {
+    public:
+        union
+        {
+            T q[4];
+            struct { T x, y, z, w; };
+        };
+
+        //
+        // constructor: identity rotation
+        //
+        quat()
+        {
+            x = y = z = 0;
+            w = 1;
+        }
+
+        quat(const T& x, const T& y, const T& z, const T& w)
+        {
+            this->x = x;
+            this->y = y;
+            this->z = z;
+            this->w = w;
+        }
+
+        quat(const vec3<T>& v, const T& w)
+        {
+            x = v.x;
+            y = v.y;
+            z = v.z;
+            this->w = w;
+        }
+
+        vec3<T> xyz() const
+        {
+            return vec3<T>(x, y, z);
+        }
+
+        //
+        // rotation theta around the axis (x,y,z): (sin(theta/2) u, cos(theta/2))
+        //
+        // notes: u should be normalized
+        //
+        static quat<T> rotation(const T& theta, const T& x, const T& y, const T& z)
+        {
+            T s = std::sin(theta * T(0.5));
+            return quat<T>(x*s, y*s, z*s, std::cos(theta * T(0.5)));
+        }
+
+        static quat<T> rotation(const T& theta, const vec3<T>& v)
+        {
+            return rotation(theta, v.x, v.y, v.z);
+        }
+
+        //
+        // from a rotation matrix, by its largest diagonal term (Shepperd) so the divisor stays
+        // away from zero
+        //
+        static quat<T> from_matrix(const mat3<T>& m)
+        {
+            T trace = m.m11 + m.m22 + m.m33;
+            if (trace > 0)
+            {
+                T s = std::sqrt(trace + T(1)) * T(2);
+                return quat<T>((m.m32 - m.m23) / s, (m.m13 - m.m31) / s, (m.m21 - m.m12) / s, s * T(0.25));
+            }
+            if (m.m11 > m.m22 && m.m11 > m.m33)
+            {
+                T s = std::sqrt(T(1) + m.m11 - m.m22 - m.m33) * T(2);
+                return quat<T>(s * T(0.25), (m.m12 + m.m21) / s, (m.m13 + m.m31) / s, (m.m32 - m.m23) / s);
+            }
+            if (m.m22 > m.m33)
+            {
+                T s = std::sqrt(T(1) + m.m22 - m.m11 - m.m33) * T(2);
+                return quat<T>((m.m12 + m.m21) / s, s * T(0.25), (m.m23 + m.m32) / s, (m.m13 - m.m31) / s);
+            }
+            T s = std::sqrt(T(1) + m.m33 - m.m11 - m.m22) * T(2);
+            return quat<T>((m.m13 + m.m31) / s, (m.m23 + m.m32) / s, s * T(0.25), (m.m21 - m.m12) / s);
+        }
+
+        // from the upper 3x3 of a rigid transform
+        static quat<T> from_matrix(const mat4<T>& m)
+        {
+            return from_matrix(m.get_3x3());
+        }
+
+        T dot(const quat<T>& r) const
+        {
+            return x*r.x + y*r.y + z*r.z + w*r.w;
+        }
+
+        T norm2() const
+        {
+            return std::sqrt(x*x + y*y + z*z + w*w);
+        }
+
+        //
+        // normalization, divide-by-zero safe (gives the identity)
+        //
+        quat<T>& normalize()
+        {
+            T normSquared = x*x + y*y + z*z + w*w;
+
+            if( normSquared < 1e-8 )
+                *this = quat<T>();
+            else
+                *this = *this * (T(1) / std::sqrt(normSquared));
+            return *this;
+        }
+
+        // the inverse of a unit quaternion
+        quat<T> conjugate() const
+        {
+            return quat<T>(-x, -y, -z, w);
+        }
+
+        quat<T> inverse() const
+        {
+            return conjugate() * (T(1) / (x*x + y*y + z*z + w*w));
+        }
+
+        //
+        // Hamilton product: the rotation r, then this one
+        //
+        quat<T> operator *(const quat<T>& r) const
+        {
+            return quat<T>(w*r.x + x*r.w + y*r.z - z*r.y,
+                           w*r.y - x*r.z + y*r.w + z*r.x,
+                           w*r.z + x*r.y - y*r.x + z*r.w,
+                           w*r.w - x*r.x - y*r.y - z*r.z);
+        }
+
+        quat<T> operator *(const T& s) const
+        {
+            return quat<T>(x*s, y*s, z*s, w*s);
+        }
+
+        quat<T> operator +(const quat<T>& r) const
+        {
+            return quat<T>(x+r.x, y+r.y, z+r.z, w+r.w);
+        }
+
+        quat<T> operator -(const quat<T>& r) const
+        {
+            return quat<T>(x-r.x, y-r.y, z-r.z, w-r.w);
+        }
+
+        quat<T> operator -() const
+        {
+            return quat<T>(-x, -y, -z, -w);
+        }
+
+        //
+        // rotate v by a unit quaternion: v + w t + u x t, with u = (x,y,z) and t = 2 u x v
+        //
+        vec3<T> rotate(const vec3<T>& v) const
+        {
+            vec3<T> u(x, y, z);
+            vec3<T> t = (u % v) * T(2);
+            return v + t * w + u % t;
+        }
+
+        //
+        // rotation matrix of a unit quaternion
+        //
+        mat3<T> to_mat3() const
+        {
+            T xx = x*x, yy = y*y, zz = z*z;
+            T xy = x*y, xz = x*z, yz = y*z;
+            T wx = w*x, wy = w*y, wz = w*z;
+
+            return mat3<T>(T(1) - T(2)*(yy + zz), T(2)*(xy - wz), T(2)*(xz + wy),
+                           T(2)*(xy + wz), T(1) - T(2)*(xx + zz), T(2)*(yz - wx),
+                           T(2)*(xz - wy), T(2)*(yz + wx), T(1) - T(2)*(xx + yy));
+        }
+
+        mat4<T> to_mat4() const
+        {
+            return mat4<T>(to_mat3());
+        }
+    };
+
+    template<class T>
+    inline T dot(const quat<T>& a, const quat<T>& b)
+    {
+        return a.x*b.x + a.y*b.y + a.z*b.z + a.w*b.w;
+    }
+
+    template<class T>
+    inline quat<T> normalize(const quat<T>& q)
+    {
+        T norm2 = q.x*q.x + q.y*q.y + q.z*q.z + q.w*q.w;
+
+        if( norm2 < 1.0e-8 )
+            return quat<T>();
+        else
+            return q * (T(1)/std::sqrt(norm2));
+    }
+
+    //
+    // normalized linear interpolation along the shorter arc: cheap and smooth, but not at constant
+    // angular speed (off by up to ~8% at t = 0.5 for a 90 degree arc)
+    //
+    template<class T>
+    inline quat<T> nlerp(const quat<T>& a, const quat<T>& b, const T& t)
+    {
+        T s = dot(a, b) < 0 ? -t : t;
+        return normalize(a * (T(1) - t) + b * s);
+    }
+
+    //
+    // spherical linear interpolation along the shorter arc, at constant angular speed; nlerp where
+    // the arc is too short for sin() to divide by
+    //
+    template<class T>
+    inline quat<T> slerp(const quat<T>& a, const quat<T>& b, const T& t)
+    {
+        T d = dot(a, b);
+        quat<T> c = d < 0 ? -b : b;
+        d = std::abs(d);
+        if (d > T(0.9995))
+            return nlerp(a, c, t);
+
+        T theta = std::acos(d), is = T(1) / std::sin(theta);
+        return a * (std::sin((T(1) - t) * theta) * is) + c * (std::sin(t * theta) * is);
+    }
+
+    template<class T>
+    inline std::ostream& operator << (std::ostream &out, const quat<T> &q)
+    {
+        return out << "(" << q.x << ", " << q.y << ", " << q.z << ", " << q.w << ")";
+    }
+
+    //
+    // dual quaternion real + e dual (e^2 = 0). For a rotation r followed by a translation t,
+    // real = r and dual = (t, 0) r / 2.
+    //
+    template<class T> class dualquat
+    {
+    public:
+        quat<T> real, dual;
+
+        //
+        // constructor: identity transform
+        //
+        dualquat() : dual(0, 0, 0, 0) { }
+
+        dualquat(const quat<T>& real, const quat<T>& dual) : real(real), dual(dual) { }
+
+        //
+        // constructor: rotation r, then translation t
+        //
+        dualquat(const quat<T>& r, const vec3<T>& t) : real(r), dual(quat<T>(t, 0) * r * T(0.5)) { }
+
+        // from a rigid transform
+        static dualquat<T> from_matrix(const mat4<T>& m)
+        {
+            return dualquat<T>(quat<T>::from_matrix(m), vec3<T>(m.m14, m.m24, m.m34));
+        }
+
+        vec3<T> translation() const
+        {
+            return (dual * real.conjugate()).xyz() * T(2);
+        }
+
+        //
+        // the transform b, then this one
+        //
+        dualquat<T> operator *(const dualquat<T>& b) const
+        {
+            return dualquat<T>(real * b.real, real * b.dual + dual * b.real);
+        }
+
+        dualquat<T> operator *(const T& s) const
+        {
+            return dualquat<T>(real * s, dual * s);
+        }
+
+        dualquat<T> operator +(const dualquat<T>& b) const
+        {
+            return dualquat<T>(real + b.real, dual + b.dual);
+        }
+
+        // the inverse of a unit dual quaternion
+        dualquat<T> conjugate() const
+        {
+            return dualquat<T>(real.conjugate(), dual.conjugate());
+        }
+
+        //
+        // unit length, with the dual part made orthogonal to the real part, divide-by-zero safe
+        //
+        dualquat<T>& normalize()
+        {
+            T normSquared = dot(real, real);
+
+            if( normSquared < 1e-8 )
+                *this = dualquat<T>();
+            else
+            {
+                T inorm = T(1) / std::sqrt(normSquared);
+                real = real * inorm;
+                dual = dual * inorm;
+                dual = dual - real * dot(real, dual);
+            }
+            return *this;
+        }
+
+        vec3<T> transform_point(const vec3<T>& p) const
+        {
+            return real.rotate(p) + translation();
+        }
+
+        vec3<T> transform_vector(const vec3<T>& v) const
+        {
+            return real.rotate(v);
+        }
+
+        mat4<T> to_mat4() const
+        {
+            mat4<T> M = real.to_mat4();
+            vec3<T> t = translation();
+            M.m14 = t.x;
+            M.m24 = t.y;
+            M.m34 = t.z;
+            return M;
+        }
+    };
+
+    //
+    // normalized linear blend of rigid transforms along the shorter arc (DLB), the dual quaternion
+    // counterpart of nlerp, which also blends more than two (e.g. skinning weights)
+    //
+    template<class T>
+    inline dualquat<T> nlerp(const dualquat<T>& a, const dualquat<T>& b, const T& t)
+    {
+        T s = dot(a.real, b.real) < 0 ? -t : t;
+        return (a * (T(1) - t) + b * s).normalize();
+    }
+
+    typedef quat<float> quatf;
+    typedef dualquat<float> dualquatf;
+
+    const quatf quatf_identity = quatf();
+    const dualquatf dualquatf_identity = dualquatf();
+
+    //
+    // Batched operations, four at a time in SSE registers (transposed to SoA) with the same order
+    // of operations as the scalar code above, so results match it. in and out may be the same array.
+    //
+
+    // out[i] = a[i] * b[i]
+    void quat_mul(const quatf* a, const quatf* b, quatf* out, size_t n);
+
+    // out[i] = nlerp(a[i], b[i], t)
+    void quat_nlerp(const quatf* a, const quatf* b, float t, quatf* out, size_t n);
+
+    // out[i] = q[i].to_mat4(), e.g. for the world matrices of many objects
+    void quat_to_mat4(const quatf* q, mat4f* out, size_t n);
+}
+
+#endif /* QUAT_H */
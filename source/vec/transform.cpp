@@ -0,0 +1,205 @@
+//
+//	transform.cpp
+//
+
+#include <algorithm>
+#include <vector>
+#include <thread>
+
+#include "transform.h"
+
+namespace linalg
+{
+    static_assert(sizeof(vec3f) == 3 * sizeof(float), "vec3f arrays are read as packed floats");
+
+    //
+    // run fn(begin, end) over [0, n) in chunks of at least TRANSFORM_PARALLEL_MIN elements, one
+    // per thread, with chunk boundaries at multiples of 4
+    //
+    template<class F>
+    static void parallel_for(size_t n, unsigned nbr_threads, const F& fn)
+    {
+        if (!nbr_threads)
+            nbr_threads = std::max(1u, std::thread::hardware_concurrency());
+        size_t nbr_chunks = std::min<size_t>(nbr_threads, n / TRANSFORM_PARALLEL_MIN);
+        if (nbr_chunks <= 1)
+        {
+            fn(0, n);
+            return;
+        }
+
+        size_t chunk = (n / nbr_chunks + 3) & ~(size_t)3;
+        std::vector<std::thread> workers;
+        for (size_t begin = chunk; begin < n; begin += chunk)
+            workers.push_back(std::thread(fn, begin, std::min(n, begin + chunk)));
+        fn(0, chunk);
+        for (auto& w : workers)
+            w.join();
+    }
+
+    //
+    // one element, in the order of operations of mat4f * vec4f
+    //
+    static inline void transform_point(const float* m, float x, float y, float z, float& ox, float& oy, float& oz)
+    {
+        ox = m[0]*x + m[4]*y + m[8]*z + m[12];
+        oy = m[1]*x + m[5]*y + m[9]*z + m[13];
+        oz = m[2]*x + m[6]*y + m[10]*z + m[14];
+    }
+
+    static inline void transform_normal(const float* m, float x, float y, float z, float& ox, float& oy, float& oz)
+    {
+        float nx = m[0]*x + m[4]*y + m[8]*z;
+        float ny = m[1]*x + m[5]*y + m[9]*z;
+        float nz = m[2]*x + m[6]*y + m[10]*z;
+        float norm2 = nx*nx + ny*ny + nz*nz;
+        float s = norm2 < 1.0e-8f ? 0.0f : 1.0f / std::sqrt(norm2);
+        ox = nx * s;
+        oy = ny * s;
+        oz = nz * s;
+    }
+
+#ifdef LINALG_SSE
+    //
+    // four elements in SoA registers; r holds the 3x4 upper rows of m, each element broadcast
+    //
+    struct sse_matrix_t
+    {
+        __m128 r[12];
+
+        sse_matrix_t(const mat4f& m)
+        {
+            for (int row = 0; row < 3; row++)
+                for (int k = 0; k < 4; k++)
+                    r[row * 4 + k] = _mm_set1_ps(m.array[k * 4 + row]);
+        }
+    };
+
+    static inline __m128 sse_row(const __m128* r, __m128 x, __m128 y, __m128 z)
+    {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[0], x), _mm_mul_ps(r[1], y)), _mm_mul_ps(r[2], z));
+    }
+
+    static inline void sse_transform_points(const sse_matrix_t& m, __m128& x, __m128& y, __m128& z)
+    {
+        __m128 ox = _mm_add_ps(sse_row(m.r, x, y, z), m.r[3]);
+        __m128 oy = _mm_add_ps(sse_row(m.r + 4, x, y, z), m.r[7]);
+        z = _mm_add_ps(sse_row(m.r + 8, x, y, z), m.r[11]);
+        x = ox;
+        y = oy;
+    }
+
+    static inline void sse_transform_normals(const sse_matrix_t& m, __m128& x, __m128& y, __m128& z)
+    {
+        __m128 nx = sse_row(m.r, x, y, z), ny = sse_row(m.r + 4, x, y, z), nz = sse_row(m.r + 8, x, y, z);
+        __m128 norm2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz));
+        __m128 s = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(norm2)), _mm_cmpge_ps(norm2, _mm_set1_ps(1.0e-8f)));
+        x = _mm_mul_ps(nx, s);
+        y = _mm_mul_ps(ny, s);
+        z = _mm_mul_ps(nz, s);
+    }
+
+    //
+    // four packed vec3f (a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3) to and from SoA
+    //
+    static inline void aos_to_soa(__m128 a, __m128 b, __m128 c, __m128& x, __m128& y, __m128& z)
+    {
+        x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+        y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+        z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+    }
+
+    static inline void soa_to_aos(__m128 x, __m128 y, __m128 z, __m128& a, __m128& b, __m128& c)
+    {
+        a = _mm_shuffle_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+        b = _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+        c = _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+    }
+#endif
+
+    //
+    // AoS & SoA loops over a range, SIMD over groups of four and scalar for the rest
+    //
+    template<bool points>
+    static void transform_aos(const mat4f& m, const vec3f* in, vec3f* out, size_t begin, size_t end)
+    {
+        size_t i = begin;
+#ifdef LINALG_SSE
+        sse_matrix_t sm(m);
+        for (; i + 4 <= end; i += 4)
+        {
+            const float* src = in[i].vec;
+            float* dst = out[i].vec;
+            __m128 x, y, z, a, b, c;
+            aos_to_soa(_mm_loadu_ps(src), _mm_loadu_ps(src + 4), _mm_loadu_ps(src + 8), x, y, z);
+            if (points)
+                sse_transform_points(sm, x, y, z);
+            else
+                sse_transform_normals(sm, x, y, z);
+            soa_to_aos(x, y, z, a, b, c);
+            _mm_storeu_ps(dst, a);
+            _mm_storeu_ps(dst + 4, b);
+            _mm_storeu_ps(dst + 8, c);
+        }
+#endif
+        for (; i < end; i++)
+        {
+            vec3f v = in[i];
+            if (points)
+                transform_point(m.array, v.x, v.y, v.z, out[i].x, out[i].y, out[i].z);
+            else
+                transform_normal(m.array, v.x, v.y, v.z, out[i].x, out[i].y, out[i].z);
+        }
+    }
+
+    template<bool points>
+    static void transform_soa(const mat4f& m, const float* x, const float* y, const float* z,
+                              float* out_x, float* out_y, float* out_z, size_t begin, size_t end)
+    {
+        size_t i = begin;
+#ifdef LINALG_SSE
+        sse_matrix_t sm(m);
+        for (; i + 4 <= end; i += 4)
+        {
+            __m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i), vz = _mm_loadu_ps(z + i);
+            if (points)
+                sse_transform_points(sm, vx, vy, vz);
+            else
+                sse_transform_normals(sm, vx, vy, vz);
+            _mm_storeu_ps(out_x + i, vx);
+            _mm_storeu_ps(out_y + i, vy);
+            _mm_storeu_ps(out_z + i, vz);
+        }
+#endif
+        for (; i < end; i++)
+        {
+            float vx = x[i], vy = y[i], vz = z[i];
+            if (points)
+                transform_point(m.array, vx, vy, vz, out_x[i], out_y[i], out_z[i]);
+            else
+                transform_normal(m.array, vx, vy, vz, out_x[i], out_y[i], out_z[i]);
+        }
+    }
+
+    void transform_points(const mat4f& m, const vec3f* in, vec3f* out, size_t n, unsigned nbr_threads)
+    {
+        parallel_for(n, nbr_threads, [&](size_t begin, size_t end) { transform_aos<true>(m, in, out, begin, end); });
+    }
+
+    void transform_normals(const mat4f& m, const vec3f* in, vec3f* out, size_t n, unsigned nbr_threads)
+    {
+        parallel_for(n, nbr_threads, [&](size_t begin, size_t end) { transform_aos<false>(m, in, out, begin, end); });
+    }
+
+    void transform_points_soa(const mat4f& m, const float* x, const float* y, const float* z,
+                              float* out_x, float* out_y, float* out_z, size_t n, unsigned nbr_threads)
+    {
+        parallel_for(n, nbr_threads, [&](size_t begin, size_t end) { transform_soa<true>(m, x, y, z, out_x, out_y, out_z, begin, end); });
+    }
+
+    void transform_normals_soa(const mat4f& m, const float* x, const float* y, const float* z,
+                               float* out_x, float* out_y, float* out_z, size_t n, unsigned nbr_threads)
+    {
+        parallel_for(n, nbr_threads, [&](size_t begin, size_t end) { transform_soa<false>(m, x, y, z, out_x, out_y, out_z, begin, end); });
+    }
+}
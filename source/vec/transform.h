@@ -0,0 +1,43 @@
+//
+//	transform.h
+//	batched transforms of points & normals by a mat4f
+//
+//  SSE where available (LINALG_SSE), four elements at a time, with the same order of operations
+//  as mat4f * vec4f so results match it. Large arrays are split over threads.
+//
+
+#pragma once
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <cstddef>
+#include "vec.h"
+#include "mat.h"
+
+#define TRANSFORM_PARALLEL_MIN (1u << 16)	// elements per thread below which arrays are not split
+
+namespace linalg
+{
+    //
+    // out[i] = (m * (in[i], 1)).xyz, i.e. without the divide by w, for affine m. in and out may be
+    // the same array. nbr_threads = 0 uses one per hardware thread for large arrays.
+    //
+    void transform_points(const mat4f& m, const vec3f* in, vec3f* out, size_t n, unsigned nbr_threads = 0);
+
+    //
+    // out[i] = normalize(m3x3 * in[i]), zero where the result has (near) zero length. For normals m
+    // should be the inverse transpose of the point transform, unless that is rigid or scales uniformly.
+    //
+    void transform_normals(const mat4f& m, const vec3f* in, vec3f* out, size_t n, unsigned nbr_threads = 0);
+
+    //
+    // SoA versions: coordinates in separate arrays, which need no shuffling and suit SIMD best
+    //
+    void transform_points_soa(const mat4f& m, const float* x, const float* y, const float* z,
+                              float* out_x, float* out_y, float* out_z, size_t n, unsigned nbr_threads = 0);
+
+    void transform_normals_soa(const mat4f& m, const float* x, const float* y, const float* z,
+                               float* out_x, float* out_y, float* out_z, size_t n, unsigned nbr_threads = 0);
+}
+
+#endif /* TRANSFORM_H */
@@ -53,4 +53,16 @@ namespace linalg
     // explicit template specialisation for <float>
     template mat3<float> vec3<float>::outer_product(const vec3<float> &v) const;
     
+#ifdef LINALG_HAS_CONSTEXPR
+    //
+    // compile-time checks of the constexpr constructors & operators
+    //
+    static_assert(vec2f(1, 2).dot(vec2f(3, 4)) == 11 && (vec2f(1, 2) % vec2f(3, 4)) == -2, "vec2 dot & cross");
+    static_assert(vec3f(1, 2, 3).dot(vec3f(4, 5, 6)) == 32 && dot(vec3f(1, 2, 3), vec3f(4, 5, 6)) == 32, "vec3 dot");
+    static_assert((vec3f(1, 0, 0) % vec3f(0, 1, 0)) == vec3f(0, 0, 1), "vec3 cross");
+    static_assert(vec3f(1, 2, 3) + vec3f(1, 1, 1) * 2.0f - vec3f(3, 4, 5) == vec3f_zero, "vec3 arithmetic");
+    static_assert(-vec3f(1, 2, 3) * vec3f(2, 2, 2) == vec3f(-2, -4, -6), "vec3 negation & product");
+    static_assert((vec4f(vec3f(1, 2, 3), 4) * 2.0f - vec4f(1, 1, 1, 1)).xyz() == vec3f(1, 3, 5), "vec4 arithmetic");
+    static_assert(dot(vec4f(1, 2, 3, 4), vec4f(1, 1, 1, 1)) == 10 && vec4f_zero.w == 0, "vec4 dot");
+#endif
 }
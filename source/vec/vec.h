@@ -13,6 +13,18 @@
 #include <cstdio>
 #include <ostream>
 
+//
+// constexpr where the compiler has it, so constant vectors & matrices (and the identity,
+// translation, scaling & projection builders of mat.h) are built at compile time. Visual C++
+// 2013 (v120) has no constexpr: LINALG_CONSTEXPR is empty and they are built at runtime as before.
+//
+#if !defined(_MSC_VER) || _MSC_VER >= 1900
+#define LINALG_HAS_CONSTEXPR
+#define LINALG_CONSTEXPR constexpr
+#else
+#define LINALG_CONSTEXPR
+#endif
+
 namespace linalg
 {
     //
@@ -27,16 +39,12 @@ namespace linalg
             struct { T x, y; };
         };
         
-        vec2()
+        LINALG_CONSTEXPR vec2() : x(0.0f), y(0.0f)
         {
-            x = 0.0f;
-            y = 0.0f;
         }
         
-        vec2(const T& x, const T& y)
+        LINALG_CONSTEXPR vec2(const T& x, const T& y) : x(x), y(y)
         {
-            this->x = x;
-            this->y = y;
         }
         
         void set(const T &x, const T &y)
@@ -45,7 +53,7 @@ namespace linalg
             this->y = y;
         }
         
-        float dot(const vec2<T> &u) const
+        LINALG_CONSTEXPR float dot(const vec2<T> &u) const
         {
             return x*u.x + y*u.y;
         }
@@ -136,17 +144,17 @@ namespace linalg
             return *this;
         }
         
-        vec2<T> operator -() const
+        LINALG_CONSTEXPR vec2<T> operator -() const
         {
             return vec2<T>(-x, -y);
         }
         
-        vec2<T> operator *(const T &s) const
+        LINALG_CONSTEXPR vec2<T> operator *(const T &s) const
         {
             return vec2<T>(x * s, y * s);
         }
 
-        vec2<T> operator *(const vec2<T> &v) const
+        LINALG_CONSTEXPR vec2<T> operator *(const vec2<T> &v) const
         {
             return vec2<T>(x * v.x, y * v.y);
         }
@@ -157,17 +165,17 @@ namespace linalg
             return vec2(x * iv, y * iv);
         }
         
-        vec2<T> operator +(const vec2<T> &v) const
+        LINALG_CONSTEXPR vec2<T> operator +(const vec2<T> &v) const
         {
             return vec2<T>(x + v.x, y + v.y);
         }
         
-        vec2<T> operator -(const vec2<T> &v) const
+        LINALG_CONSTEXPR vec2<T> operator -(const vec2<T> &v) const
         {
             return vec2<T>(x - v.x, y - v.y);
         }
         
-        T operator %(const vec2<T> &v) const
+        LINALG_CONSTEXPR T operator %(const vec2<T> &v) const
         {
             return x * v.y - y * v.x;
         }
@@ -195,18 +203,12 @@ namespace linalg
             struct { T x, y, z; };
         };
         
-        vec3()
+        LINALG_CONSTEXPR vec3() : x(0.0), y(0.0), z(0.0)
         {
-            x = 0.0;
-            y = 0.0;
-            z = 0.0;
         }
         
-        vec3(const T &x, const T &y, const T &z)
+        LINALG_CONSTEXPR vec3(const T &x, const T &y, const T &z) : x(x), y(y), z(z)
         {
-            this->x = x;
-            this->y = y;
-            this->z = z;
         }
         
         vec4<T> xyz0() const;
@@ -220,7 +222,7 @@ namespace linalg
             this->z = z;
         }
         
-        T dot(const vec3<T> &u) const
+        LINALG_CONSTEXPR T dot(const vec3<T> &u) const
         {
             return x*u.x + y*u.y + z*u.z;
         }
@@ -315,17 +317,17 @@ namespace linalg
             return *this;
         }
         
-        vec3<T> operator -() const
+        LINALG_CONSTEXPR vec3<T> operator -() const
         {
             return vec3<T>(-x, -y, -z);
         }
         
-        vec3<T> operator *(const T& s) const
+        LINALG_CONSTEXPR vec3<T> operator *(const T& s) const
         {
             return vec3(x*s, y*s, z*s);
         }
         
-        vec3<T> operator *(const vec3<T>& v) const
+        LINALG_CONSTEXPR vec3<T> operator *(const vec3<T>& v) const
         {
             return vec3<T>(x*v.x, y*v.y, z*v.z);
         }
@@ -336,24 +338,24 @@ namespace linalg
             return vec3<T>(x*is, y*is, z*is);
         }
         
-        vec3<T> operator +(const vec3<T>& v) const
+        LINALG_CONSTEXPR vec3<T> operator +(const vec3<T>& v) const
         {
             return vec3<T>(x+v.x, y+v.y, z+v.z);
         }
         
-        vec3<T> operator -(const vec3<T>& v) const
+        LINALG_CONSTEXPR vec3<T> operator -(const vec3<T>& v) const
         {
             return vec3<T>(x-v.x, y-v.y, z-v.z);
         }
         
-        vec3<T> operator %(const vec3<T>& v) const
+        LINALG_CONSTEXPR vec3<T> operator %(const vec3<T>& v) const
         {
             return vec3<T>(y*v.z-z*v.y, z*v.x-x*v.z, x*v.y-y*v.x);
         }
         
         vec3<T> operator *(const mat3<T>& m) const;
         
-        bool operator == (const vec3<T>& rhs) const
+        LINALG_CONSTEXPR bool operator == (const vec3<T>& rhs) const
         {
             return x == rhs.x && y == rhs.y && z == rhs.z;
         }
@@ -384,25 +386,16 @@ namespace linalg
             struct { T x, y, z, w; };
         };
         
-        vec4()
+        LINALG_CONSTEXPR vec4() : x(0), y(0), z(0), w(0)
         {
-            x = y = z = w = 0;
         }
         
-        vec4(const T &x, const T &y, const T &z, const T &w)
+        LINALG_CONSTEXPR vec4(const T &x, const T &y, const T &z, const T &w) : x(x), y(y), z(z), w(w)
         {
-            this->x = x;
-            this->y = y;
-            this->z = z;
-            this->w = w;
         }
         
-        vec4(const vec3<T> &v, const T &w)
+        LINALG_CONSTEXPR vec4(const vec3<T> &v, const T &w) : x(v.x), y(v.y), z(v.z), w(w)
         {
-            this->x = v.x;
-            this->y = v.y;
-            this->z = v.z;
-            this->w = w;
         }
         
         void set(const T &x, const T &y, const T &z, const T &w){
@@ -412,17 +405,17 @@ namespace linalg
             this->w = w;
         }
         
-        vec2<T> xy() const
+        LINALG_CONSTEXPR vec2<T> xy() const
         {
             return vec2<T>(x, y);
         }
         
-        vec3<T> xyz() const
+        LINALG_CONSTEXPR vec3<T> xyz() const
         {
             return vec3<T>(x, y, z);
         }
         
-        vec4<T> operator +(const vec4<T> &v) const
+        LINALG_CONSTEXPR vec4<T> operator +(const vec4<T> &v) const
         {
             return vec4<T>(x+v.x, y+v.y, z+v.z, w+v.w);
         }
@@ -437,12 +430,12 @@ namespace linalg
             return *this;
         }
         
-        vec4<T> operator -(const vec4<T> &v) const
+        LINALG_CONSTEXPR vec4<T> operator -(const vec4<T> &v) const
         {
             return vec4<T>(x-v.x, y-v.y, z-v.z, w-v.w);
         }
         
-        vec4<T> operator *(const T &s) const
+        LINALG_CONSTEXPR vec4<T> operator *(const T &s) const
         {
             return vec4<T>(x*s, y*s, z*s, w*s);
         }
@@ -457,13 +450,13 @@ namespace linalg
     }
     
     template<class T>
-    inline T dot(const vec3<T>& u, const vec3<T>& v)
+    inline LINALG_CONSTEXPR T dot(const vec3<T>& u, const vec3<T>& v)
     {
         return u.x*v.x + u.y*v.y + u.z*v.z;
     }
     
     template<class T>
-    inline T dot(const vec4<T>& u, const vec4<T>& v)
+    inline LINALG_CONSTEXPR T dot(const vec4<T>& u, const vec4<T>& v)
     {
         return u.x*v.x + u.y*v.y + u.z*v.z + u.w*v.w;
     }
@@ -527,9 +520,9 @@ namespace linalg
     //
     // compile-time instances
     //
-    const vec2f vec2f_zero = vec2f(0, 0);
-    const vec3f vec3f_zero = vec3f(0, 0, 0);
-    const vec4f vec4f_zero = vec4f(0, 0, 0, 0);
+    LINALG_CONSTEXPR const vec2f vec2f_zero = vec2f(0, 0);
+    LINALG_CONSTEXPR const vec3f vec3f_zero = vec3f(0, 0, 0);
+    LINALG_CONSTEXPR const vec4f vec4f_zero = vec4f(0, 0, 0, 0);
 }
 
 #endif /* VEC_H */
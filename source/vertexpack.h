@@ -0,0 +1,228 @@
+//
+//  vertexpack.h
+//
+//  Compact vertex format for device vertex buffers: octahedral-encoded normal and tangent,
+//  a handedness sign instead of a stored binormal, half-float texcoords and optionally
+//  positions quantized to the mesh bounds. A 56 byte vertex_t packs to 24 bytes
+//  (20 with quantized positions).
+//
+//  Encoding and decoding are plain C++ and usable on the CPU side. DrawTri.vs decodes the
+//  same layout when compiled with PACKED_VERTICES (and QUANTIZED_POSITIONS).
+//
+
+#pragma once
+#ifndef VERTEXPACK_H
+#define VERTEXPACK_H
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "vec/vec.h"
+#include "vec/mat.h"
+#include "drawcall.h"
+
+#define VERTEX_PACKED						// upload packed_vertex_t instead of vertex_t
+//#define VERTEX_QUANTIZED_POSITIONS		// 16-bit positions relative to the mesh bounds
+
+using linalg::vec2f;
+using linalg::vec3f;
+using linalg::mat4f;
+
+//
+// packed vertex, the DXGI formats of the matching input layout are given per member
+//
+// Half-float texcoords keep sub-texel precision on 4k textures for uvs within about [-8, 8];
+// heavily tiled uvs lose precision further out.
+//
+struct packed_vertex_t
+{
+#ifdef VERTEX_QUANTIZED_POSITIONS
+	uint16_t Pos[4];		// R16G16B16A16_UNORM, position within the bounds, w = 1
+#else
+	float Pos[3];			// R32G32B32_FLOAT
+#endif
+	int16_t Normal[2];		// R16G16_SNORM, octahedral
+	int8_t Tangent[4];		// R8G8B8A8_SNORM, octahedral xy, handedness z, w unused
+	uint16_t TexCoord[2];	// R16G16_FLOAT
+};
+
+//
+// float <-> half, round to nearest even, inf/nan preserved
+//
+inline uint16_t float_to_half(float f)
+{
+	uint32_t x;
+	memcpy(&x, &f, sizeof(x));
+	uint16_t sign = (uint16_t)((x >> 16) & 0x8000);
+	uint32_t absx = x & 0x7fffffff;
+
+	if (absx >= 0x7f800000)		// inf, nan
+		return sign | 0x7c00 | (absx > 0x7f800000 ? 0x200 : 0);
+	if (absx >= 0x477ff000)		// rounds to >= 65536
+		return sign | 0x7c00;
+	if (absx < 0x38800000)		// below 2^-14: subnormal half (may round up to the smallest normal)
+	{
+		float a;
+		memcpy(&a, &absx, sizeof(a));
+		return sign | (uint16_t)lrintf(a * 16777216.0f);
+	}
+
+	// rebias exponent, round mantissa to 10 bits
+	absx += 0xfff + ((absx >> 13) & 1);
+	return sign | (uint16_t)((absx - 0x38000000) >> 13);
+}
+
+inline float half_to_float(uint16_t h)
+{
+	uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	uint32_t exp = (h >> 10) & 0x1f, mant = h & 0x3ff;
+
+	if (exp == 0)
+	{
+		float f = mant * (1.0f / 16777216.0f);
+		return sign ? -f : f;
+	}
+
+	uint32_t x = sign | (exp == 31 ? 0x7f800000 : (exp + 112) << 23) | (mant << 13);
+	float f;
+	memcpy(&f, &x, sizeof(f));
+	return f;
+}
+
+//
+// snorm conversion as done by the input assembler: -1 has two codes, the lower one clamps
+//
+inline int16_t float_to_snorm16(float f) { return (int16_t)lrintf(std::min(1.0f, std::max(-1.0f, f)) * 32767.0f); }
+inline float snorm16_to_float(int16_t s) { return std::max(-1.0f, s / 32767.0f); }
+inline int8_t float_to_snorm8(float f) { return (int8_t)lrintf(std::min(1.0f, std::max(-1.0f, f)) * 127.0f); }
+inline float snorm8_to_float(int8_t s) { return std::max(-1.0f, s / 127.0f); }
+
+//
+// octahedral unit vector encoding: project onto the octahedron |x|+|y|+|z| = 1, fold the
+// lower hemisphere over the upper one, keep xy in [-1, 1]^2
+//
+inline vec2f oct_encode(const vec3f& n)
+{
+	float s = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	if (s == 0)
+		return vec2f(0, 0);
+
+	float x = n.x / s, y = n.y / s;
+	if (n.z < 0)
+	{
+		float fx = (1 - fabsf(y)) * (x >= 0 ? 1.0f : -1.0f);
+		float fy = (1 - fabsf(x)) * (y >= 0 ? 1.0f : -1.0f);
+		x = fx;
+		y = fy;
+	}
+	return vec2f(x, y);
+}
+
+inline vec3f oct_decode(const vec2f& e)
+{
+	vec3f n(e.x, e.y, 1 - fabsf(e.x) - fabsf(e.y));
+	float t = std::max(-n.z, 0.0f);
+	n.x += n.x >= 0 ? -t : t;
+	n.y += n.y >= 0 ? -t : t;
+	return linalg::normalize(n);
+}
+
+//
+// position quantization: pos = origin + q * scale, q in [0, 1]
+//
+// The scale is uniform (the largest extent of the bounds) so the dequantization can be folded
+// into the model matrix without skewing normals.
+//
+struct vertex_quantization_t
+{
+	vec3f origin = vec3f(0, 0, 0);
+	float scale = 1;
+
+	void fit(const vertex_t* vertices, size_t nbr_vertices)
+	{
+		if (!nbr_vertices)
+			return;
+
+		vec3f lo = vertices[0].Pos, hi = vertices[0].Pos;
+		for (size_t i = 1; i < nbr_vertices; i++)
+		{
+			const vec3f& p = vertices[i].Pos;
+			lo = vec3f(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+			hi = vec3f(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+		}
+		origin = lo;
+		scale = std::max(hi.x - lo.x, std::max(hi.y - lo.y, hi.z - lo.z));
+		if (scale <= 0)
+			scale = 1;
+	}
+
+	// maps decoded positions to model space
+	mat4f dequantize_matrix() const
+	{
+		return mat4f::translation(origin) * mat4f::scaling(scale);
+	}
+};
+
+inline packed_vertex_t pack_vertex(const vertex_t& v, const vertex_quantization_t& q)
+{
+	packed_vertex_t p;
+
+#ifdef VERTEX_QUANTIZED_POSITIONS
+	vec3f u = (v.Pos - q.origin) * (1.0f / q.scale);
+	for (int i = 0; i < 3; i++)
+		p.Pos[i] = (uint16_t)lrintf(std::min(1.0f, std::max(0.0f, u.vec[i])) * 65535.0f);
+	p.Pos[3] = 65535;
+#else
+	memcpy(p.Pos, v.Pos.vec, sizeof(p.Pos));
+#endif
+
+	vec2f n = oct_encode(v.Normal), t = oct_encode(v.Tangent);
+	p.Normal[0] = float_to_snorm16(n.x);
+	p.Normal[1] = float_to_snorm16(n.y);
+	p.Tangent[0] = float_to_snorm8(t.x);
+	p.Tangent[1] = float_to_snorm8(t.y);
+	p.Tangent[2] = linalg::dot(v.Normal % v.Tangent, v.Binormal) < 0 ? -127 : 127;
+	p.Tangent[3] = 0;
+
+	p.TexCoord[0] = float_to_half(v.TexCoord.x);
+	p.TexCoord[1] = float_to_half(v.TexCoord.y);
+	return p;
+}
+
+inline vertex_t unpack_vertex(const packed_vertex_t& p, const vertex_quantization_t& q)
+{
+	vertex_t v;
+
+#ifdef VERTEX_QUANTIZED_POSITIONS
+	v.Pos = q.origin + vec3f(p.Pos[0], p.Pos[1], p.Pos[2]) * (q.scale / 65535.0f);
+#else
+	v.Pos = vec3f(p.Pos[0], p.Pos[1], p.Pos[2]);
+#endif
+
+	v.Normal = oct_decode(vec2f(snorm16_to_float(p.Normal[0]), snorm16_to_float(p.Normal[1])));
+	v.Tangent = oct_decode(vec2f(snorm8_to_float(p.Tangent[0]), snorm8_to_float(p.Tangent[1])));
+	v.Binormal = (v.Normal % v.Tangent) * snorm8_to_float(p.Tangent[2]);
+	v.TexCoord = vec2f(half_to_float(p.TexCoord[0]), half_to_float(p.TexCoord[1]));
+	return v;
+}
+
+//
+// pack a vertex array, fitting the quantization bounds first if positions are quantized
+//
+inline void pack_vertices(const vertex_t* vertices, size_t nbr_vertices,
+						  std::vector<packed_vertex_t>& packed, vertex_quantization_t& q)
+{
+	q = vertex_quantization_t();
+#ifdef VERTEX_QUANTIZED_POSITIONS
+	q.fit(vertices, nbr_vertices);
+#endif
+
+	packed.resize(nbr_vertices);
+	for (size_t i = 0; i < nbr_vertices; i++)
+		packed[i] = pack_vertex(vertices[i], q);
+}
+
+#endif